@@ -1,31 +1,194 @@
+// alaska-opt: run the whole alaska-transform pipeline in one process.
+//
+// alaska-transform runs one `opt` per pass, and each of those parses and then
+// writes out the whole program. Here the module is parsed once, the runtime
+// bitcode is linked in memory, and every stage runs through one PassBuilder, so
+// analyses that a stage preserves are still cached for the next one. The
+// stages and flags are the same as alaska-transform's.
+
+#include <alaska/Utils.h>
+
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/BuiltinGCs.h"
-#include <llvm/IR/Module.h>
-#include <llvm/IRReader/IRReader.h>
-#include <llvm/IR/LLVMContext.h>
-#include <llvm/Support/SourceMgr.h>
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/InitLLVM.h"
-#include <alaska/Utils.h>
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Transforms/IPO/Internalize.h"
 
-#include <iostream>
+#include <string>
 
 using namespace llvm;
 
+static cl::opt<std::string> Input(cl::Positional, cl::Required, cl::desc("<input bitcode>"));
+static cl::opt<std::string> Output("o", cl::desc("The destination file. Defaults to in-place."));
+static cl::opt<bool> Text("S", cl::desc("Write textual IR"));
+
+static cl::opt<bool> Baseline("baseline", cl::desc("Apply baseline transformations, do not insert translations"));
+static cl::alias BaselineShort("b", cl::aliasopt(Baseline));
+static cl::opt<bool> DisableTracking("disable-tracking");
+static cl::opt<bool> DisableHoisting("disable-hoisting");
+static cl::opt<bool> DisableInlining("disable-inlining");
+static cl::opt<bool> DisableVersioning("disable-versioning", cl::desc("Do not version loops into safepoint-free fast paths"));
+static cl::opt<bool> DisableSpecialization("disable-specialization", cl::desc("Do not clone callees to take pre-translated pointers"));
+static cl::opt<bool> DisableBatching("disable-batching", cl::desc("Do not batch translations of arrays of handles"));
+
+static cl::opt<bool> TimeStages("time-stages", cl::desc("Print how long each stage takes"));
+static cl::opt<bool> VerifyEach("verify-each", cl::desc("Verify the module after each stage"));
+
+// Parsed by hand before the other options, as the plugin registers its own.
+static cl::opt<std::string> PluginPath("alaska-plugin", cl::desc("Path to Alaska.so (default: <prefix>/lib/Alaska.so)"));
+
+
+static void fail(const Twine &msg) {
+  alaska::println("alaska-opt: ", msg.str());
+  exit(EXIT_FAILURE);
+}
+
+
+class Pipeline {
+ public:
+  Pipeline(PassPlugin &plugin) {
+    plugin.registerPassBuilderCallbacks(PB);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  }
+
+  // Run a stage: a pipeline in `opt -passes=...` syntax.
+  void run(Module &M, StringRef pipeline) {
+    ModulePassManager MPM;
+    if (auto err = PB.parsePassPipeline(MPM, pipeline)) {
+      fail("invalid pipeline '" + pipeline + "': " + toString(std::move(err)));
+    }
+
+    double start = alaska::time_ms();
+    MPM.run(M, MAM);
+    if (TimeStages) {
+      alaska::println("\e[32m[stage]\e[0m ", pipeline, " ", alaska::time_ms() - start, "ms");
+    }
+
+    if (VerifyEach && verifyModule(M, &errs())) fail("module is broken after " + pipeline);
+  }
+
+  // Link `path` into M, internalizing everything it brings in (like
+  // `llvm-link --internalize`).
+  void link(Module &M, StringRef path) {
+    SMDiagnostic err;
+    auto lib = parseIRFile(path, err, M.getContext());
+    if (!lib) {
+      err.print("alaska-opt", errs());
+      exit(EXIT_FAILURE);
+    }
+    StripDebugInfo(*lib);
+
+    bool failed = Linker::linkModules(
+        M, std::move(lib), Linker::Flags::None, [](Module &M, const StringSet<> &linked) {
+          internalizeModule(M, [&linked](const GlobalValue &GV) {
+            return !GV.hasName() || linked.count(GV.getName()) == 0;
+          });
+        });
+    if (failed) fail("failed to link " + path);
+
+    // New functions, and calls to them: nothing cached is still valid.
+    MAM.invalidate(M, PreservedAnalyses::none());
+  }
+
+ private:
+  PassBuilder PB;
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+};
+
+
 int main(int argc, char **argv) {
-  llvm::InitLLVM X(argc, argv);
-  llvm::linkAllBuiltinGCs();
+  InitLLVM X(argc, argv);
+  linkAllBuiltinGCs();
+
+  // <prefix>/bin/alaska-opt -> <prefix>
+  std::string exe = sys::fs::getMainExecutable(argv[0], (void *)&main);
+  SmallString<256> prefix(sys::path::parent_path(sys::path::parent_path(exe)));
+  auto libPath = [&](StringRef name) {
+    SmallString<256> path(prefix);
+    sys::path::append(path, "lib", name);
+    return std::string(path);
+  };
+
+  // The plugin has to be loaded before the command line is parsed, so its
+  // options (-alaska-spp-poll-interval, ...) can be given here too.
+  std::string plugin_path = libPath("Alaska.so");
+  for (int i = 1; i < argc; i++) {
+    StringRef arg(argv[i]);
+    if (arg.consume_front("-alaska-plugin=") || arg.consume_front("--alaska-plugin=")) {
+      plugin_path = arg.str();
+    }
+  }
+  auto plugin = PassPlugin::Load(plugin_path);
+  if (!plugin) fail("failed to load " + plugin_path + ": " + toString(plugin.takeError()));
+
+  cl::ParseCommandLineOptions(argc, argv, "Applies alaska transformations to an input bitcode\n");
+  std::string output = Output.empty() ? Input : Output;
 
   LLVMContext context;
   SMDiagnostic error;
-  auto m = llvm::parseIRFile(argv[1], error, context);
-	if (!m) {
-		alaska::println("Failed to open input\n");
-	}
+  auto M = parseIRFile(Input, error, context);
+  if (!M) {
+    error.print("alaska-opt", errs());
+    return EXIT_FAILURE;
+  }
+
+  Pipeline P(*plugin);
+
+  if (!Baseline) P.link(*M, libPath("alaska_stub.bc"));
+
+  P.run(*M, "function(mergereturn,break-crit-edges,loop-simplify,lcssa,loop(indvars),mem2reg,instnamer)");
+  P.run(*M, "alaska-prepare");
 
-	ModulePassManager MPM;
+  if (!Baseline) {
+    // Does nothing unless -alaska-summary-in/-out are given (per-TU mode)
+    P.run(*M, "alaska-summary");
 
+    if (!DisableHoisting) {
+      P.run(*M, "alaska-replace");
+      if (!DisableVersioning) P.run(*M, "alaska-version-loops");
+      P.run(*M, "alaska-translate");
+      if (!DisableSpecialization) P.run(*M, "alaska-specialize");
+      if (!DisableBatching) P.run(*M, "alaska-batch-translate");
+    } else {
+      P.run(*M, "alaska-replace,alaska-translate-nohoist");
+    }
 
+    P.link(*M, libPath("alaska_translate.bc"));
 
+    P.run(*M, "alaska-escape");
+    if (!DisableTracking) P.run(*M, "alaska-tracking");
+    P.run(*M, "alaska-lower");
+    if (!DisableInlining) P.run(*M, "alaska-inline");
+  }
 
+  std::error_code ec;
+  ToolOutputFile out(output, ec, Text ? sys::fs::OF_Text : sys::fs::OF_None);
+  if (ec) fail("failed to open " + output + ": " + ec.message());
+  if (Text) {
+    M->print(out.os(), nullptr);
+  } else {
+    WriteBitcodeToFile(*M, out.os());
+  }
+  out.keep();
 
   return 0;
 }
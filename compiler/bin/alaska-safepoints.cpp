@@ -0,0 +1,233 @@
+// alaska-safepoints: build a linked program's safepoint table.
+//
+// The barrier needs to know where every poll is, and where the pins of each
+// call are. At startup, the runtime would find that out by parsing the
+// program's stackmaps (.llvm_stackmaps), which are as big as the program has
+// calls. This does the same parsing once, after linking, and writes the
+// result as assembly: a read only __alaska_safepoint_table (see
+// alaska/SafepointTable.h) to be linked into the program. The table is made of
+// offsets from __alaska_text_start, so linking it in again does not change it.
+//
+// This has to stay in sync with parse_stack_map in runtime/rt/barrier.cpp.
+
+#include <alaska/Utils.h>
+#include <alaska/SafepointTable.h>
+
+#include "llvm/Object/ELFObjectFile.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Object/StackMapParser.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<std::string> Input(cl::Positional, cl::Required, cl::desc("<linked program>"));
+static cl::opt<std::string> Output("o", cl::Required, cl::desc("The assembly file to write"));
+
+
+static void fail(const Twine &msg) {
+  alaska::println("alaska-safepoints: ", msg.str());
+  exit(EXIT_FAILURE);
+}
+
+
+struct Safepoint {
+  uint32_t offset;
+  alaska_pin_set pin_set;
+};
+
+
+// The contents of the stackmap, as they are once the program is loaded. In a
+// position independent program the function addresses are left for the
+// dynamic linker to fill in, so do that here.
+static std::vector<uint8_t> read_stack_map(object::ELFObjectFileBase &obj) {
+  std::vector<uint8_t> data;
+  uint64_t address = 0;
+  bool found = false;
+  for (auto &sec : obj.sections()) {
+    auto name = sec.getName();
+    if (!name || *name != ".llvm_stackmaps") continue;
+    auto contents = sec.getContents();
+    if (!contents) fail("can't read .llvm_stackmaps: " + toString(contents.takeError()));
+    data.assign(contents->bytes_begin(), contents->bytes_end());
+    address = sec.getAddress();
+    found = true;
+  }
+  if (!found) return data;
+
+  for (auto &sec : obj.dynamic_relocation_sections()) {
+    for (auto &rel : sec.relocations()) {
+      uint64_t at = rel.getOffset();
+      if (at < address || at + 8 > address + data.size()) continue;
+      object::ELFRelocationRef elf_rel(rel);
+      if (elf_rel.getType() != ELF::R_X86_64_RELATIVE) {
+        fail("unexpected relocation in .llvm_stackmaps, of type " + Twine(elf_rel.getType()));
+      }
+      auto addend = elf_rel.getAddend();
+      if (!addend) fail(toString(addend.takeError()));
+      uint64_t value = *addend;
+      memcpy(data.data() + (at - address), &value, sizeof(value));
+    }
+  }
+  return data;
+}
+
+
+// The size of the stackmap at the start of map, which LLVM's parser does not
+// know: the linker concatenates the stackmap of every object file into one
+// section, so a program transformed one translation unit at a time has many.
+static size_t stack_map_size(ArrayRef<uint8_t> map) {
+  auto read16 = [&](size_t at) { return support::endian::read16le(map.data() + at); };
+  auto read32 = [&](size_t at) { return support::endian::read32le(map.data() + at); };
+  if (map.size() < 16 || map[0] != 3) fail("unexpected stackmap version in .llvm_stackmaps");
+
+  // The header, the functions, and the constants
+  size_t size = 16 + read32(4) * 24 + read32(8) * 8;
+  for (uint32_t i = 0, records = read32(12); i < records && size + 16 <= map.size(); i++) {
+    // The id, offset and locations, then the live outs
+    size = alignTo(size + 16 + read16(size + 14) * 12, 8);
+    size = alignTo(size + 4 + read16(size + 2) * 4, 8);
+  }
+  if (size > map.size()) fail(".llvm_stackmaps is truncated");
+  return size;
+}
+
+
+static uint64_t find_symbol(object::ObjectFile &obj, StringRef name) {
+  for (auto &sym : obj.symbols()) {
+    auto sym_name = sym.getName();
+    if (!sym_name || *sym_name != name) continue;
+    auto address = sym.getAddress();
+    if (!address) fail(toString(address.takeError()));
+    return *address;
+  }
+  fail(Input + " has no " + name);
+  return 0;
+}
+
+
+static void write_offsets(raw_ostream &out, const std::vector<uint32_t> &offsets) {
+  for (auto offset : offsets)
+    out << "\t.long\t" << offset << "\n";
+}
+
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "alaska-safepoints\n");
+
+  auto binary = object::ObjectFile::createObjectFile(Input);
+  if (!binary) fail(Input + ": " + toString(binary.takeError()));
+  auto *obj = dyn_cast<object::ELF64LEObjectFile>(binary->getBinary());
+  if (!obj || obj->getArch() != Triple::x86_64) fail(Input + " is not an x86-64 ELF program");
+
+  uint64_t text_start = find_symbol(*obj, "__alaska_text_start");
+  auto stack_map = read_stack_map(*obj);
+
+  std::vector<Safepoint> safepoints;
+  std::vector<uint32_t> patches, block_rets;
+  uint64_t hash = ALASKA_STACKMAP_HASH_INIT;
+
+  // Like parse_stack_map, one stackmap at a time, in the order they were linked
+  for (size_t at = 0, size; at < stack_map.size(); at += size) {
+    ArrayRef<uint8_t> map = ArrayRef<uint8_t>(stack_map).drop_front(at);
+    size = stack_map_size(map);
+    StackMapParser<support::little> parser(map.take_front(size));
+
+    for (const auto &f : parser.functions()) {
+      hash = alaska_stackmap_hash(hash, f.getFunctionAddress() - text_start, f.getRecordCount());
+    }
+
+    // Records are stored function by function, in the same order
+    auto func = parser.functions_begin();
+    uint64_t record_count = 0;
+    for (const auto &record : parser.records()) {
+      uint64_t addr = func->getFunctionAddress() + record.getInstructionOffset();
+      if (++record_count == func->getRecordCount()) {
+        ++func;
+        record_count = 0;
+      }
+
+      uint64_t id = record.getID();
+      if (id == 'BLOK') block_rets.push_back(addr - text_start);
+      if (id == 'PATC') {
+        addr -= ALASKA_PATCH_SIZE;
+        patches.push_back(addr - text_start);
+      }
+
+      alaska_pin_set psi = {};
+      for (unsigned i = 3; i < record.getNumLocations(); i++) {
+        auto l = record.getLocation(i);
+        switch (l.getKind()) {
+          case StackMapParser<support::little>::LocationKind::Direct:
+            psi.reg = l.getDwarfRegNum();
+            psi.offset = l.getOffset();
+            break;
+
+          case StackMapParser<support::little>::LocationKind::Constant:
+            psi.count = l.getSmallConstant();
+            break;
+
+          default:
+            break;
+        }
+      }
+
+      if (id == 'PATC') {
+        psi.flags |= ALASKA_PIN_SET_POLL;
+        safepoints.push_back({(uint32_t)(addr - text_start), psi});
+      } else if (id == 0 || id == 'BLOK') {
+        if (psi.count != 0) safepoints.push_back({(uint32_t)(addr - text_start), psi});
+      }
+    }
+  }
+
+  // Sorted for the runtime to binary search, keeping the first of duplicates
+  std::stable_sort(safepoints.begin(), safepoints.end(),
+      [](const Safepoint &a, const Safepoint &b) { return a.offset < b.offset; });
+  safepoints.erase(std::unique(safepoints.begin(), safepoints.end(),
+                       [](const Safepoint &a, const Safepoint &b) { return a.offset == b.offset; }),
+      safepoints.end());
+  std::sort(block_rets.begin(), block_rets.end());
+
+
+  std::error_code ec;
+  ToolOutputFile out(Output, ec, sys::fs::OF_Text);
+  if (ec) fail("can't write " + Output + ": " + ec.message());
+  auto &os = out.os();
+
+  os << "\t.section\t.rodata.alaska_safepoints,\"a\",@progbits\n";
+  os << "\t.globl\t__alaska_safepoint_table\n";
+  os << "\t.p2align\t3\n";
+  os << "__alaska_safepoint_table:\n";
+  os << "\t.long\t" << ALASKA_SAFEPOINT_TABLE_MAGIC << "\n";
+  os << "\t.long\t" << ALASKA_SAFEPOINT_TABLE_VERSION << "\n";
+  os << "\t.quad\t" << hash << "\n";
+  os << "\t.long\t" << safepoints.size() << "\n";
+  os << "\t.long\t" << patches.size() << "\n";
+  os << "\t.long\t" << block_rets.size() << "\n";
+  os << "\t.long\t0\n";
+
+  std::vector<uint32_t> offsets;
+  for (auto &sp : safepoints)
+    offsets.push_back(sp.offset);
+  write_offsets(os, offsets);
+  for (auto &sp : safepoints) {
+    auto &psi = sp.pin_set;
+    os << "\t.long\t" << psi.count << "\n";
+    os << "\t.short\t" << psi.reg << ", " << psi.flags << "\n";
+    os << "\t.long\t" << psi.offset << "\n";
+  }
+  write_offsets(os, patches);
+  write_offsets(os, block_rets);
+  os << "\t.size\t__alaska_safepoint_table, .-__alaska_safepoint_table\n";
+
+  out.keep();
+  return 0;
+}
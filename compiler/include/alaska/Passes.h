@@ -26,6 +26,48 @@ class AlaskaTranslatePass : public llvm::PassInfoMixin<AlaskaTranslatePass> {
 };
 
 
+/**
+ * AlaskaLoopVersioningPass - Run before AlaskaTranslatePass. Loops which access
+ * loop invariant handles but also contain calls that might reach a safepoint
+ * are duplicated when loop invariant branches guard all of those calls. The
+ * check in the preheader picks a fast version, in which those branches are
+ * folded away. This leaves a body with no safepoints, so handles (and handles
+ * LICM can then hoist out of it) are translated once in its preheader. The
+ * original loop is kept as the fallback.
+ */
+class AlaskaLoopVersioningPass : public llvm::PassInfoMixin<AlaskaLoopVersioningPass> {
+ public:
+  llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+};
+
+
+/**
+ * AlaskaSpecializePass - Run after AlaskaTranslatePass. Call sites which hold a
+ * live translation of a handle they pass to a function that would translate it
+ * again are redirected to a "pre-translated" clone of that function, which takes
+ * the translated pointer as an extra argument instead of translating it. Clones
+ * are chosen by a static estimate of how hot their call sites are (loop depth
+ * and recursion, from the noelle call graph), within a code growth budget.
+ */
+class AlaskaSpecializePass : public llvm::PassInfoMixin<AlaskaSpecializePass> {
+ public:
+  llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+};
+
+
+/**
+ * AlaskaBatchTranslatePass - Run after AlaskaTranslatePass. Loops which walk an
+ * array of handles one element at a time, translating each, instead translate
+ * a batch of upcoming elements at once with alaska_translate_batch into a
+ * buffer on the stack. Only loops with no calls and a computable trip count
+ * are batched. The buffer is refilled after any barrier, as it is not pinned.
+ */
+class AlaskaBatchTranslatePass : public llvm::PassInfoMixin<AlaskaBatchTranslatePass> {
+ public:
+  llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+};
+
+
 /**
  * PinTrackingPass - Insert pin roots on the stack so the runtime knows where
  * all active handles are. In a runtime that is able to move handles, it must be
@@ -74,6 +116,20 @@ class AlaskaNormalizePass : public llvm::PassInfoMixin<AlaskaNormalizePass> {
   llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
 };
 
+/**
+ * AlaskaSummaryPass - For compiling one translation unit at a time. With
+ * -alaska-summary-out, it writes a summary of each function the module defines
+ * for the rest of the program (is it simple, which arguments may be handles).
+ * With -alaska-summary-in, it reads the summaries of the other translation
+ * units, merged at link time, and marks the declarations of functions that are
+ * also compiled by alaska as `alaska_managed`, so AlaskaEscapePass passes
+ * handles to them instead of translating them.
+ */
+class AlaskaSummaryPass : public llvm::PassInfoMixin<AlaskaSummaryPass> {
+ public:
+  llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+};
+
 class AlaskaEscapePass : public llvm::PassInfoMixin<AlaskaEscapePass> {
  public:
   llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
@@ -19,9 +19,13 @@
 #include "llvm/Transforms/Scalar/DCE.h"
 #include "llvm/Transforms/Scalar/ADCE.h"
 #include "llvm/Transforms/Scalar/SCCP.h"
+#include "llvm/Transforms/Scalar/LICM.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
 #include "llvm/Transforms/IPO/WholeProgramDevirt.h"
 #include "llvm/Transforms/Utils/SCCPSolver.h"
 #include "llvm/Transforms/Utils/PredicateInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
 
 // Noelle Includes
 #include <noelle/core/DataFlow.hpp>
@@ -103,36 +107,55 @@ std::vector<llvm::Value *> getAllValues(llvm::Module &M) {
 
 
 
+// How many threads analyze functions in parallel (0: one per core)
+static llvm::cl::opt<unsigned> AnalysisThreads("alaska-threads", llvm::cl::init(0),
+    llvm::cl::desc("Threads used for function-local analyses (0: one per core)"));
+
 class SimpleFunctionPass : public llvm::PassInfoMixin<SimpleFunctionPass> {
  public:
+  // A function is simple if it has no loops and calls nothing but intrinsics,
+  // so a thread can never stop in it for a barrier.
+  static bool isSimple(llvm::Function &F) {
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        if (auto *call = dyn_cast<CallInst>(&I)) {
+          auto *calledFunction = call->getCalledFunction();
+          // Is it an intrinsic?
+          if (calledFunction && calledFunction->getName().startswith("llvm.")) continue;
+          return false;
+        }
+      }
+    }
+
+    llvm::DominatorTree DT(F);
+    llvm::LoopInfo loops(DT);
+    return loops.empty();
+  }
+
   llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM) {
+    std::vector<llvm::Function *> funcs;
     for (auto &F : M) {
       if (F.empty()) continue;
 
       if (F.getName().startswith(".omp_outlined")) continue;
       if (F.getName().startswith("omp_outlined")) continue;
+      funcs.push_back(&F);
+    }
 
-      llvm::DominatorTree DT(F);
-      llvm::PostDominatorTree PDT(F);
-      llvm::LoopInfo loops(DT);
-
-      bool hasProblematicCalls = false;
-
-      for (auto &BB : F) {
-        for (auto &I : BB) {
-          if (auto *call = dyn_cast<CallInst>(&I)) {
-            auto *calledFunction = call->getCalledFunction();
-            // Is it an intrinsic?
-            if (calledFunction->getName().startswith("llvm.")) continue;
-
-            hasProblematicCalls = true;
-          }
-        }
-      }
+    // Building the dominator tree and loop info only reads the function, so
+    // they can be built for many functions at once. The attributes are added
+    // afterwards, on this thread, as that touches the context.
+    std::vector<char> simple(funcs.size(), false);
+    llvm::ThreadPool pool(llvm::hardware_concurrency(AnalysisThreads));
+    for (size_t i = 0; i < funcs.size(); i++) {
+      pool.async([&, i] {
+        simple[i] = isSimple(*funcs[i]);
+      });
+    }
+    pool.wait();
 
-      if (loops.getLoopsInPreorder().size() == 0 && hasProblematicCalls == false) {
-        F.addFnAttr("alaska_is_simple");
-      }
+    for (size_t i = 0; i < funcs.size(); i++) {
+      if (simple[i]) funcs[i]->addFnAttr("alaska_is_simple");
     }
     return PreservedAnalyses::all();
   }
@@ -188,7 +211,16 @@ extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginIn
             return true;
           }
 
+          REGISTER("alaska-summary", AlaskaSummaryPass);
           REGISTER("alaska-replace", AlaskaReplacementPass);
+
+          if (name == "alaska-version-loops") {
+            MPM.addPass(AlaskaLoopVersioningPass());
+            // Hoist what the (now call-free) fast loops load from invariant addresses
+            MPM.addPass(adapt(createFunctionToLoopPassAdaptor(LICMPass(LICMOptions()), true)));
+            return true;
+          }
+
           if (name == "alaska-translate") {
             MPM.addPass(AlaskaTranslatePass(true));
             return true;
@@ -199,12 +231,15 @@ extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginIn
             return true;
           }
 
+          REGISTER("alaska-specialize", AlaskaSpecializePass);
+          REGISTER("alaska-batch-translate", AlaskaBatchTranslatePass);
           REGISTER("alaska-escape", AlaskaEscapePass);
           if (name == "alaska-lower") {
             MPM.addPass(AlaskaLowerPass());
             return true;
           }
           REGISTER("alaska-inline", TranslationInlinePass);
+          REGISTER("alaska-place-safepoints", llvm::PlaceSafepointsPass);
 
           if (name == "alaska-tracking") {
 #ifdef ALASKA_DUMP_TRANSLATIONS
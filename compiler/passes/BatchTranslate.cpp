@@ -0,0 +1,234 @@
+#include <alaska/Passes.h>
+#include <alaska/Translations.h>
+#include <alaska/Utils.h>
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "alaska-batch-translate"
+
+STATISTIC(NumBatched, "Number of translations replaced with batched translation");
+
+
+// How many handles to translate at once. This is also the size of the buffer
+// on the stack.
+static cl::opt<unsigned> BatchSize("alaska-batch-size", cl::Hidden, cl::init(16));
+
+
+// A translation, in a loop, of a handle loaded from an array of handles that
+// the loop walks one element at a time.
+struct BatchSite {
+  alaska::Translation *tr;
+  Loop *loop;
+  LoadInst *load;
+  // The address of the last element the loop will load.
+  const SCEV *last;
+};
+
+
+// The value a translation is of, looking through alaska.root.
+static Value *translatedValue(alaska::Translation &tr) {
+  Value *handle = tr.getHandle();
+  if (auto *call = dyn_cast<CallInst>(handle)) {
+    if (auto *func = call->getCalledFunction()) {
+      if (func->getName() == "alaska.root") handle = call->getArgOperand(0);
+    }
+  }
+  return handle;
+}
+
+
+// Could anything in L change what is in the array at `base`, or the handles
+// in it? Calls are not allowed at all, as they could free a handle that has
+// already been translated.
+static bool loopMayClobber(Loop *L, Value *base, AAResults &AA) {
+  auto loc = MemoryLocation::getBeforeOrAfter(base);
+  for (auto *BB : L->blocks()) {
+    for (auto &I : *BB) {
+      if (auto *call = dyn_cast<CallBase>(&I)) {
+        if (auto *func = call->getCalledFunction()) {
+          if (func->getName().startswith("alaska.")) continue;
+        }
+        if (!isa<IntrinsicInst>(call)) return true;
+      }
+      if (I.mayWriteToMemory() && isModSet(AA.getModRefInfo(&I, loc))) return true;
+    }
+  }
+  return false;
+}
+
+
+static bool findSite(alaska::Translation &tr, LoopInfo &LI, DominatorTree &DT,
+    ScalarEvolution &SE, AAResults &AA, BatchSite &site) {
+  auto *load = dyn_cast<LoadInst>(translatedValue(tr));
+  if (load == nullptr || !load->isSimple()) return false;
+
+  auto *bb = tr.translation->getParent();
+  Loop *L = LI.getLoopFor(bb);
+  if (L == nullptr || !L->contains(load)) return false;
+
+  // Every iteration must translate exactly one element, and the loop must
+  // run to its computed trip count, so the batch never reads past the last
+  // element the loop itself would have loaded.
+  auto *latch = L->getLoopLatch();
+  if (latch == nullptr || L->getLoopPreheader() == nullptr) return false;
+  if (L->getExitingBlock() != latch) return false;
+  if (!DT.dominates(bb, latch)) return false;
+  if (tr.isLive(latch->getTerminator())) return false;
+
+  auto &DL = load->getModule()->getDataLayout();
+  auto *ar = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(load->getPointerOperand()));
+  if (ar == nullptr || ar->getLoop() != L || !ar->isAffine()) return false;
+  auto *step = dyn_cast<SCEVConstant>(ar->getStepRecurrence(SE));
+  if (step == nullptr) return false;
+  if (step->getAPInt() != DL.getTypeStoreSize(load->getType()).getFixedValue()) return false;
+
+  const SCEV *btc = SE.getExitCount(L, latch);
+  if (isa<SCEVCouldNotCompute>(btc)) return false;
+
+  auto *base = dyn_cast<SCEVUnknown>(SE.getPointerBase(ar));
+  if (base == nullptr || loopMayClobber(L, base->getValue(), AA)) return false;
+
+  const SCEV *last = ar->evaluateAtIteration(btc, SE);
+  SCEVExpander exp(SE, DL, "batch");
+  if (!exp.isSafeToExpandAt(last, L->getLoopPreheader()->getTerminator())) return false;
+
+  site = {&tr, L, load, last};
+  return true;
+}
+
+
+// Replace the translation with a load from a buffer on the stack, which is
+// refilled with alaska.translate_batch when it runs out, or when there has been
+// a barrier (which may have moved the objects) since it was filled.
+static void batchSite(BatchSite &site, ScalarEvolution &SE) {
+  auto *tr = site.tr->translation;
+  auto &F = *tr->getFunction();
+  auto &M = *F.getParent();
+  auto &ctx = M.getContext();
+  auto &DL = M.getDataLayout();
+
+  auto *ptrType = PointerType::get(ctx, 0);
+  auto *i64 = Type::getInt64Ty(ctx);
+  auto *batchType = FunctionType::get(Type::getVoidTy(ctx), {ptrType, ptrType, i64}, false);
+  auto batchFunc = M.getOrInsertFunction("alaska.translate_batch", batchType);
+  auto *epochVar = M.getOrInsertGlobal("alaska_barrier_epoch", i64);
+
+  IRBuilder<> entry(F.getEntryBlock().getFirstNonPHI());
+  auto *buf = entry.CreateAlloca(ArrayType::get(ptrType, BatchSize), nullptr, "batch.buf");
+
+  auto *ph = site.loop->getLoopPreheader();
+  SCEVExpander exp(SE, DL, "batch");
+  Value *last = exp.expandCodeFor(site.last, ptrType, ph->getTerminator());
+
+  // The buffer's state is carried around the loop: the address of the element
+  // in buf[0] (null when it is empty) and the barrier epoch it was filled in.
+  auto *header = site.loop->getHeader();
+  IRBuilder<> hb(&*header->begin());
+  auto *bufStart = hb.CreatePHI(ptrType, 2, "batch.start");
+  auto *bufEpoch = hb.CreatePHI(i64, 2, "batch.epoch");
+
+  auto *bb = tr->getParent();
+  auto *useBB = SplitBlock(bb, tr, (DominatorTree *)nullptr, nullptr, nullptr, "batch.use");
+  auto *refillBB = BasicBlock::Create(ctx, "batch.refill", &F, useBB);
+
+  Value *addr = site.load->getPointerOperand();
+  IRBuilder<> b(bb->getTerminator());
+  auto *addrInt = b.CreatePtrToInt(addr, i64);
+  auto *idx = b.CreateLShr(b.CreateSub(addrInt, b.CreatePtrToInt(bufStart, i64)), 3);
+  auto *epoch = b.CreateAlignedLoad(i64, epochVar, Align(8), "epoch");
+  epoch->setAtomic(AtomicOrdering::Monotonic);
+  auto *valid = b.CreateAnd(b.CreateICmpNE(bufStart, ConstantPointerNull::get(ptrType)),
+      b.CreateAnd(b.CreateICmpULT(idx, b.getInt64(BatchSize)), b.CreateICmpEQ(epoch, bufEpoch)));
+  auto *oldTerm = bb->getTerminator();
+  b.CreateCondBr(valid, useBB, refillBB);
+  oldTerm->eraseFromParent();
+
+  b.SetInsertPoint(refillBB);
+  auto *remaining = b.CreateAdd(
+      b.CreateLShr(b.CreateSub(b.CreatePtrToInt(last, i64), addrInt), 3), b.getInt64(1));
+  auto *count = b.CreateSelect(
+      b.CreateICmpULT(remaining, b.getInt64(BatchSize)), remaining, b.getInt64(BatchSize));
+  b.CreateCall(batchFunc, {addr, buf, count});
+  b.CreateBr(useBB);
+
+  b.SetInsertPoint(&*useBB->begin());
+  auto *start = b.CreatePHI(ptrType, 2, "batch.start.cur");
+  start->addIncoming(bufStart, bb);
+  start->addIncoming(addr, refillBB);
+  auto *curEpoch = b.CreatePHI(i64, 2, "batch.epoch.cur");
+  curEpoch->addIncoming(bufEpoch, bb);
+  curEpoch->addIncoming(epoch, refillBB);
+  auto *curIdx = b.CreatePHI(i64, 2, "batch.idx");
+  curIdx->addIncoming(idx, bb);
+  curIdx->addIncoming(b.getInt64(0), refillBB);
+
+  b.SetInsertPoint(tr);
+  auto *slot = b.CreateInBoundsGEP(ptrType, buf, curIdx);
+  auto *translated = b.CreateLoad(ptrType, slot, "batch.translated");
+
+  // The translation's block dominates the latch, so its state does too.
+  for (auto *pred : predecessors(header)) {
+    bool back = pred != ph;
+    bufStart->addIncoming(back ? (Value *)start : ConstantPointerNull::get(ptrType), pred);
+    bufEpoch->addIncoming(back ? (Value *)curEpoch : b.getInt64(0), pred);
+  }
+
+  auto *root = site.tr->getHandle();
+  tr->replaceAllUsesWith(translated);
+  for (auto *rel : site.tr->releases)
+    rel->eraseFromParent();
+  tr->eraseFromParent();
+  if (auto *inst = dyn_cast<Instruction>(root)) {
+    if (inst != site.load && inst->use_empty()) inst->eraseFromParent();
+  }
+}
+
+
+PreservedAnalyses AlaskaBatchTranslatePass::run(Module &M, ModuleAnalysisManager &AM) {
+  auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  bool changed = false;
+
+  for (auto &F : M) {
+    if (F.empty()) continue;
+    if (F.getSection().startswith("$__ALASKA__")) continue;
+
+    // Each site changes the CFG, so batch one at a time and recompute the
+    // analyses in between.
+    while (true) {
+      auto &LI = FAM.getResult<LoopAnalysis>(F);
+      auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+      auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+      auto &AA = FAM.getResult<AAManager>(F);
+
+      auto trs = alaska::extractTranslations(F);
+      BatchSite site;
+      bool found = false;
+      for (auto &tr : trs) {
+        if (findSite(*tr, LI, DT, SE, AA, site)) {
+          found = true;
+          break;
+        }
+      }
+      if (!found) break;
+
+      batchSite(site, SE);
+      FAM.invalidate(F, PreservedAnalyses::none());
+      NumBatched++;
+      changed = true;
+    }
+  }
+
+  return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
@@ -170,6 +170,8 @@ static bool mightBlock(llvm::Function &F) {
   };
 
   if (not F.empty()) return false;
+  // Compiled by alaska in another translation unit (see AlaskaSummaryPass)
+  if (F.hasFnAttribute("alaska_managed")) return false;
 
   auto name = F.getName();
   if (blocking_whitelist.find(name) != blocking_whitelist.end()) {
@@ -203,9 +205,11 @@ llvm::PreservedAnalyses AlaskaEscapePass::run(llvm::Module &M, llvm::ModuleAnaly
       "alaska.root",
       "alaska.translate",
       "alaska.release",
-      // Gross functions in libc that we handle ourselves
-      "strstr",
-      "strchr",
+      "alaska.translate_batch",
+      // libc functions that runtime/stub defines (string.h, qsort, strto*,
+      // ...) need no entry here: the stubs are linked into the module before
+      // this pass, so calls to them reach a body compiled by alaska, which
+      // is never escaped.
 
       "llvm.stackrestore",
 
@@ -256,13 +260,15 @@ llvm::PreservedAnalyses AlaskaEscapePass::run(llvm::Module &M, llvm::ModuleAnaly
 
   for (auto &F : M) {
     FunctionEscapeInfo info;
+    // Functions with no body here, which are not compiled by alaska elsewhere
+    bool external = F.empty() && !F.hasFnAttribute("alaska_managed");
 
     if (functions_to_ignore.find(std::string(F.getName())) == functions_to_ignore.end()) {
       info.isEscape = true;
 
       // Handle vararg functions a bit specially.
       if (F.isVarArg() && !relax_vararg_escape()) {
-        // If the function is empty, we must escape varargs
+        // If we can't see the body, we must escape varargs
         if (F.empty()) {
           info.escape_varargs = true;
         } else {
@@ -284,14 +290,14 @@ llvm::PreservedAnalyses AlaskaEscapePass::run(llvm::Module &M, llvm::ModuleAnaly
 
       for (auto &arg : F.args()) {
         int no = arg.getArgNo();
-        if (F.empty()) {
+        if (external) {
           info.args.insert(no);
         } else if (arg.getType()->isPointerTy() && arg.hasAttribute(Attribute::ByVal)) {
           info.args.insert(no);
         }
       }
 
-      if (F.empty()) {
+      if (external) {
         F.addFnAttr("alaska_escape");
       }
     }
@@ -0,0 +1,306 @@
+#include <alaska/Passes.h>
+#include <alaska/Translations.h>
+#include <alaska/Utils.h>
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include <set>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "alaska-version-loops"
+
+STATISTIC(NumVersioned, "Number of loops versioned into a safepoint-free fast path");
+STATISTIC(NumNoGuard, "Number of loops with calls that no invariant branch avoids");
+
+
+// Loops bigger than this are not duplicated.
+static cl::opt<unsigned> MaxLoopSize("alaska-version-max-size", cl::Hidden, cl::init(512));
+// The most invariant branches the runtime check may test.
+static cl::opt<unsigned> MaxGuards("alaska-version-max-guards", cl::Hidden, cl::init(4));
+
+
+// A loop invariant branch, and the successor the fast version always takes.
+struct Guard {
+  BranchInst *branch;
+  unsigned hot;
+};
+
+
+// Could a barrier happen while this call is running? This mirrors which calls
+// PinTrackingPass turns into statepoints, except that simple functions have no
+// polls, so a thread cannot stop in one.
+static bool mayReachSafepoint(CallBase *call) {
+  if (isa<IntrinsicInst>(call)) return false;
+  if (call->isInlineAsm()) return false;
+  if (auto *func = call->getCalledFunction()) {
+    if (func->getName().startswith("alaska.")) return false;
+    if (func->hasFnAttribute("alaska_is_simple")) return false;
+  }
+  return true;
+}
+
+
+static Value *getBase(Value *ptr) {
+  while (true) {
+    if (auto *gep = dyn_cast<GetElementPtrInst>(ptr)) {
+      ptr = gep->getPointerOperand();
+    } else if (auto *cast = dyn_cast<BitCastInst>(ptr)) {
+      ptr = cast->getOperand(0);
+    } else {
+      return ptr;
+    }
+  }
+}
+
+
+// Is there a handle in this loop that a safepoint-free version could translate
+// once in the preheader? That is either a loop invariant pointer, or a pointer
+// loaded from a loop invariant address, which LICM can hoist once there are no
+// calls left in the loop.
+static bool hasInvariantHandleAccess(Loop *L) {
+  for (auto *BB : L->blocks()) {
+    for (auto &I : *BB) {
+      Value *ptr = getLoadStorePointerOperand(&I);
+      if (ptr == nullptr || !alaska::shouldTranslate(ptr)) continue;
+
+      auto *base = getBase(ptr);
+      if (L->isLoopInvariant(base)) return true;
+      if (auto *load = dyn_cast<LoadInst>(base)) {
+        if (L->isLoopInvariant(load->getPointerOperand())) return true;
+      }
+    }
+  }
+  return false;
+}
+
+
+// Find the blocks of L reachable from its header if every guard always takes
+// its hot successor.
+static void reachableBlocks(Loop *L, ArrayRef<Guard> guards, SmallPtrSetImpl<BasicBlock *> &seen) {
+  SmallVector<BasicBlock *, 16> work;
+  seen.clear();
+  seen.insert(L->getHeader());
+  work.push_back(L->getHeader());
+
+  while (!work.empty()) {
+    auto *bb = work.pop_back_val();
+    auto *term = bb->getTerminator();
+    for (unsigned i = 0; i < term->getNumSuccessors(); i++) {
+      bool cut = false;
+      for (auto &g : guards) {
+        if (g.branch == term && g.hot != i) cut = true;
+      }
+      auto *succ = term->getSuccessor(i);
+      if (cut || !L->contains(succ)) continue;
+      if (seen.insert(succ).second) work.push_back(succ);
+    }
+  }
+}
+
+
+static unsigned countReachable(ArrayRef<CallBase *> calls, SmallPtrSetImpl<BasicBlock *> &live) {
+  unsigned count = 0;
+  for (auto *call : calls) {
+    if (live.contains(call->getParent())) count++;
+  }
+  return count;
+}
+
+
+// Pick a set of loop invariant branches which, when they all go one way, make
+// every call that might reach a safepoint unreachable. This is greedy: each
+// step takes the branch direction that removes the most calls. Returns false
+// if there is no such set within MaxGuards branches.
+static bool findGuards(Loop *L, SmallVectorImpl<Guard> &guards) {
+  SmallVector<CallBase *, 8> calls;
+  SmallVector<BranchInst *, 8> candidates;
+  unsigned size = 0;
+
+  for (auto *BB : L->blocks()) {
+    for (auto &I : *BB) {
+      size++;
+      if (auto *call = dyn_cast<CallBase>(&I)) {
+        if (mayReachSafepoint(call)) calls.push_back(call);
+      }
+    }
+
+    auto *br = dyn_cast<BranchInst>(BB->getTerminator());
+    if (br == nullptr || !br->isConditional()) continue;
+    if (br->getSuccessor(0) == br->getSuccessor(1)) continue;
+    if (!L->isLoopInvariant(br->getCondition())) continue;
+    candidates.push_back(br);
+  }
+
+  // A loop with no calls is already safepoint-free, and one that is too big
+  // isn't worth duplicating.
+  if (calls.empty() || size > MaxLoopSize) return false;
+
+  BasicBlock *latch = L->getLoopLatch();
+  SmallPtrSet<BasicBlock *, 16> live;
+  reachableBlocks(L, guards, live);
+  unsigned remaining = countReachable(calls, live);
+
+  while (remaining > 0) {
+    if (guards.size() >= MaxGuards) return false;
+
+    Guard best = {nullptr, 0};
+    unsigned best_remaining = remaining;
+    for (auto *br : candidates) {
+      bool used = false;
+      for (auto &g : guards)
+        used |= g.branch == br;
+      if (used) continue;
+
+      for (unsigned hot = 0; hot < 2; hot++) {
+        guards.push_back({br, hot});
+        reachableBlocks(L, guards, live);
+        guards.pop_back();
+
+        // The fast version must still be a loop.
+        if (!live.contains(latch)) continue;
+        unsigned r = countReachable(calls, live);
+        if (r < best_remaining) {
+          best = {br, hot};
+          best_remaining = r;
+        }
+      }
+    }
+
+    if (best.branch == nullptr) {
+      NumNoGuard++;
+      return false;
+    }
+    guards.push_back(best);
+    remaining = best_remaining;
+  }
+
+  return true;
+}
+
+
+// Duplicate L. The check in the old preheader picks the fast version (L
+// itself) when every guard goes its hot way, and the original code (the clone)
+// otherwise. The guards in the fast version are then folded away, which
+// removes every call that could reach a safepoint from its body. Returns the
+// header of the clone.
+static BasicBlock *versionLoop(Loop *L, ArrayRef<Guard> guards, LoopInfo &LI, DominatorTree &DT) {
+  BasicBlock *checkBB = L->getLoopPreheader();
+  BasicBlock *header = L->getHeader();
+  BasicBlock *exit = L->getExitBlock();
+
+  // The old preheader becomes the check, and the fast loop gets a new one.
+  BasicBlock *ph = SplitBlock(
+      checkBB, checkBB->getTerminator(), &DT, &LI, nullptr, header->getName() + ".fast.ph");
+
+  ValueToValueMapTy VMap;
+  SmallVector<BasicBlock *, 8> slowBlocks;
+  Loop *slow = cloneLoopWithPreheader(ph, checkBB, L, VMap, ".slow", &LI, &DT, slowBlocks);
+  remapInstructionsInBlocks(slowBlocks, VMap);
+
+  // Both versions leave through the same exit block. Since the loop is in LCSSA
+  // form, the only uses of its values outside of it are the phis there, so they
+  // need an incoming value for each of the clone's exiting blocks.
+  for (auto &phi : exit->phis()) {
+    for (unsigned i = 0, n = phi.getNumIncomingValues(); i < n; i++) {
+      auto *from = phi.getIncomingBlock(i);
+      if (!L->contains(from)) continue;
+      Value *v = phi.getIncomingValue(i);
+      if (Value *mapped = VMap.lookup(v)) v = mapped;
+      phi.addIncoming(v, cast<BasicBlock>(VMap[from]));
+    }
+  }
+
+  IRBuilder<> b(checkBB->getTerminator());
+  Value *fast = nullptr;
+  for (auto &g : guards) {
+    // A guard need not run on every iteration, so its condition can be poison
+    // here, where it is evaluated unconditionally. Branching on poison is UB,
+    // so freeze it first (as SimpleLoopUnswitch does).
+    Value *cond = g.branch->getCondition();
+    cond = b.CreateFreeze(cond, cond->getName() + ".fr");
+    if (g.hot == 1) cond = b.CreateNot(cond);
+    fast = fast ? b.CreateAnd(fast, cond) : cond;
+  }
+  auto *term = checkBB->getTerminator();
+  b.CreateCondBr(fast, ph, slow->getLoopPreheader());
+  term->eraseFromParent();
+  DT.changeImmediateDominator(exit, checkBB);
+
+  // Fold the guards in the fast version. This invalidates the loop info and
+  // dominator tree, so the caller recomputes them.
+  for (auto &g : guards) {
+    auto *bb = g.branch->getParent();
+    g.branch->getSuccessor(1 - g.hot)->removePredecessor(bb);
+    BranchInst::Create(g.branch->getSuccessor(g.hot), g.branch);
+    g.branch->eraseFromParent();
+  }
+
+  return slow->getHeader();
+}
+
+
+PreservedAnalyses AlaskaLoopVersioningPass::run(Module &M, ModuleAnalysisManager &AM) {
+  bool changed = false;
+
+  for (auto &F : M) {
+    if (F.empty()) continue;
+    if (F.getSection().startswith("$__ALASKA__")) continue;
+
+    // Headers of the loops which have already been looked at, including both
+    // versions of every loop that was versioned.
+    std::set<BasicBlock *> done;
+
+    // Versioning changes the CFG, so do one loop at a time and recompute the
+    // analyses in between.
+    while (true) {
+      llvm::DominatorTree DT(F);
+      llvm::LoopInfo LI(DT);
+
+      Loop *target = nullptr;
+      SmallVector<Guard, 4> guards;
+      for (auto *L : LI.getLoopsInPreorder()) {
+        if (!L->isInnermost()) continue;
+        if (!done.insert(L->getHeader()).second) continue;
+
+        if (!L->isLoopSimplifyForm() || !L->isLCSSAForm(DT)) continue;
+        if (L->getExitBlock() == nullptr) continue;
+        if (!hasInvariantHandleAccess(L)) continue;
+
+        guards.clear();
+        if (findGuards(L, guards)) {
+          target = L;
+          break;
+        }
+      }
+
+      if (target == nullptr) break;
+
+      done.insert(versionLoop(target, guards, LI, DT));
+      removeUnreachableBlocks(F);
+
+      // Forget the headers which were just deleted. A block created later
+      // could reuse one of their addresses, and would wrongly be skipped.
+      std::set<BasicBlock *> live;
+      for (auto &bb : F)
+        live.insert(&bb);
+      for (auto it = done.begin(); it != done.end();) {
+        it = live.count(*it) ? std::next(it) : done.erase(it);
+      }
+      NumVersioned++;
+      changed = true;
+    }
+  }
+
+  return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
@@ -106,6 +106,14 @@ llvm::PreservedAnalyses AlaskaLowerPass::run(llvm::Module &M, llvm::ModuleAnalys
     }
   }
 
+  // Lower batched translation
+  if (auto func = M.getFunction("alaska.translate_batch")) {
+    auto batchFunc = M.getOrInsertFunction("alaska_translate_batch", func->getFunctionType());
+    for (auto call : collectCalls(M, "alaska.translate_batch")) {
+      call->setCalledFunction(batchFunc);
+    }
+  }
+
   // Lower alaska.root
   for (auto *call : collectCalls(M, "alaska.root")) {
     IRBuilder<> b(call);  // insert after the call
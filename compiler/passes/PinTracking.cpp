@@ -97,6 +97,10 @@ PreservedAnalyses PinTrackingPass::run(Module &M, ModuleAnalysisManager &AM) {
 
     F.setGC("coreclr");
     F.setSection(".text.alaska");
+#ifdef ALASKA_FRAME_POINTER_SCAN
+    // The barrier finds this function's callers by following frame pointers
+    F.addFnAttr("frame-pointer", "all");
+#endif
 
     // Extract all the translations from the function
     auto translations = alaska::extractTranslations(F);
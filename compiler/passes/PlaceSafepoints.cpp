@@ -53,6 +53,7 @@
 #include "llvm/Pass.h"
 
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/CFG.h"
 #include "llvm/Analysis/LoopInfo.h"
@@ -81,6 +82,8 @@ STATISTIC(NumBackedgeSafepoints, "Number of backedge safepoints inserted");
 
 STATISTIC(CallInLoop, "Number of loops without safepoints due to calls in loop");
 STATISTIC(FiniteExecution, "Number of loops without safepoints finite execution");
+STATISTIC(SmallLoops, "Number of loops without safepoints due to a small trip count");
+STATISTIC(NumCountedSafepoints, "Number of backedge safepoints that poll every N iterations");
 
 // Ignore opportunities to avoid placing safepoints on backedges, useful for
 // validation
@@ -102,6 +105,15 @@ static cl::opt<bool> NoEntry("alaska-spp-no-entry", cl::Hidden, cl::init(true));
 static cl::opt<bool> NoCall("alaska-spp-no-call", cl::Hidden, cl::init(true));
 static cl::opt<bool> NoBackedge("alaska-spp-no-backedge", cl::Hidden, cl::init(false));
 
+// Innermost loops only poll once every this many iterations, by counting down
+// on the backedge. This bounds the time to reach a safepoint by N iterations
+// of the loop body, rather than one. 1 polls every iteration.
+static cl::opt<unsigned> PollInterval("alaska-spp-poll-interval", cl::Hidden, cl::init(64));
+
+// Loops which provably run at most this many iterations get no backedge poll
+// at all. The enclosing code reaches one soon enough.
+static cl::opt<unsigned> SmallLoopTrips("alaska-spp-small-loop-trips", cl::Hidden, cl::init(32));
+
 namespace {
   /// An analysis pass whose purpose is to identify each of the backedges in
   /// the function which require a safepoint poll to be inserted.
@@ -113,6 +125,10 @@ namespace {
     /// pointing at the branch) which need a poll inserted.
     std::vector<Instruction *> PollLocations;
 
+    /// The subset of PollLocations which only need to poll once every
+    /// PollInterval iterations.
+    SmallPtrSet<Instruction *, 16> CountedPollLocations;
+
     /// True unless we're running alaska-spp-no-calls in which case we need to disable
     /// the call-dependent placement opts.
     bool CallSafepointsEnabled;
@@ -197,6 +213,18 @@ bool PlaceBackedgeSafepointsLegacyPass::runOnLoop(Loop *L) {
   BasicBlock *Header = L->getHeader();
   SmallVector<BasicBlock *, 16> LoopLatches;
   L->getLoopLatches(LoopLatches);
+
+  unsigned MaxTrips = SE->getSmallConstantMaxTripCount(L);
+  if (MaxTrips != 0 && MaxTrips <= SmallLoopTrips) {
+    LLVM_DEBUG(dbgs() << "skipping safepoint placement in small loop\n");
+    SmallLoops++;
+    return false;
+  }
+
+  // Tight loops poll on a countdown. Only innermost loops with one latch do,
+  // so there is a single counter per loop, and an outer loop never waits on
+  // N iterations of an inner one.
+  bool Counted = PollInterval > 1 && L->isInnermost() && LoopLatches.size() == 1;
   for (BasicBlock *Pred : LoopLatches) {
     assert(L->contains(Pred));
 
@@ -232,11 +260,44 @@ bool PlaceBackedgeSafepointsLegacyPass::runOnLoop(Loop *L) {
     LLVM_DEBUG(dbgs() << "[LSP] terminator instruction: " << *Term << "\n");
 
     PollLocations.push_back(Term);
+    if (Counted) CountedPollLocations.insert(Term);
   }
 
   return false;
 }
 
+
+/// Make the backedge block `Backedge` count down from PollInterval, and only
+/// branch through a new block (which is returned) on the way to `Header` when
+/// the count runs out. The poll goes in that block. `DT` is kept up to date.
+static BasicBlock *insertPollCountdown(
+    BasicBlock *Backedge, BasicBlock *Header, DominatorTree &DT) {
+  auto &Ctx = Header->getContext();
+  auto *Int32 = Type::getInt32Ty(Ctx);
+  auto *Interval = ConstantInt::get(Int32, PollInterval);
+
+  BasicBlock *PollBB = BasicBlock::Create(Ctx, "poll", Header->getParent(), Header);
+  BranchInst::Create(Header, PollBB);
+  for (auto &Phi : Header->phis())
+    Phi.addIncoming(Phi.getIncomingValueForBlock(Backedge), PollBB);
+
+  auto *Count = PHINode::Create(Int32, 3, "poll.count", &Header->front());
+  auto *OldTerm = Backedge->getTerminator();
+  auto *Next = BinaryOperator::CreateSub(Count, ConstantInt::get(Int32, 1), "poll.next", OldTerm);
+  auto *Expired = new ICmpInst(OldTerm, ICmpInst::ICMP_EQ, Next, ConstantInt::get(Int32, 0));
+  BranchInst::Create(PollBB, Header, Expired, Backedge);
+  OldTerm->eraseFromParent();
+
+  for (auto *Pred : predecessors(Header))
+    Count->addIncoming(Pred == Backedge ? (Value *)Next : Interval, Pred);
+
+  // The only way into the poll block is from the backedge, and the header
+  // already dominates both of its new predecessors, so nothing else moves.
+  DT.addNewBlock(PollBB, Backedge);
+
+  return PollBB;
+}
+
 bool PlaceSafepointsPass::runImpl(Function &F, const TargetLibraryInfo &TLI) {
   if (F.isDeclaration() || F.empty()) {
     // This is a declaration, nothing to do.  Must exit early to avoid crash in
@@ -331,8 +392,13 @@ bool PlaceSafepointsPass::runImpl(Function &F, const TargetLibraryInfo &TLI) {
         // the dominator tree once.  Alternatively, we could just keep it up to
         // date and use a more natural merged loop.
         SetVector<BasicBlock *> SplitBackedges;
+        bool Counted = PBS->CountedPollLocations.count(Term) && Headers.size() == 1;
         for (BasicBlock *Header : Headers) {
           BasicBlock *NewBB = SplitEdge(Term->getParent(), Header, &DT);
+          if (Counted) {
+            NewBB = insertPollCountdown(NewBB, Header, DT);
+            NumCountedSafepoints++;
+          }
           PollsNeeded.push_back(NewBB->getTerminator());
           NumBackedgeSafepoints++;
         }
@@ -342,6 +408,7 @@ bool PlaceSafepointsPass::runImpl(Function &F, const TargetLibraryInfo &TLI) {
         NumBackedgeSafepoints++;
       }
     }
+    assert(DT.verify(DominatorTree::VerificationLevel::Fast) && "poll placement broke the domtree");
   }
 
   if (enableEntrySafepoints(F)) {
@@ -0,0 +1,317 @@
+#include <alaska/Passes.h>
+#include <alaska/Translations.h>
+#include <alaska/Utils.h>
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <noelle/core/CallGraph.hpp>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "alaska-specialize"
+
+STATISTIC(NumClones, "Number of pre-translated clones created");
+STATISTIC(NumRedirected, "Number of call sites redirected to a pre-translated clone");
+STATISTIC(NumElided, "Number of translations removed from pre-translated clones");
+
+
+// The clones may add at most this percent to the size of the module...
+static cl::opt<unsigned> BudgetPercent("alaska-specialize-budget", cl::Hidden, cl::init(10));
+// ...but small modules always get at least this many instructions.
+static cl::opt<unsigned> BudgetMin("alaska-specialize-budget-min", cl::Hidden, cl::init(500));
+// Functions bigger than this are never cloned.
+static cl::opt<unsigned> MaxFunctionSize("alaska-specialize-max-size", cl::Hidden, cl::init(1000));
+
+
+// A clone of `func` which takes an extra, already translated, pointer for each
+// of the arguments in `args`.
+struct CloneKey {
+  Function *func;
+  std::vector<unsigned> args;
+  bool operator<(const CloneKey &o) const {
+    return std::tie(func, args) < std::tie(o.func, o.args);
+  }
+};
+
+// A call which could be redirected to a clone, and the raw pointer to pass
+// for each of the clone's extra arguments.
+struct CallSite {
+  CallInst *call;
+  std::vector<Value *> raw;
+};
+
+struct Candidate {
+  std::vector<CallSite> sites;
+  double benefit = 0;
+  unsigned cost = 0;
+};
+
+
+static unsigned functionSize(Function &F) {
+  unsigned size = 0;
+  for (auto &BB : F)
+    size += BB.size();
+  return size;
+}
+
+
+static bool canSpecialize(Function &F) {
+  if (F.empty() || F.isVarArg()) return false;
+  if (F.getName() == "main") return false;
+  if (F.getName().startswith("alaska")) return false;
+  if (F.getSection().startswith("$__ALASKA__")) return false;
+  return true;
+}
+
+
+// The value a translation is of, looking through alaska.root. Unlike
+// getRootAllocation(), this does not strip GEPs, as the translated pointer is
+// then not a pointer to the root.
+static Value *translatedValue(alaska::Translation &tr) {
+  Value *handle = tr.getHandle();
+  if (auto *call = dyn_cast<CallInst>(handle)) {
+    if (auto *func = call->getCalledFunction()) {
+      if (func->getName() == "alaska.root") handle = call->getArgOperand(0);
+    }
+  }
+  return handle;
+}
+
+static Argument *translatedArgument(alaska::Translation &tr) {
+  return dyn_cast<Argument>(translatedValue(tr));
+}
+
+
+// Which arguments of F does it translate? Only those are worth passing raw.
+static std::set<unsigned> translatedArguments(Function &F) {
+  std::set<unsigned> out;
+  for (auto &tr : alaska::extractTranslations(F)) {
+    if (auto *arg = translatedArgument(*tr)) out.insert(arg->getArgNo());
+  }
+  return out;
+}
+
+
+// Create the clone, and strip it of the translations of its raw arguments.
+// The raw pointers stay valid for the whole call, as the caller's translation
+// is live across it, which makes PinTrackingPass pin the handle.
+static Function *createClone(const CloneKey &key) {
+  Function &F = *key.func;
+  auto &ctx = F.getContext();
+
+  auto params = F.getFunctionType()->params().vec();
+  for (size_t i = 0; i < key.args.size(); i++)
+    params.push_back(PointerType::get(ctx, 0));
+  auto *type = FunctionType::get(F.getReturnType(), params, false);
+
+  auto *clone = Function::Create(
+      type, GlobalValue::InternalLinkage, F.getName() + ".pretranslated", F.getParent());
+
+  ValueToValueMapTy vmap;
+  for (auto &arg : F.args()) {
+    auto *new_arg = clone->getArg(arg.getArgNo());
+    new_arg->setName(arg.getName());
+    vmap[&arg] = new_arg;
+  }
+  SmallVector<ReturnInst *, 8> returns;
+  CloneFunctionInto(clone, &F, vmap, CloneFunctionChangeType::LocalChangesOnly, returns);
+
+  std::map<Argument *, Argument *> raw;
+  for (size_t i = 0; i < key.args.size(); i++) {
+    auto *arg = clone->getArg(key.args[i]);
+    auto *r = clone->getArg(F.arg_size() + i);
+    r->setName(arg->getName() + ".raw");
+    raw[arg] = r;
+  }
+
+  for (auto &tr : alaska::extractTranslations(*clone)) {
+    auto *arg = translatedArgument(*tr);
+    auto f = raw.find(arg);
+    if (arg == nullptr || f == raw.end()) continue;
+
+    auto *root = tr->getHandle();
+    tr->translation->replaceAllUsesWith(f->second);
+    for (auto *rel : tr->releases)
+      rel->eraseFromParent();
+    tr->translation->eraseFromParent();
+    if (auto *inst = dyn_cast<Instruction>(root)) {
+      if (inst->use_empty()) inst->eraseFromParent();
+    }
+    NumElided++;
+  }
+
+  return clone;
+}
+
+
+// Find the raw pointer for `val` at `call`: either a translation of it which
+// is live across the call, or (in a clone) the raw argument it came in with.
+static Value *findRaw(CallInst *call, Value *val, std::vector<std::unique_ptr<alaska::Translation>> &trs,
+    DominatorTree &DT, std::map<Value *, Value *> &raw_args) {
+  auto f = raw_args.find(val);
+  if (f != raw_args.end()) return f->second;
+
+  for (auto &tr : trs) {
+    if (translatedValue(*tr) != val) continue;
+    if (!DT.dominates(tr->translation, call)) continue;
+    if (!tr->isLive(call)) continue;
+    return tr->translation;
+  }
+  return nullptr;
+}
+
+
+PreservedAnalyses AlaskaSpecializePass::run(Module &M, ModuleAnalysisManager &AM) {
+  noelle::CallGraph CG(
+      M, [](CallInst *) { return false; },
+      [](CallInst *) { return std::set<const Function *>(); });
+
+  std::map<Function *, std::set<unsigned>> translated;
+  unsigned module_size = 0;
+  for (auto &F : M) {
+    module_size += functionSize(F);
+    if (canSpecialize(F)) translated[&F] = translatedArguments(F);
+  }
+
+  // Group the call sites that could pass raw pointers by the clone they would
+  // call. A site is weighted by how deep in loops it is, and recursive callees
+  // are assumed to be hot.
+  std::map<CloneKey, Candidate> candidates;
+  for (auto &F : M) {
+    if (F.empty()) continue;
+    auto *node = CG.getFunctionNode(&F);
+    if (node == nullptr) continue;
+
+    std::unique_ptr<DominatorTree> DT;
+    std::unique_ptr<LoopInfo> LI;
+    std::vector<std::unique_ptr<alaska::Translation>> trs;
+    std::map<Value *, Value *> no_raw_args;
+
+    for (auto *edge : node->getOutgoingEdges()) {
+      auto *callee = edge->getCallee()->getFunction();
+      auto t = translated.find(callee);
+      if (t == translated.end() || t->second.empty()) continue;
+
+      bool recursive = CG.doesItBelongToASCC(callee);
+
+      for (auto *sub : edge->getSubEdges()) {
+        auto *call = dyn_cast<CallInst>(sub->getCaller()->getInstruction());
+        if (call == nullptr || call->getCalledFunction() != callee) continue;
+
+        if (DT == nullptr) {
+          DT = std::make_unique<DominatorTree>(F);
+          LI = std::make_unique<LoopInfo>(*DT);
+          trs = alaska::extractTranslations(F);
+        }
+
+        CloneKey key = {callee, {}};
+        CallSite site = {call, {}};
+        for (auto i : t->second) {
+          auto *raw = findRaw(call, call->getArgOperand(i), trs, *DT, no_raw_args);
+          if (raw == nullptr) continue;
+          key.args.push_back(i);
+          site.raw.push_back(raw);
+        }
+        if (key.args.empty()) continue;
+
+        double weight = 1;
+        for (unsigned d = 0; d < LI->getLoopDepth(call->getParent()); d++)
+          weight *= 8;
+        if (recursive) weight *= 4;
+
+        auto &c = candidates[key];
+        c.sites.push_back(site);
+        c.benefit += weight * key.args.size();
+        c.cost = functionSize(*callee);
+      }
+    }
+  }
+
+  // Pick the clones with the most benefit per instruction until the budget is
+  // spent.
+  std::vector<std::pair<CloneKey, Candidate *>> order;
+  for (auto &[key, c] : candidates) {
+    if (c.cost <= MaxFunctionSize) order.push_back({key, &c});
+  }
+  std::sort(order.begin(), order.end(), [](auto &a, auto &b) {
+    return a.second->benefit / a.second->cost > b.second->benefit / b.second->cost;
+  });
+
+  unsigned budget = std::max<unsigned>(BudgetMin, module_size * BudgetPercent / 100);
+  unsigned spent = 0;
+  std::map<CloneKey, Function *> clones;
+  for (auto &[key, c] : order) {
+    if (spent + c->cost > budget) continue;
+    spent += c->cost;
+    clones[key] = createClone(key);
+    NumClones++;
+  }
+
+  if (clones.empty()) return PreservedAnalyses::all();
+
+  auto redirect = [&](CallInst *call, Function *clone, const std::vector<Value *> &raw) {
+    std::vector<Value *> args(call->arg_begin(), call->arg_end());
+    args.insert(args.end(), raw.begin(), raw.end());
+    auto *new_call = CallInst::Create(clone, args, "", call);
+    new_call->setAttributes(call->getAttributes());
+    new_call->setCallingConv(call->getCallingConv());
+    new_call->setDebugLoc(call->getDebugLoc());
+    new_call->takeName(call);
+    call->replaceAllUsesWith(new_call);
+    call->eraseFromParent();
+    NumRedirected++;
+  };
+
+  // Redirect the sites found above.
+  for (auto &[key, clone] : clones) {
+    for (auto &site : candidates[key].sites)
+      redirect(site.call, clone, site.raw);
+  }
+
+  // Calls made from inside a clone can pass on the raw pointers it was given.
+  // This is what makes recursive functions call their own clone.
+  for (auto &[key, clone] : clones) {
+    std::map<Value *, Value *> raw_args;
+    for (size_t i = 0; i < key.args.size(); i++)
+      raw_args[clone->getArg(key.args[i])] = clone->getArg(key.func->arg_size() + i);
+
+    DominatorTree DT(*clone);
+    auto trs = alaska::extractTranslations(*clone);
+
+    std::vector<std::pair<CallInst *, CloneKey>> calls;
+    std::vector<std::vector<Value *>> raws;
+    for (auto &I : instructions(clone)) {
+      auto *call = dyn_cast<CallInst>(&I);
+      if (call == nullptr || call->getCalledFunction() == nullptr) continue;
+      auto t = translated.find(call->getCalledFunction());
+      if (t == translated.end()) continue;
+
+      CloneKey callee_key = {call->getCalledFunction(), {}};
+      std::vector<Value *> raw;
+      for (auto i : t->second) {
+        if (auto *r = findRaw(call, call->getArgOperand(i), trs, DT, raw_args)) {
+          callee_key.args.push_back(i);
+          raw.push_back(r);
+        }
+      }
+      if (clones.count(callee_key) == 0) continue;
+      calls.push_back({call, callee_key});
+      raws.push_back(raw);
+    }
+
+    for (size_t i = 0; i < calls.size(); i++)
+      redirect(calls[i].first, clones[calls[i].second], raws[i]);
+  }
+
+  return PreservedAnalyses::none();
+}
@@ -0,0 +1,95 @@
+#include <alaska/Passes.h>
+#include <alaska/Utils.h>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "alaska-summary"
+
+
+// Summaries of the functions in the rest of the program, merged at link time.
+static cl::opt<std::string> SummaryIn("alaska-summary-in", cl::Hidden,
+    cl::desc("Summaries of the functions defined in other translation units"));
+// Where to write the summaries of the functions defined in this module.
+static cl::opt<std::string> SummaryOut("alaska-summary-out", cl::Hidden,
+    cl::desc("Where to write summaries of this module's functions"));
+
+
+// Pointer arguments a function may be passed handles in. Byval arguments are
+// translated by the escape pass even when the callee has a body, so they never
+// hold handles.
+static std::string handleArguments(Function &F) {
+  std::string out;
+  for (auto &arg : F.args()) {
+    if (!arg.getType()->isPointerTy() || arg.hasAttribute(Attribute::ByVal)) continue;
+    if (!out.empty()) out += ",";
+    out += std::to_string(arg.getArgNo());
+  }
+  return out.empty() ? "-" : out;
+}
+
+
+// One line per function this module defines for the rest of the program:
+//
+//   <flags> <handle arguments> <name>
+//
+// where the flags are 'm' (compiled by alaska) and 's' (simple: it never
+// reaches a safepoint), and the handle arguments are a comma separated list,
+// or '-'.
+static void writeSummaries(Module &M) {
+  std::error_code ec;
+  raw_fd_ostream out(SummaryOut, ec, sys::fs::OF_Text);
+  if (ec) {
+    alaska::println("alaska: failed to write summaries to ", SummaryOut, ": ", ec.message());
+    exit(EXIT_FAILURE);
+  }
+
+  for (auto &F : M) {
+    if (F.empty() || F.hasLocalLinkage()) continue;
+    if (F.getSection().startswith("$__ALASKA__")) continue;
+
+    out << 'm';
+    if (F.hasFnAttribute("alaska_is_simple")) out << 's';
+    out << ' ' << handleArguments(F) << ' ' << F.getName() << '\n';
+  }
+}
+
+
+// Mark the declarations of functions which other translation units compiled
+// with alaska, so they are called like functions defined in this one: handles
+// are passed to them as they are, instead of being translated and pinned for
+// the call. Whether a function is simple is *not* imported, as it changes with
+// the function's body, and a stale summary would let callers keep translations
+// live across a safepoint. Which functions are managed (and their signatures)
+// rarely change, and a summary whose signature does not match is ignored.
+static void importSummaries(Module &M) {
+  auto buf = MemoryBuffer::getFile(SummaryIn);
+  // There is no index yet on the first build. Everything not defined here is
+  // then treated as external, which is always safe.
+  if (!buf) return;
+
+  SmallVector<StringRef, 0> lines;
+  (*buf)->getBuffer().split(lines, '\n', -1, false);
+  for (auto line : lines) {
+    auto [flags, rest] = line.split(' ');
+    auto [args, name] = rest.split(' ');
+    if (!flags.contains('m')) continue;
+
+    auto *F = M.getFunction(name);
+    if (F == nullptr || !F->empty()) continue;
+    if (handleArguments(*F) != args) continue;
+
+    F->addFnAttr("alaska_managed");
+  }
+}
+
+
+PreservedAnalyses AlaskaSummaryPass::run(Module &M, ModuleAnalysisManager &AM) {
+  if (!SummaryOut.empty()) writeSummaries(M);
+  if (!SummaryIn.empty()) importSummaries(M);
+  return PreservedAnalyses::all();
+}
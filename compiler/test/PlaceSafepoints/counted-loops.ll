@@ -0,0 +1,64 @@
+; RUN: opt %loadalaska -passes=alaska-place-safepoints -S %s | FileCheck %s
+
+; Two counted loops in one function. Each gets its own countdown and poll
+; block, and the second is placed with the dominator tree the first left
+; behind (the pass asserts the tree is still valid once all polls are in).
+
+define i64 @two_loops(ptr %a, ptr %b, i64 %n) {
+; CHECK-LABEL: @two_loops(
+entry:
+  br label %first
+
+; CHECK:       poll:
+; CHECK-NEXT:    call void @alaska_barrier_poll()
+; CHECK-NEXT:    br label %first
+; CHECK:       first:
+; CHECK-NEXT:    [[C1:%.*]] = phi i32 [ [[N1:%.*]], %first.first_crit_edge ], [ 64, %poll ], [ 64, %entry ]
+; CHECK:         br i1 {{.*}}, label %{{.*}}, label %first.first_crit_edge
+; CHECK:       first.first_crit_edge:
+; CHECK-NEXT:    [[N1]] = sub i32 [[C1]], 1
+; CHECK-NEXT:    [[EC1:%.*]] = icmp eq i32 [[N1]], 0
+; CHECK-NEXT:    br i1 [[EC1]], label %poll, label %first
+first:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %first ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %first ]
+  %pa = getelementptr inbounds i64, ptr %a, i64 %i
+  %va = load i64, ptr %pa
+  %s.next = add i64 %s, %va
+  %i.next = add nuw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %between, label %first
+
+between:
+  br label %second
+
+; CHECK:       poll1:
+; CHECK-NEXT:    call void @alaska_barrier_poll()
+; CHECK-NEXT:    br label %second
+; CHECK:       second:
+; CHECK-NEXT:    [[C2:%.*]] = phi i32 [ [[N2:%.*]], %second.second_crit_edge ], [ 64, %poll1 ], [ 64, %between ]
+; CHECK:         br i1 {{.*}}, label %{{.*}}, label %second.second_crit_edge
+; CHECK:       second.second_crit_edge:
+; CHECK-NEXT:    [[N2]] = sub i32 [[C2]], 1
+; CHECK-NEXT:    [[EC2:%.*]] = icmp eq i32 [[N2]], 0
+; CHECK-NEXT:    br i1 [[EC2]], label %poll1, label %second
+second:
+  %j = phi i64 [ 0, %between ], [ %j.next, %second ]
+  %t = phi i64 [ %s.next, %between ], [ %t.next, %second ]
+  %pb = getelementptr inbounds i64, ptr %b, i64 %j
+  %vb = load i64, ptr %pb
+  %t.next = add i64 %t, %vb
+  %j.next = add nuw i64 %j, 1
+  %done2 = icmp eq i64 %j.next, %n
+  br i1 %done2, label %exit, label %second
+
+exit:
+  ret i64 %t.next
+}
+
+define void @alaska_safepoint() {
+  call void @alaska_barrier_poll()
+  ret void
+}
+
+declare void @alaska_barrier_poll()
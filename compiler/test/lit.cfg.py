@@ -0,0 +1,26 @@
+# lit configuration for the compiler's opt/FileCheck tests. Run with
+#
+#   llvm-lit --param alaska_plugin=<build>/compiler/Alaska.so compiler/test
+#
+# opt and FileCheck are taken from --param llvm_bin=<dir> when given, and
+# from `llvm-config --bindir` otherwise.
+
+import os
+import subprocess
+
+import lit.formats
+
+config.name = 'Alaska'
+config.test_format = lit.formats.ShTest(True)
+config.suffixes = ['.ll']
+config.test_source_root = os.path.dirname(__file__)
+
+plugin = lit_config.params.get('alaska_plugin')
+if not plugin:
+    lit_config.fatal('pass --param alaska_plugin=<path to Alaska.so>')
+config.substitutions.append(('%loadalaska', '-load-pass-plugin=' + plugin))
+
+llvm_bin = lit_config.params.get('llvm_bin')
+if not llvm_bin:
+    llvm_bin = subprocess.check_output(['llvm-config', '--bindir'], text=True).strip()
+config.environment['PATH'] = os.path.pathsep.join([llvm_bin, os.environ.get('PATH', '')])
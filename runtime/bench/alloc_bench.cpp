@@ -0,0 +1,332 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// Single threaded benchmarks of the allocation and translation paths.
+
+#include "bench.hpp"
+#include <alaska/SizeClass.hpp>
+#include <alaska/alaska.hpp>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace alaska::bench;
+
+#define MB (1024L * 1024L)
+
+extern "C" void *alaska_translate_uncond(void *ptr);
+
+
+// halloc/hfree throughput for each size class: fill up a batch, then free it.
+ALASKA_BENCH(alloc_free) {
+  for (auto kind : all_allocators) {
+    auto *a = make_allocator(kind, rt);
+    for (int cls = 0; cls < alaska::num_size_classes; cls++) {
+      size_t size = alaska::class_to_size(cls);
+      long count = 64 * MB / size;
+      if (count > 20000) count = 20000;
+      long rounds = 4 * scale;
+      void **ptrs = (void **)calloc(count, sizeof(void *));
+
+      auto start = alaska_timestamp();
+      for (long r = 0; r < rounds; r++) {
+        for (long i = 0; i < count; i++)
+          ptrs[i] = a->alloc(size);
+        for (long i = 0; i < count; i++)
+          a->free(ptrs[i]);
+      }
+      auto end = alaska_timestamp();
+
+      char param[32];
+      snprintf(param, sizeof(param), "%zu", size);
+      report("alloc_free", a->name(), param, count * rounds * 2, end - start);
+      ::free(ptrs);
+    }
+    delete a;
+  }
+}
+
+
+// Many thread caches which each allocate a single object of every size class,
+// so every allocation has to get a fresh page from the heap. The time is per
+// page, and the RSS is what all those barely used pages cost.
+ALASKA_BENCH(page_acquire) {
+  long num_tcs = 64 * scale;
+  auto **tcs = (alaska::ThreadCache **)calloc(num_tcs, sizeof(void *));
+  auto **ptrs = (void **)calloc(num_tcs * alaska::num_size_classes, sizeof(void *));
+  long count = 0;
+
+  auto start = alaska_timestamp();
+  for (long t = 0; t < num_tcs; t++) {
+    tcs[t] = rt.new_threadcache();
+    for (int cls = 0; cls < alaska::num_size_classes; cls++) {
+      size_t size = alaska::class_to_size(cls);
+      if (alaska::should_be_huge_object(size)) break;
+      ptrs[count++] = tcs[t]->halloc(size);
+    }
+  }
+  auto end = alaska_timestamp();
+
+  char param[32];
+  snprintf(param, sizeof(param), "%ld_caches", num_tcs);
+  report("page_acquire", "alaska", param, count, end - start);
+
+  long i = 0;
+  for (long t = 0; t < num_tcs; t++) {
+    for (int cls = 0; cls < alaska::num_size_classes; cls++) {
+      if (alaska::should_be_huge_object(alaska::class_to_size(cls))) break;
+      tcs[t]->hfree(ptrs[i++]);
+    }
+    rt.del_threadcache(tcs[t]);
+  }
+  ::free(ptrs);
+  ::free(tcs);
+}
+
+
+// Grow many objects from 16 bytes to 64KiB, 1.5x at a time.
+ALASKA_BENCH(realloc_growth) {
+  for (auto kind : all_allocators) {
+    auto *a = make_allocator(kind, rt);
+    long count = 2000 * scale;
+    long ops = 0;
+
+    auto start = alaska_timestamp();
+    for (long i = 0; i < count; i++) {
+      size_t size = 16;
+      void *p = a->alloc(size);
+      while (size < 64 * 1024) {
+        size = size + size / 2;
+        p = a->realloc(p, size);
+        ops++;
+      }
+      a->free(p);
+    }
+    auto end = alaska_timestamp();
+
+    report("realloc_growth", a->name(), "16-65536", ops, end - start);
+    delete a;
+  }
+}
+
+
+// Query the size of live objects of mixed sizes.
+ALASKA_BENCH(get_size) {
+  const long count = 4096;
+  for (auto kind : all_allocators) {
+    auto *a = make_allocator(kind, rt);
+    void **ptrs = (void **)calloc(count, sizeof(void *));
+    for (long i = 0; i < count; i++)
+      ptrs[i] = a->alloc(16 + (i * 37) % 2048);
+
+    long rounds = 500 * scale;
+    size_t sum = 0;
+    auto start = alaska_timestamp();
+    for (long r = 0; r < rounds; r++) {
+      for (long i = 0; i < count; i++)
+        sum += a->usable_size(ptrs[i]);
+    }
+    auto end = alaska_timestamp();
+    do_not_optimize(sum);
+
+    report("get_size", a->name(), "mixed", count * rounds, end - start);
+    for (long i = 0; i < count; i++)
+      a->free(ptrs[i]);
+    ::free(ptrs);
+    delete a;
+  }
+}
+
+
+// Translate a working set of handles. The baseline is a plain pointer load.
+ALASKA_BENCH(translate) {
+  const long count = 4096;
+  long rounds = 2000 * scale;
+
+  auto run = [&](const char *alloc_name, const char *variant, void **ptrs, auto &&translate) {
+    uint64_t sum = 0;
+    auto start = alaska_timestamp();
+    for (long r = 0; r < rounds; r++) {
+      for (long i = 0; i < count; i++)
+        sum += *(uint8_t *)translate(ptrs[i]);
+    }
+    auto end = alaska_timestamp();
+    do_not_optimize(sum);
+    report("translate", alloc_name, variant, count * rounds, end - start);
+  };
+
+  for (auto kind : all_allocators) {
+    auto *a = make_allocator(kind, rt);
+    void **ptrs = (void **)calloc(count, sizeof(void *));
+    for (long i = 0; i < count; i++) {
+      ptrs[i] = a->alloc(64);
+    }
+
+    if (kind == AllocatorKind::Alaska) {
+      for (long i = 0; i < count; i++)
+        memset(alaska_translate(ptrs[i]), 0, 64);
+      run(a->name(), "translate", ptrs, [](void *p) {
+        return alaska_translate(p);
+      });
+      run(a->name(), "translate_uncond", ptrs, [](void *p) {
+        return alaska_translate_uncond(p);
+      });
+
+      // The same walk, translating 16 handles at a time.
+      uint64_t sum = 0;
+      void *batch[16];
+      auto start = alaska_timestamp();
+      for (long r = 0; r < rounds; r++) {
+        for (long i = 0; i < count; i += 16) {
+          alaska_translate_batch(ptrs + i, batch, 16);
+          for (int j = 0; j < 16; j++)
+            sum += *(uint8_t *)batch[j];
+        }
+      }
+      auto end = alaska_timestamp();
+      do_not_optimize(sum);
+      report("translate", a->name(), "translate_batch", count * rounds, end - start);
+    } else {
+      for (long i = 0; i < count; i++)
+        memset(ptrs[i], 0, 64);
+      run(a->name(), "raw", ptrs, [](void *p) {
+        return p;
+      });
+    }
+
+    for (long i = 0; i < count; i++)
+      a->free(ptrs[i]);
+    ::free(ptrs);
+    delete a;
+  }
+}
+
+
+
+// A barrier manager which stops a set of spinning threads, as if they were
+// application threads polling for safepoints. It stands in for the rt layer's
+// manager, which needs compiled code to stop (see rt/barrier.cpp).
+struct SpinBarrierManager final : public alaska::BarrierManager {
+  volatile bool requested = false;
+  volatile bool stop = false;
+  long parked = 0;
+  long nthreads = 0;
+
+  bool begin(void) override {
+    atomic_set_sync(requested, true);
+    while (atomic_get(parked) != nthreads) {
+    }
+    return true;
+  }
+
+  void end(void) override {
+    atomic_set_sync(requested, false);
+    while (atomic_get(parked) != 0) {
+    }
+  }
+
+  static void *worker(void *arg) {
+    auto *bm = (SpinBarrierManager *)arg;
+    // Like any thread that allocates, this one has a thread cache for each barrier to lock
+    auto *tc = alaska::Runtime::get().new_threadcache();
+    while (not atomic_get(bm->stop)) {
+      if (atomic_get(bm->requested)) {
+        atomic_inc(bm->parked, 1);
+        while (atomic_get(bm->requested)) {
+        }
+        atomic_dec(bm->parked, 1);
+      }
+    }
+    alaska::Runtime::get().del_threadcache(tc);
+    return NULL;
+  }
+};
+
+
+// Latency of Runtime::with_barrier, with an empty callback, with a number of
+// polling threads: locking every thread cache, stopping and resuming the
+// threads, and unlocking. The threads stop by spinning, not on a signal or a
+// patched poll, so this leaves out how long a real thread takes to reach one.
+ALASKA_BENCH(barrier) {
+  long max_threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  auto *old_manager = rt.barrier_manager;
+
+  for (long nthreads = 0; nthreads <= 8 && nthreads <= max_threads; nthreads = nthreads ? nthreads * 2 : 1) {
+    SpinBarrierManager bm;
+    bm.nthreads = nthreads;
+    rt.barrier_manager = &bm;
+
+    pthread_t threads[8];
+    for (long i = 0; i < nthreads; i++)
+      pthread_create(&threads[i], NULL, SpinBarrierManager::worker, &bm);
+
+    long rounds = 10000 * scale;
+    auto start = alaska_timestamp();
+    for (long r = 0; r < rounds; r++) {
+      rt.with_barrier([] {});
+    }
+    auto end = alaska_timestamp();
+
+    atomic_set_sync(bm.stop, true);
+    for (long i = 0; i < nthreads; i++)
+      pthread_join(threads[i], NULL);
+
+    char param[32];
+    snprintf(param, sizeof(param), "%ld_threads", nthreads);
+    report("with_barrier", "alaska", param, rounds, end - start);
+  }
+
+  rt.barrier_manager = old_manager;
+}
+
+
+// Compaction throughput (objects moved per second) on pages where every other
+// object has been freed. The baseline copies the same number of objects with
+// memcpy, which is a lower bound on the work compaction has to do.
+ALASKA_BENCH(compaction) {
+  const size_t sizes[] = {16, 64, 256, 1024};
+  for (size_t size : sizes) {
+    long count = 32 * MB / size;
+    char param[32];
+    snprintf(param, sizeof(param), "%zu", size);
+
+    AlaskaAllocator a(rt);
+    void **ptrs = (void **)calloc(count, sizeof(void *));
+    for (long i = 0; i < count; i++)
+      ptrs[i] = a.alloc(size);
+    for (long i = 0; i < count; i += 2) {
+      a.free(ptrs[i]);
+      ptrs[i] = NULL;
+    }
+
+    auto start = alaska_timestamp();
+    long moved = rt.heap.compact_sizedpages();
+    auto end = alaska_timestamp();
+    report("compaction", "alaska", param, moved, end - start);
+
+    for (long i = 0; i < count; i++)
+      if (ptrs[i]) a.free(ptrs[i]);
+    ::free(ptrs);
+
+    // Baseline: just copy the objects that had to move.
+    long copies = moved > 0 ? moved : count / 2;
+    char *src = (char *)calloc(copies, size);
+    char *dst = (char *)calloc(copies, size);
+    start = alaska_timestamp();
+    for (long i = 0; i < copies; i++)
+      memcpy(dst + i * size, src + i * size, size);
+    end = alaska_timestamp();
+    do_not_optimize(dst[0]);
+    report("compaction", "memcpy", param, copies, end - start);
+    ::free(src);
+    ::free(dst);
+  }
+}
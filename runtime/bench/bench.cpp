@@ -0,0 +1,68 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// Helpers shared by alaska_bench and alaska_frag.
+
+#include "bench.hpp"
+#include <unistd.h>
+#include <sys/resource.h>
+
+namespace alaska::bench {
+  long scale = 1;
+  long max_threads = 0;
+  FILE *output = stdout;
+
+
+  Allocator *make_allocator(AllocatorKind kind, alaska::Runtime &rt) {
+    switch (kind) {
+      case AllocatorKind::Alaska:
+        return new AlaskaAllocator(rt);
+      case AllocatorKind::Malloc:
+        return new MallocAllocator();
+      case AllocatorKind::AlaskaPerCpu:
+        return new AlaskaPerCpuAllocator(rt, false);
+      case AllocatorKind::AlaskaPerCpuLocked:
+        return new AlaskaPerCpuAllocator(rt, true);
+    }
+    return nullptr;
+  }
+
+
+  void report(const char *bench, const char *allocator, const char *param, long ops, uint64_t ns) {
+    double secs = ns / 1e9;
+    fprintf(output, "%s,%s,%s,%ld,%lu,%.0f,%.3f,%ld,%ld\n", bench, allocator, param, ops, ns,
+        secs > 0 ? ops / secs : 0.0, ops > 0 ? (double)ns / ops : 0.0, current_rss_kb(),
+        peak_rss_kb());
+    fflush(output);
+  }
+
+
+  long current_rss_kb(void) {
+    long size = 0, pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) return 0;
+    if (fscanf(f, "%ld %ld", &size, &pages) != 2) pages = 0;
+    fclose(f);
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+
+
+  long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+  }
+}  // namespace alaska::bench
+
+
+// The benchmark links the translation functions directly, without the rt
+// layer, so there is nobody to service a safepoint.
+extern "C" uint64_t alaska_barrier_poll() { return 0; }
@@ -0,0 +1,135 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+#pragma once
+
+#include <alaska.h>
+#include <alaska/Runtime.hpp>
+#include <alaska/ThreadCache.hpp>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace alaska::bench {
+
+  // Every benchmark runs once against alaska and once against the system
+  // allocator (the same idea as MALLOC_BYPASS in the rt layer), so a row for
+  // alaska always has a baseline right next to it.
+  struct Allocator {
+    virtual ~Allocator() = default;
+    virtual const char *name(void) = 0;
+    virtual void *alloc(size_t size) = 0;
+    virtual void free(void *ptr) = 0;
+    virtual void *realloc(void *ptr, size_t size) = 0;
+    virtual size_t usable_size(void *ptr) = 0;
+    // Turn whatever alloc() returned into something that can be dereferenced
+    virtual void *translate(void *ptr) { return ptr; }
+  };
+
+  struct AlaskaAllocator final : public Allocator {
+    alaska::Runtime &rt;
+    alaska::ThreadCache *tc;
+    AlaskaAllocator(alaska::Runtime &rt)
+        : rt(rt)
+        , tc(rt.new_threadcache()) {}
+    ~AlaskaAllocator() override { rt.del_threadcache(tc); }
+
+    const char *name(void) override { return "alaska"; }
+    void *alloc(size_t size) override { return tc->halloc(size); }
+    void free(void *ptr) override { tc->hfree(ptr); }
+    void *realloc(void *ptr, size_t size) override { return tc->hrealloc(ptr, size); }
+    size_t usable_size(void *ptr) override { return tc->get_size(ptr); }
+    void *translate(void *ptr) override { return alaska_translate(ptr); }
+  };
+
+  // The ALASKA_PER_CPU_CACHES path of the rt layer: every thread shares its CPU's caches. With
+  // `locked`, it skips the lock-free per-CPU stacks and always locks the CPU's thread cache.
+  struct AlaskaPerCpuAllocator final : public Allocator {
+    alaska::Runtime &rt;
+    bool locked;
+    AlaskaPerCpuAllocator(alaska::Runtime &rt, bool locked)
+        : rt(rt)
+        , locked(locked) {}
+
+    alaska::ThreadCache &tc(void) { return *rt.cpu_threadcache(alaska::current_cpu()); }
+
+    const char *name(void) override { return locked ? "alaska-percpu-locked" : "alaska-percpu"; }
+    void *alloc(size_t size) override {
+      return locked ? alaska::LockedThreadCache(tc())->halloc(size) : rt.cpu_halloc(size);
+    }
+    void free(void *ptr) override {
+      if (locked) {
+        alaska::LockedThreadCache(tc())->hfree(ptr);
+      } else {
+        rt.cpu_hfree(ptr);
+      }
+    }
+    void *realloc(void *ptr, size_t size) override {
+      return alaska::LockedThreadCache(tc())->hrealloc(ptr, size);
+    }
+    size_t usable_size(void *ptr) override { return alaska::LockedThreadCache(tc())->get_size(ptr); }
+    void *translate(void *ptr) override { return alaska_translate(ptr); }
+  };
+
+  struct MallocAllocator final : public Allocator {
+    const char *name(void) override { return "malloc"; }
+    void *alloc(size_t size) override { return ::malloc(size); }
+    void free(void *ptr) override { ::free(ptr); }
+    void *realloc(void *ptr, size_t size) override { return ::realloc(ptr, size); }
+    size_t usable_size(void *ptr) override { return malloc_usable_size(ptr); }
+  };
+
+  enum class AllocatorKind { Alaska, Malloc, AlaskaPerCpu, AlaskaPerCpuLocked };
+  static constexpr AllocatorKind all_allocators[] = {AllocatorKind::Alaska, AllocatorKind::Malloc};
+  // The per-CPU modes are only compared where sharing caches between threads matters.
+  static constexpr AllocatorKind percpu_allocators[] = {AllocatorKind::Alaska,
+      AllocatorKind::AlaskaPerCpu, AllocatorKind::AlaskaPerCpuLocked, AllocatorKind::Malloc};
+
+  // Allocators are per-thread: an AlaskaAllocator owns a ThreadCache.
+  Allocator *make_allocator(AllocatorKind kind, alaska::Runtime &rt);
+
+
+  // Where results are written (stdout unless -o is given)
+  extern FILE *output;
+
+  // Emit one machine-readable result row (CSV, see bench/main.cpp for the header)
+  void report(const char *bench, const char *allocator, const char *param, long ops, uint64_t ns);
+
+  // Resident set size of this process, in kilobytes
+  long current_rss_kb(void);
+  long peak_rss_kb(void);
+
+  // Multiplier applied to iteration counts (-s on the command line)
+  extern long scale;
+  // The largest thread count multithreaded benchmarks sweep up to (-t)
+  extern long max_threads;
+
+  // Keep the compiler from optimizing away a value.
+  template <typename T>
+  inline void do_not_optimize(T const &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+  }
+
+
+  using BenchFn = void (*)(alaska::Runtime &rt);
+  struct Registration {
+    const char *name;
+    BenchFn fn;
+    Registration *next;
+    Registration(const char *name, BenchFn fn);
+  };
+  Registration *registered_benchmarks(void);
+}  // namespace alaska::bench
+
+
+#define ALASKA_BENCH(bname)                                                            \
+  static void bench_##bname(alaska::Runtime &rt);                                      \
+  static alaska::bench::Registration bench_registration_##bname(#bname, bench_##bname); \
+  static void bench_##bname(alaska::Runtime &rt)
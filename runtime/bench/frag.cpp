@@ -0,0 +1,260 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// alaska_frag: a fragmentation workload modeled on the redis scenario in
+// test/redis/frag.redis, run directly against halloc/hfree. A key/value store
+// is populated, bulk deleted, refilled with a different size distribution and
+// then churned. RSS and live bytes are sampled along the way, once for each
+// reclamation mode:
+//
+//   malloc    the system allocator, as a baseline
+//   none      alaska with no compaction
+//   compact   alaska, compacting sized pages in place at every sample
+//   evacuate  alaska, moving small objects out to locality pages at every
+//             sample (ThreadCache::localize), then compacting
+//
+// Each mode runs in a forked child so RSS is not shared between them. Output
+// is CSV on stdout (or -o <file>):
+//
+//   mode,phase,ops,time_ms,live_kb,rss_kb,moved
+//
+// Usage: alaska_frag [-s scale] [-m mode] [-o out.csv]
+
+#include "bench.hpp"
+#include <alaska/Logger.hpp>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace alaska::bench;
+
+enum class Mode { Malloc, None, Compact, Evacuate };
+
+static const struct {
+  const char *name;
+  Mode mode;
+} modes[] = {
+    {"malloc", Mode::Malloc},
+    {"none", Mode::None},
+    {"compact", Mode::Compact},
+    {"evacuate", Mode::Evacuate},
+};
+
+
+struct Entry {
+  void *key;
+  void *value;
+  size_t size;
+};
+
+
+struct FragWorkload {
+  alaska::Runtime *rt;
+  Allocator *a;
+  const char *mode_name;
+  Mode mode;
+
+  Entry *entries;
+  long capacity;
+  long ops = 0;
+  long live_bytes = 0;
+  long moved = 0;
+  uint64_t start_ns;
+  unsigned int seed = 42;
+
+  void *alloc_touched(size_t size) {
+    void *p = a->alloc(size);
+    memset(a->translate(p), 0xAB, size);
+    live_bytes += size;
+    return p;
+  }
+
+  void release(void *p, size_t size) {
+    a->free(p);
+    live_bytes -= size;
+  }
+
+  void set(long i, size_t size) {
+    auto &e = entries[i];
+    if (e.key == nullptr) {
+      e.key = alloc_touched(24);
+    } else {
+      release(e.value, e.size);
+    }
+    e.value = alloc_touched(size);
+    e.size = size;
+    ops++;
+  }
+
+  void del(long i) {
+    auto &e = entries[i];
+    if (e.key == nullptr) return;
+    release(e.key, 24);
+    release(e.value, e.size);
+    e.key = e.value = nullptr;
+    e.size = 0;
+    ops++;
+  }
+
+  // Run whatever reclamation this mode uses, then emit a sample.
+  void sample(const char *phase) {
+    if (mode == Mode::Evacuate) {
+      for (long i = 0; i < capacity; i++) {
+        if (entries[i].key == nullptr) continue;
+        auto *tc = static_cast<AlaskaAllocator *>(a)->tc;
+        moved += tc->localize(entries[i].key, rt->localization_epoch);
+        moved += tc->localize(entries[i].value, rt->localization_epoch);
+      }
+      rt->localization_epoch++;
+    }
+    if (mode == Mode::Compact || mode == Mode::Evacuate) {
+      moved += rt->heap.compact_sizedpages();
+    }
+
+    auto now = alaska_timestamp();
+    fprintf(output, "%s,%s,%ld,%.1f,%ld,%ld,%ld\n", mode_name, phase, ops,
+        (now - start_ns) / 1e6, live_bytes / 1024, current_rss_kb(), moved);
+    fflush(output);
+  }
+
+  size_t mixed_size(void) {
+    // Mostly small values with a tail of larger ones.
+    unsigned r = rand_r(&seed) % 100;
+    if (r < 60) return 16 + rand_r(&seed) % 112;
+    if (r < 90) return 128 + rand_r(&seed) % 896;
+    return 1024 + rand_r(&seed) % 7168;
+  }
+
+  void run(void) {
+    long sample_every = capacity / 8;
+    start_ns = alaska_timestamp();
+    sample("start");
+
+    // debug populate N key 240
+    long first = capacity * 7 / 10;
+    for (long i = 0; i < first; i++) {
+      set(i, 240);
+      if (i % sample_every == 0) sample("populate_240");
+    }
+    // debug populate N key 492
+    for (long i = first; i < capacity; i++) {
+      set(i, 492);
+      if (i % sample_every == 0) sample("populate_492");
+    }
+    sample("populated");
+
+    // Bulk delete: expire a random 75% of the keys.
+    for (long i = 0; i < capacity; i++) {
+      if (rand_r(&seed) % 4 != 0) del(i);
+      if (i % sample_every == 0) sample("bulk_delete");
+    }
+    sample("deleted");
+
+    // Size shift: refill with a different, mixed size distribution.
+    for (long i = 0; i < capacity; i++) {
+      if (entries[i].key == nullptr && rand_r(&seed) % 2 == 0) set(i, mixed_size());
+      if (i % sample_every == 0) sample("size_shift");
+    }
+    sample("shifted");
+
+    // Churn: random overwrites and deletes.
+    for (long n = 0; n < capacity * 2; n++) {
+      long i = rand_r(&seed) % capacity;
+      if (rand_r(&seed) % 3 == 0) {
+        del(i);
+      } else {
+        set(i, mixed_size());
+      }
+      if (n % sample_every == 0) sample("churn");
+    }
+    sample("end");
+
+    for (long i = 0; i < capacity; i++)
+      del(i);
+  }
+};
+
+
+static void run_mode(const char *name, Mode mode) {
+  alaska::Runtime *rt = nullptr;
+  Allocator *a;
+  if (mode == Mode::Malloc) {
+    a = new MallocAllocator();
+  } else {
+    rt = new alaska::Runtime();
+    a = new AlaskaAllocator(*rt);
+  }
+
+  FragWorkload w;
+  w.rt = rt;
+  w.a = a;
+  w.mode_name = name;
+  w.mode = mode;
+  w.capacity = 100000 * scale;
+  w.entries = (Entry *)calloc(w.capacity, sizeof(Entry));
+  w.run();
+
+  ::free(w.entries);
+  delete a;
+  delete rt;
+}
+
+
+int main(int argc, char **argv) {
+  const char *only = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:m:o:")) != -1) {
+    switch (opt) {
+      case 's':
+        scale = atol(optarg);
+        if (scale < 1) scale = 1;
+        break;
+      case 'm':
+        only = optarg;
+        break;
+      case 'o':
+        output = fopen(optarg, "w");
+        if (output == NULL) {
+          fprintf(stderr, "could not open %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-s scale] [-m mode] [-o out.csv]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  alaska::set_log_level(LOG_WARN);
+  fprintf(output, "mode,phase,ops,time_ms,live_kb,rss_kb,moved\n");
+  fflush(output);
+
+  for (auto &m : modes) {
+    if (only != NULL && strcmp(only, m.name) != 0) continue;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      run_mode(m.name, m.mode);
+      exit(EXIT_SUCCESS);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "mode %s failed\n", m.name);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (output != stdout) fclose(output);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// Thousands of threads which each allocate a few small objects and then sit
+// idle, like a server with a thread per connection. With a cache per thread
+// each of them owns a page of every size class it touched, and a handle slab.
+// With a cache per CPU (ALASKA_PER_CPU_CACHES in the rt layer, through
+// Runtime::cpu_halloc) they share one per core. The row to look at is rss_kb, taken while the threads are idle.
+// Each mode runs in its own child process, so its RSS is not the last one's.
+
+#include "bench.hpp"
+#include <alaska/PerCpu.hpp>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace alaska::bench;
+
+
+enum class CacheMode { PerThread, PerCpu, Malloc };
+
+struct IdleThreads {
+  alaska::Runtime *rt;
+  CacheMode mode;
+  pthread_barrier_t allocated;
+  pthread_barrier_t done;
+};
+
+static const size_t idle_sizes[] = {16, 32, 64, 128, 256, 512, 1024, 2048};
+static constexpr int num_idle_sizes = sizeof(idle_sizes) / sizeof(idle_sizes[0]);
+
+
+static void *idle_worker(void *arg) {
+  auto &s = *(IdleThreads *)arg;
+  void *objects[num_idle_sizes];
+
+  alaska::ThreadCache *tc = nullptr;
+  if (s.mode == CacheMode::PerThread) tc = s.rt->new_threadcache();
+
+  for (int i = 0; i < num_idle_sizes; i++) {
+    if (s.mode == CacheMode::Malloc) {
+      objects[i] = ::malloc(idle_sizes[i]);
+    } else if (s.mode == CacheMode::PerCpu) {
+      objects[i] = s.rt->cpu_halloc(idle_sizes[i]);
+    } else {
+      objects[i] = alaska::LockedThreadCache(*tc)->halloc(idle_sizes[i]);
+    }
+  }
+
+  pthread_barrier_wait(&s.allocated);
+  // ... idle, until every thread has been measured
+  pthread_barrier_wait(&s.done);
+
+  for (int i = 0; i < num_idle_sizes; i++) {
+    if (s.mode == CacheMode::Malloc) {
+      ::free(objects[i]);
+    } else if (s.mode == CacheMode::PerCpu) {
+      s.rt->cpu_hfree(objects[i]);
+    } else {
+      alaska::LockedThreadCache(*tc)->hfree(objects[i]);
+    }
+  }
+  if (tc != nullptr) s.rt->del_threadcache(tc);
+  return NULL;
+}
+
+
+static void run_idle_threads(alaska::Runtime &rt, CacheMode mode, const char *name, long nthreads) {
+  IdleThreads s;
+  s.rt = &rt;
+  s.mode = mode;
+  pthread_barrier_init(&s.allocated, NULL, nthreads + 1);
+  pthread_barrier_init(&s.done, NULL, nthreads + 1);
+
+  // The threads don't do much, so don't give them much stack either
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, 64 * 1024);
+
+  auto *threads = new pthread_t[nthreads];
+  auto start = alaska_timestamp();
+  for (long i = 0; i < nthreads; i++) {
+    if (pthread_create(&threads[i], &attr, idle_worker, &s) != 0) {
+      fprintf(stderr, "idle_threads: could not create thread %ld\n", i);
+      _exit(1);
+    }
+  }
+  pthread_barrier_wait(&s.allocated);
+
+  char param[32];
+  snprintf(param, sizeof(param), "%ld_threads", nthreads);
+  report("idle_threads", name, param, nthreads * num_idle_sizes, alaska_timestamp() - start);
+
+  pthread_barrier_wait(&s.done);
+  for (long i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+
+  delete[] threads;
+  pthread_attr_destroy(&attr);
+  pthread_barrier_destroy(&s.allocated);
+  pthread_barrier_destroy(&s.done);
+}
+
+
+ALASKA_BENCH(idle_threads) {
+  struct {
+    CacheMode mode;
+    const char *name;
+  } modes[] = {
+      {CacheMode::PerThread, "alaska"},
+      {CacheMode::PerCpu, "alaska-percpu"},
+      {CacheMode::Malloc, "malloc"},
+  };
+
+  for (auto &m : modes) {
+    fflush(output);
+    pid_t pid = fork();
+    if (pid == 0) {
+      run_idle_threads(rt, m.mode, m.name, 400 * scale);
+      fflush(output);
+      _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (not WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "idle_threads: %s failed\n", m.name);
+    }
+  }
+}
@@ -0,0 +1,107 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// alaska_bench: microbenchmarks of the core runtime. Results are written as
+// CSV to stdout (or -o <file>) so they can be diffed between builds:
+//
+//   bench,allocator,param,ops,ns,ops_per_sec,ns_per_op,rss_kb,peak_rss_kb
+//
+// Usage: alaska_bench [-l] [-s scale] [-t max_threads] [-o out.csv] [filter...]
+
+#include "bench.hpp"
+#include <alaska/Logger.hpp>
+#include <string.h>
+#include <unistd.h>
+
+namespace alaska::bench {
+  static Registration *registrations = nullptr;
+
+  Registration::Registration(const char *name, BenchFn fn)
+      : name(name)
+      , fn(fn) {
+    // Append so benchmarks run in the order they are declared in each file
+    next = nullptr;
+    Registration **cur = &registrations;
+    while (*cur != nullptr)
+      cur = &(*cur)->next;
+    *cur = this;
+  }
+
+  Registration *registered_benchmarks(void) { return registrations; }
+}  // namespace alaska::bench
+
+
+static bool matches(const char *name, int nfilters, char **filters) {
+  if (nfilters == 0) return true;
+  for (int i = 0; i < nfilters; i++) {
+    if (strstr(name, filters[i]) != NULL) return true;
+  }
+  return false;
+}
+
+
+int main(int argc, char **argv) {
+  using namespace alaska::bench;
+  bool list = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "ls:t:o:")) != -1) {
+    switch (opt) {
+      case 'l':
+        list = true;
+        break;
+      case 's':
+        scale = atol(optarg);
+        if (scale < 1) scale = 1;
+        break;
+      case 't':
+        max_threads = atol(optarg);
+        break;
+      case 'o':
+        output = fopen(optarg, "w");
+        if (output == NULL) {
+          fprintf(stderr, "could not open %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-l] [-s scale] [-t max_threads] [-o out.csv] [filter...]\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (max_threads < 1) max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  int nfilters = argc - optind;
+  char **filters = argv + optind;
+
+  if (list) {
+    for (auto *r = registered_benchmarks(); r != nullptr; r = r->next)
+      printf("%s\n", r->name);
+    return EXIT_SUCCESS;
+  }
+
+  alaska::set_log_level(LOG_WARN);
+  // Nothing here stops the world on a timer, so let the barrier benchmark run them back to back
+  alaska::Configuration config;
+  config.min_barrier_interval = 0;
+  alaska::Runtime rt(config);
+
+  fprintf(output, "bench,allocator,param,ops,ns,ops_per_sec,ns_per_op,rss_kb,peak_rss_kb\n");
+  for (auto *r = registered_benchmarks(); r != nullptr; r = r->next) {
+    if (!matches(r->name, nfilters, filters)) continue;
+    r->fn(rt);
+  }
+
+  if (output != stdout) fclose(output);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// The runtime's memory routines (core/memops.cpp), which the mem* stubs call,
+// against the ones in the libc this benchmark is linked with.
+
+#include "bench.hpp"
+#include <string.h>
+
+using namespace alaska::bench;
+
+
+struct MemRoutines {
+  const char *name;
+  void *(*copy)(void *, const void *, size_t);
+  void *(*move)(void *, const void *, size_t);
+  void *(*set)(void *, int, size_t);
+  int (*cmp)(const void *, const void *, size_t);
+};
+
+static const MemRoutines mem_routines[] = {
+    {"alaska", __alaska_memcpy, __alaska_memmove, __alaska_memset, __alaska_memcmp},
+    {"libc", memcpy, memmove, memset, memcmp},
+};
+
+
+// Each op on sizes from 8B to 2MiB, on warm buffers. An op on a buffer of
+// `size` bytes counts as one op.
+ALASKA_BENCH(memops) {
+  const size_t max_size = 2 * 1024 * 1024;
+  // Room for memmove to shift by half a buffer
+  auto *a = (uint8_t *)aligned_alloc(64, max_size * 2);
+  auto *b = (uint8_t *)aligned_alloc(64, max_size * 2);
+  memset(a, 1, max_size * 2);
+  memset(b, 1, max_size * 2);
+
+  for (size_t size = 8; size <= max_size; size *= 8) {
+    long iters = (256L * 1024 * 1024 / size) * scale;
+    if (iters > 20'000'000 * scale) iters = 20'000'000 * scale;
+    char param[64];
+
+    for (auto &r : mem_routines) {
+      snprintf(param, sizeof(param), "memcpy/%zu", size);
+      auto start = alaska_timestamp();
+      for (long i = 0; i < iters; i++) {
+        r.copy(a, b, size);
+        do_not_optimize(a[0]);
+      }
+      report("memops", r.name, param, iters, alaska_timestamp() - start);
+
+      // Overlapping, in the direction that has to copy backward
+      snprintf(param, sizeof(param), "memmove/%zu", size);
+      start = alaska_timestamp();
+      for (long i = 0; i < iters; i++) {
+        r.move(a + size / 2 + 1, a, size);
+        do_not_optimize(a[0]);
+      }
+      report("memops", r.name, param, iters, alaska_timestamp() - start);
+
+      snprintf(param, sizeof(param), "memset/%zu", size);
+      start = alaska_timestamp();
+      for (long i = 0; i < iters; i++) {
+        r.set(a, (int)i, size);
+        do_not_optimize(a[0]);
+      }
+      report("memops", r.name, param, iters, alaska_timestamp() - start);
+
+      // Equal buffers, so every byte is compared
+      memset(a, 1, max_size * 2);
+      snprintf(param, sizeof(param), "memcmp/%zu", size);
+      int sum = 0;
+      start = alaska_timestamp();
+      for (long i = 0; i < iters; i++)
+        sum += r.cmp(a, b, size);
+      report("memops", r.name, param, iters, alaska_timestamp() - start);
+      do_not_optimize(sum);
+    }
+  }
+
+  ::free(a);
+  ::free(b);
+}
@@ -0,0 +1,206 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// The two ways a safepoint poll can stop a thread (see rt/barrier.cpp):
+// "patch" polls are a 2 byte nop that the barrier overwrites with ud2 (SIGILL),
+// and "guard" polls (ALASKA_POLL_GUARD_PAGE) are a load from a polling page
+// that the barrier makes unreadable (SIGSEGV). These compare what a poll costs
+// when there is no barrier, what it costs to arm a barrier, and how long it
+// takes a spinning thread to notice.
+
+#include "bench.hpp"
+
+#ifdef __x86_64__
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <initializer_list>
+
+using namespace alaska::bench;
+
+
+static uint8_t *map_poll_page(void) {
+  auto *page = (uint8_t *)mmap(
+      NULL, 4096, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+  if (page == MAP_FAILED) {
+    perror("mmap");
+    abort();
+  }
+  return page;
+}
+
+
+// The cost of a poll in a loop which otherwise does very little.
+ALASKA_BENCH(poll_steady) {
+  long iters = 100'000'000 * scale;
+  auto *page = map_poll_page();
+
+  auto start = alaska_timestamp();
+  for (long i = 0; i < iters; i++)
+    asm volatile("" ::: "memory");
+  auto end = alaska_timestamp();
+  report("poll_steady", "none", "loop", iters, end - start);
+
+  start = alaska_timestamp();
+  for (long i = 0; i < iters; i++)
+    asm volatile(".byte 0x66, 0x90" ::: "memory");
+  end = alaska_timestamp();
+  report("poll_steady", "patch", "nop2", iters, end - start);
+
+  start = alaska_timestamp();
+  for (long i = 0; i < iters; i++)
+    asm volatile("testb %%al, %0" ::"m"(*page) : "cc", "memory");
+  end = alaska_timestamp();
+  report("poll_steady", "guard", "load", iters, end - start);
+
+  munmap(page, 4096);
+}
+
+
+// The cost of arming and disarming a barrier for a program with a number of
+// polls. Patch polls each have to be rewritten (twice), while guard polls
+// need two mprotect calls no matter how many there are.
+ALASKA_BENCH(poll_arm) {
+  long rounds = 1000 * scale;
+  auto *page = map_poll_page();
+
+  for (long npolls : {100L, 1000L, 10000L, 100000L}) {
+    char param[32];
+    snprintf(param, sizeof(param), "%ld_polls", npolls);
+
+    // Spread the polls out like they would be in real code.
+    size_t text_size = round_up(npolls * 64, 4096);
+    auto *text = (uint8_t *)mmap(
+        NULL, text_size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    auto start = alaska_timestamp();
+    for (long r = 0; r < rounds; r++) {
+      for (long i = 0; i < npolls; i++)
+        __atomic_store_n((uint16_t *)(text + i * 64), 0x0B'0F, __ATOMIC_RELEASE);
+      __builtin___clear_cache((char *)text, (char *)text + text_size);
+      for (long i = 0; i < npolls; i++)
+        __atomic_store_n((uint16_t *)(text + i * 64), 0x90'66, __ATOMIC_RELEASE);
+      __builtin___clear_cache((char *)text, (char *)text + text_size);
+    }
+    auto end = alaska_timestamp();
+    report("poll_arm", "patch", param, rounds, end - start);
+
+    start = alaska_timestamp();
+    for (long r = 0; r < rounds; r++) {
+      mprotect(page, 4096, PROT_NONE);
+      mprotect(page, 4096, PROT_READ);
+    }
+    end = alaska_timestamp();
+    report("poll_arm", "guard", param, rounds, end - start);
+
+    munmap(text, text_size);
+  }
+
+  munmap(page, 4096);
+}
+
+
+// A thread spinning in a loop made of nothing but a poll, and the time it
+// takes to trap once the barrier is armed.
+static uint8_t *spin_code;
+static sigjmp_buf spin_env;
+static volatile bool spinning = false;
+static volatile uint64_t trapped_at = 0;
+
+static void spin_handler(int sig, siginfo_t *info, void *ctx) {
+  trapped_at = alaska_timestamp();
+  siglongjmp(spin_env, 1);
+}
+
+static void *spin_thread(void *) {
+  if (sigsetjmp(spin_env, 1) == 0) {
+    atomic_set_sync(spinning, true);
+    ((void (*)(void))spin_code)();
+  }
+  return NULL;
+}
+
+ALASKA_BENCH(poll_latency) {
+  long rounds = 200 * scale;
+  auto *page = map_poll_page();
+  spin_code = (uint8_t *)mmap(
+      NULL, 4096, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  struct sigaction sa, old_ill, old_segv;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_flags = SA_SIGINFO;
+  sa.sa_sigaction = spin_handler;
+  sigaction(SIGILL, &sa, &old_ill);
+  sigaction(SIGSEGV, &sa, &old_segv);
+
+  for (const char *mode : {"patch", "guard"}) {
+    bool guard = strcmp(mode, "guard") == 0;
+
+    // patch: `nop2; jmp .-4`, guard: `test %al, (page); jmp .-9`
+    memset(spin_code, 0xCC, 64);
+    if (guard) {
+      uint32_t addr = (uint32_t)(uintptr_t)page;
+      uint8_t code[] = {0x84, 0x04, 0x25, 0, 0, 0, 0, 0xEB, 0xF7};
+      memcpy(code + 3, &addr, sizeof(addr));
+      memcpy(spin_code, code, sizeof(code));
+    } else {
+      uint8_t code[] = {0x66, 0x90, 0xEB, 0xFC};
+      memcpy(spin_code, code, sizeof(code));
+    }
+    __builtin___clear_cache((char *)spin_code, (char *)spin_code + 64);
+
+    uint64_t total = 0, max = 0;
+    for (long r = 0; r < rounds; r++) {
+      spinning = false;
+      trapped_at = 0;
+      pthread_t thread;
+      pthread_create(&thread, NULL, spin_thread, NULL);
+      while (not atomic_get(spinning)) {
+      }
+      // Let it get going
+      usleep(100);
+
+      auto armed_at = alaska_timestamp();
+      if (guard) {
+        mprotect(page, 4096, PROT_NONE);
+      } else {
+        __atomic_store_n((uint16_t *)spin_code, 0x0B'0F, __ATOMIC_RELEASE);
+        __builtin___clear_cache((char *)spin_code, (char *)spin_code + 2);
+      }
+      pthread_join(thread, NULL);
+
+      uint64_t latency = trapped_at - armed_at;
+      total += latency;
+      if (latency > max) max = latency;
+
+      if (guard) {
+        mprotect(page, 4096, PROT_READ);
+      } else {
+        __atomic_store_n((uint16_t *)spin_code, 0x90'66, __ATOMIC_RELEASE);
+      }
+    }
+
+    report("poll_latency", mode, "mean", rounds, total);
+    report("poll_latency", mode, "max", 1, max);
+  }
+
+  sigaction(SIGILL, &old_ill, NULL);
+  sigaction(SIGSEGV, &old_segv, NULL);
+  munmap(spin_code, 4096);
+  munmap(page, 4096);
+}
+
+#endif
@@ -0,0 +1,345 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// Multithreaded allocation benchmarks where objects are freed by a different
+// thread than the one that allocated them. This stresses the remote release
+// paths (SizedPage::release_remote, HandleSlab::release_remote and the
+// ShardedFreeList swap). test/mt_bench.c runs the same workloads through the
+// compiled rt layer, where background compaction is also running.
+
+#include "bench.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace alaska::bench;
+
+
+struct Worker;
+using WorkerFn = void (*)(Worker &w);
+
+struct Worker {
+  long id;
+  long nthreads;
+  Allocator *a;
+  void *shared;
+  pthread_barrier_t *start;
+  WorkerFn fn;
+  long ops = 0;
+  unsigned int seed;
+};
+
+
+static void *worker_entry(void *arg) {
+  auto &w = *(Worker *)arg;
+  pthread_barrier_wait(w.start);
+  w.fn(w);
+  return NULL;
+}
+
+
+// Run `fn` on `nthreads` threads (each with its own allocator) and report the
+// throughput of all of them together.
+static void run_threads(alaska::Runtime &rt, AllocatorKind kind, const char *bench, long nthreads,
+    WorkerFn fn, void *shared) {
+  Worker *workers = new Worker[nthreads];
+  pthread_t *threads = new pthread_t[nthreads];
+  pthread_barrier_t start;
+  pthread_barrier_init(&start, NULL, nthreads + 1);
+
+  for (long i = 0; i < nthreads; i++) {
+    auto &w = workers[i];
+    w.id = i;
+    w.nthreads = nthreads;
+    w.a = make_allocator(kind, rt);
+    w.shared = shared;
+    w.start = &start;
+    w.fn = fn;
+    w.seed = i + 1;
+    pthread_create(&threads[i], NULL, worker_entry, &w);
+  }
+
+  pthread_barrier_wait(&start);
+  auto begin = alaska_timestamp();
+  for (long i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+  auto end = alaska_timestamp();
+
+  long ops = 0;
+  const char *name = workers[0].a->name();
+  for (long i = 0; i < nthreads; i++)
+    ops += workers[i].ops;
+
+  char param[32];
+  snprintf(param, sizeof(param), "%ld_threads", nthreads);
+  report(bench, name, param, ops, end - begin);
+
+  // Only tear the allocators down once every thread is done, since objects
+  // from one thread's cache may have been freed by any of the others.
+  for (long i = 0; i < nthreads; i++)
+    delete workers[i].a;
+  pthread_barrier_destroy(&start);
+  delete[] threads;
+  delete[] workers;
+}
+
+
+// Call `cb` with 1, 2, 4, ... threads, up to and including max_threads.
+template <typename Fn>
+static void sweep_threads(Fn &&cb) {
+  for (long n = 1; n < max_threads; n *= 2)
+    cb(n);
+  cb(max_threads);
+}
+
+static size_t random_size(Worker &w, size_t min, size_t max) {
+  return min + rand_r(&w.seed) % (max - min);
+}
+
+
+
+// Larson: each thread randomly replaces objects in an array of slots. After
+// every round the arrays are passed to the next thread, so most frees are of
+// objects allocated by somebody else.
+struct Larson {
+  long nslots;
+  long rounds;
+  long ops_per_round;
+  void ***slots;
+  pthread_barrier_t barrier;
+};
+
+static void larson_worker(Worker &w) {
+  auto &l = *(Larson *)w.shared;
+
+  void **mine = l.slots[w.id];
+  for (long j = 0; j < l.nslots; j++)
+    mine[j] = w.a->alloc(random_size(w, 16, 512));
+  w.ops += l.nslots;
+  pthread_barrier_wait(&l.barrier);
+
+  for (long round = 1; round <= l.rounds; round++) {
+    void **arr = l.slots[(w.id + round) % w.nthreads];
+    for (long k = 0; k < l.ops_per_round; k++) {
+      long j = rand_r(&w.seed) % l.nslots;
+      w.a->free(arr[j]);
+      arr[j] = w.a->alloc(random_size(w, 16, 512));
+    }
+    w.ops += l.ops_per_round * 2;
+    pthread_barrier_wait(&l.barrier);
+  }
+
+  void **arr = l.slots[(w.id + l.rounds + 1) % w.nthreads];
+  for (long j = 0; j < l.nslots; j++)
+    w.a->free(arr[j]);
+  w.ops += l.nslots;
+}
+
+ALASKA_BENCH(larson) {
+  for (auto kind : all_allocators) {
+    sweep_threads([&](long nthreads) {
+      Larson l;
+      l.nslots = 1000;
+      l.rounds = 20;
+      l.ops_per_round = 10000 * scale;
+      l.slots = new void **[nthreads];
+      for (long i = 0; i < nthreads; i++)
+        l.slots[i] = new void *[l.nslots];
+      pthread_barrier_init(&l.barrier, NULL, nthreads);
+
+      run_threads(rt, kind, "larson", nthreads, larson_worker, &l);
+
+      pthread_barrier_destroy(&l.barrier);
+      for (long i = 0; i < nthreads; i++)
+        delete[] l.slots[i];
+      delete[] l.slots;
+    });
+  }
+}
+
+
+
+// Producer/consumer: threads are paired up, and one side of each pair
+// allocates objects and hands them over a ring buffer to the other, which
+// frees them. With an odd thread count the last thread does both.
+#define RING_SIZE 1024
+struct Ring {
+  void *items[RING_SIZE];
+  alignas(64) unsigned long head = 0;
+  alignas(64) unsigned long tail = 0;
+};
+
+struct ProdCons {
+  long items;
+  Ring *rings;
+};
+
+static void prodcons_worker(Worker &w) {
+  auto &pc = *(ProdCons *)w.shared;
+  auto &ring = pc.rings[w.id / 2];
+  bool paired = (w.id | 1) < w.nthreads;
+
+  if (not paired) {
+    for (long i = 0; i < pc.items; i++) {
+      void *p = w.a->alloc(random_size(w, 16, 256));
+      do_not_optimize(p);
+      w.a->free(p);
+    }
+    w.ops += pc.items * 2;
+    return;
+  }
+
+  if (w.id % 2 == 0) {
+    for (long i = 0; i < pc.items; i++) {
+      void *p = w.a->alloc(random_size(w, 16, 256));
+      while (__atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) - ring.head >= RING_SIZE) {
+        sched_yield();
+      }
+      ring.items[ring.head % RING_SIZE] = p;
+      __atomic_store_n(&ring.head, ring.head + 1, __ATOMIC_RELEASE);
+    }
+  } else {
+    for (long i = 0; i < pc.items; i++) {
+      while (__atomic_load_n(&ring.head, __ATOMIC_ACQUIRE) == ring.tail) {
+        sched_yield();
+      }
+      w.a->free(ring.items[ring.tail % RING_SIZE]);
+      __atomic_store_n(&ring.tail, ring.tail + 1, __ATOMIC_RELEASE);
+    }
+  }
+  w.ops += pc.items;
+}
+
+ALASKA_BENCH(prodcons) {
+  for (auto kind : all_allocators) {
+    sweep_threads([&](long nthreads) {
+      ProdCons pc;
+      pc.items = 200000 * scale;
+      pc.rings = new Ring[(nthreads + 1) / 2];
+      run_threads(rt, kind, "prodcons", nthreads, prodcons_worker, &pc);
+      delete[] pc.rings;
+    });
+  }
+}
+
+
+
+// xmalloc: every thread allocates batches of objects and posts them to the
+// mailbox of the next thread, then frees whatever has been posted to its own.
+#define XMALLOC_BATCH 64
+struct Batch {
+  Batch *next;
+  void *objects[XMALLOC_BATCH];
+};
+
+struct Mailbox {
+  ck::mutex lock;
+  Batch *batches = nullptr;
+};
+
+struct XMalloc {
+  long batches;
+  Mailbox *mailboxes;
+  pthread_barrier_t barrier;
+};
+
+static long xmalloc_drain(Worker &w, Mailbox &box) {
+  Batch *b;
+  {
+    ck::scoped_lock l(box.lock);
+    b = box.batches;
+    box.batches = nullptr;
+  }
+
+  long freed = 0;
+  while (b != nullptr) {
+    Batch *next = b->next;
+    for (int i = 0; i < XMALLOC_BATCH; i++)
+      w.a->free(b->objects[i]);
+    freed += XMALLOC_BATCH;
+    ::free(b);
+    b = next;
+  }
+  return freed;
+}
+
+static void xmalloc_worker(Worker &w) {
+  auto &x = *(XMalloc *)w.shared;
+  auto &mine = x.mailboxes[w.id];
+  auto &next = x.mailboxes[(w.id + 1) % w.nthreads];
+
+  for (long i = 0; i < x.batches; i++) {
+    auto *b = (Batch *)::malloc(sizeof(Batch));
+    for (int j = 0; j < XMALLOC_BATCH; j++) {
+      b->objects[j] = w.a->alloc(random_size(w, 16, 256));
+    }
+    w.ops += XMALLOC_BATCH;
+
+    {
+      ck::scoped_lock l(next.lock);
+      b->next = next.batches;
+      next.batches = b;
+    }
+
+    w.ops += xmalloc_drain(w, mine);
+  }
+
+  pthread_barrier_wait(&x.barrier);
+  w.ops += xmalloc_drain(w, mine);
+}
+
+ALASKA_BENCH(xmalloc) {
+  for (auto kind : all_allocators) {
+    sweep_threads([&](long nthreads) {
+      XMalloc x;
+      x.batches = 4000 * scale;
+      x.mailboxes = new Mailbox[nthreads];
+      pthread_barrier_init(&x.barrier, NULL, nthreads);
+      run_threads(rt, kind, "xmalloc", nthreads, xmalloc_worker, &x);
+      pthread_barrier_destroy(&x.barrier);
+      delete[] x.mailboxes;
+    });
+  }
+}
+
+
+
+// Each thread replaces objects in a small private working set, so nearly every
+// operation can be served from a cache. This is where the per-CPU modes
+// differ: alaska-percpu serves small objects from rseq-protected per-CPU
+// stacks, while alaska-percpu-locked takes the CPU's thread cache lock on
+// every call, and stalls whenever a thread holding it is preempted.
+static void churn_worker(Worker &w) {
+  const long nslots = 64;
+  long iters = 200000 * scale;
+  void *slots[nslots];
+  for (long j = 0; j < nslots; j++)
+    slots[j] = w.a->alloc(random_size(w, 16, 512));
+
+  for (long i = 0; i < iters; i++) {
+    long j = rand_r(&w.seed) % nslots;
+    w.a->free(slots[j]);
+    slots[j] = w.a->alloc(random_size(w, 16, 512));
+  }
+
+  for (long j = 0; j < nslots; j++)
+    w.a->free(slots[j]);
+  w.ops += 2 * (iters + nslots);
+}
+
+ALASKA_BENCH(percpu_churn) {
+  for (auto kind : percpu_allocators) {
+    sweep_threads([&](long nthreads) {
+      run_threads(rt, kind, "percpu_churn", nthreads, churn_worker, nullptr);
+    });
+  }
+}
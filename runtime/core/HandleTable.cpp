@@ -38,14 +38,28 @@ namespace alaska {
 
     uintptr_t table_start = config.handle_table_location;
     m_capacity = HandleTable::initial_capacity;
+    // A handle has the top bit set because the table's location does (see Mapping::encode). The
+    // table can grow until the next bit up would be needed, so it can be as big as its location.
+    m_max_capacity = table_start / HandleTable::slab_size;
+    ALASKA_ASSERT(m_max_capacity >= m_capacity, "the handle table location is too low");
+    size_t reservation = m_max_capacity * HandleTable::slab_size;
 
-    // Attempt to allocate the initial memory for the table.
-    m_table = (Mapping *)mmap((void *)table_start, m_capacity * HandleTable::slab_size,
-        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    // Reserve all of it, without committing any memory.
+    m_table = (Mapping *)mmap((void *)table_start, reservation, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
 
-    // Validate that the table was allocated
-    ALASKA_ASSERT(
-        m_table != MAP_FAILED, "failed to allocate handle table. Maybe one is already allocated?");
+    // Validate that the table was allocated (kernels older than MAP_FIXED_NOREPLACE take the
+    // address as a hint instead)
+    ALASKA_ASSERT(m_table != MAP_FAILED && (uintptr_t)m_table == table_start,
+        "failed to allocate handle table. Maybe one is already allocated?");
+
+    // Then commit the initial capacity
+    int r = mprotect(m_table, m_capacity * HandleTable::slab_size, PROT_READ | PROT_WRITE);
+    ALASKA_ASSERT(r == 0, "failed to commit the handle table");
+
+    m_slabs = (HandleSlab **)mmap(NULL, m_max_capacity * sizeof(HandleSlab *),
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ALASKA_ASSERT(m_slabs != MAP_FAILED, "failed to allocate the handle table's slab list");
 
 
     log_debug("handle table successfully allocated to %p with initial capacity of %lu", m_table,
@@ -54,7 +68,7 @@ namespace alaska {
 
   HandleTable::~HandleTable() {
     // Release the handle table back to the OS
-    int r = munmap(m_table, m_capacity * HandleTable::slab_size);
+    int r = munmap(m_table, m_max_capacity * HandleTable::slab_size);
     if (r < 0) {
       log_error("failed to release handle table memory to the OS");
     } else {
@@ -62,41 +76,48 @@ namespace alaska {
     }
 
 
-    for (auto &slab : m_slabs) {
+    for (slabidx_t i = 0; i < m_num_slabs; i++) {
+      auto *slab = m_slabs[i];
       log_trace("deleting slab %p (idx: %lu)", slab, slab->idx);
       delete (slab);
     }
+    munmap(m_slabs, m_max_capacity * sizeof(HandleSlab *));
   }
 
 
-  void HandleTable::grow() {
-    auto new_cap = m_capacity * HandleTable::growth_factor;
-    // Scale the capacity of the handle table
-    log_debug("Growing handle table. New capacity: %lu, old: %lu", new_cap, m_capacity);
+  void HandleTable::commit(slabidx_t idx) {
+    ck::scoped_lock lk(this->commit_lock);
+    // Someone else might have committed it while we waited
+    uint64_t old_cap = m_capacity;
+    if (idx < old_cap) return;
 
-    // Grow the mmap region
-    m_table = (alaska::Mapping *)mremap(
-        m_table, m_capacity * HandleTable::slab_size, new_cap * HandleTable::slab_size, 0, m_table);
+    auto new_cap = old_cap * HandleTable::growth_factor;
+    while (new_cap <= idx)
+      new_cap *= HandleTable::growth_factor;
+    if (new_cap > m_max_capacity) new_cap = m_max_capacity;
+    ALASKA_ASSERT(idx < new_cap, "the handle table is full");
 
-    m_capacity = new_cap;
+    // Scale the capacity of the handle table
+    log_debug("Growing handle table. New capacity: %lu, old: %lu", new_cap, old_cap);
 
-    if (m_table == MAP_FAILED) {
+    void *start = (void *)((uintptr_t)m_table + old_cap * HandleTable::slab_size);
+    int r = mprotect(start, (new_cap - old_cap) * HandleTable::slab_size, PROT_READ | PROT_WRITE);
+    if (r != 0) {
       perror("failed to grow handle table.\n");
     }
-    // Validate that the table was reallocated
-    ALASKA_ASSERT(m_table != MAP_FAILED, "failed to reallocate handle table during growth");
+    // Validate that the table was committed
+    ALASKA_ASSERT(r == 0, "failed to commit handle table during growth");
+
+    __atomic_store_n(&m_capacity, new_cap, __ATOMIC_RELEASE);
   }
 
   HandleSlab *HandleTable::fresh_slab(ThreadCache *new_owner) {
-    ck::scoped_lock lk(this->lock);
-
-    slabidx_t idx = m_slabs.size();
+    slabidx_t idx = __atomic_fetch_add(&m_num_slabs, 1, __ATOMIC_ACQ_REL);
     log_trace("Allocating a new slab at idx %d", idx);
 
     if (idx >= this->capacity()) {
       log_debug("New slab requires more capacity in the table");
-      grow();
-      ALASKA_ASSERT(idx < this->capacity(), "failed to grow handle table");
+      commit(idx);
     }
 
     // Allocate a new slab using the system allocator.
@@ -106,10 +127,10 @@ namespace alaska {
     sl->set_owner(new_owner);
 
     // Add the slab to the list of slabs and return it
-    m_slabs.push(sl);
+    __atomic_store_n(&m_slabs[idx], sl, __ATOMIC_RELEASE);
 
 #ifdef __riscv
-    auto max_handle = (uint64_t)m_slabs.size() * HandleTable::slab_capacity;
+    auto max_handle = (uint64_t)slab_count() * HandleTable::slab_capacity;
     __asm__ volatile("csrw 0xc5, %0" ::"rK"(max_handle) : "memory");
 #endif
 
@@ -122,7 +143,11 @@ namespace alaska {
       ck::scoped_lock lk(this->lock);
 
       // TODO: PERFORMANCE BAD HERE. POP FROM A LIST!
-      for (auto *slab : m_slabs) {
+      slabidx_t count = slab_count();
+      for (slabidx_t i = 0; i < count; i++) {
+        auto *slab = __atomic_load_n(&m_slabs[i], __ATOMIC_ACQUIRE);
+        // Still being made by fresh_slab
+        if (slab == nullptr) continue;
         log_trace("Attempting to allocate from slab %p (idx %lu)", slab, slab->idx);
         if (slab->get_owner() == nullptr && slab->allocator.num_free() > 0) {
           slab->set_owner(new_owner);
@@ -136,14 +161,12 @@ namespace alaska {
 
 
   HandleSlab *HandleTable::get_slab(slabidx_t idx) {
-    ck::scoped_lock lk(this->lock);
-
     log_trace("Getting slab %d", idx);
-    if (idx >= (slabidx_t)m_slabs.size()) {
+    if (idx >= slab_count()) {
       log_trace("Invalid slab requeset!");
       return nullptr;
     }
-    return m_slabs[idx];
+    return __atomic_load_n(&m_slabs[idx], __ATOMIC_ACQUIRE);
   }
 
   slabidx_t HandleTable::mapping_slab_idx(Mapping *m) const {
@@ -158,22 +181,21 @@ namespace alaska {
 
     // Dump the handle table in a nice debug output
     log_info("Handle Table:\n");
-    log_info(" - Size: %zu bytes\n", m_capacity * HandleTable::slab_size);
-    for (auto *slab : m_slabs) {
-      slab->dump(stream);
+    log_info(" - Size: %zu bytes\n", capacity() * HandleTable::slab_size);
+    for (slabidx_t i = 0; i < slab_count(); i++) {
+      if (m_slabs[i] != nullptr) m_slabs[i]->dump(stream);
     }
   }
 
 
   bool HandleTable::valid_handle(Mapping *m) const {
-    return mapping_slab_idx(m) < (slabidx_t)m_slabs.size();
+    return mapping_slab_idx(m) < slab_count();
   }
 
   void HandleTable::put(Mapping *m, alaska::ThreadCache *owner) {
     log_trace("Putting handle %p", m);
     // Validate that the handle is in this table
-    ALASKA_ASSERT(mapping_slab_idx(m) < (slabidx_t)m_slabs.size(),
-        "attempted to put a handle into the wrong table")
+    ALASKA_ASSERT(mapping_slab_idx(m) < slab_count(), "attempted to put a handle into the wrong table")
 
     // Get the slab that the handle is in
     auto *slab = m_slabs[mapping_slab_idx(m)];
@@ -182,6 +204,27 @@ namespace alaska {
     } else {
       slab->release_remote(m);
     }
+    // Nobody is allocating from it, so this might have been its last handle
+    if (slab->get_owner() == nullptr) release_if_free(slab);
+  }
+
+
+  void HandleTable::release_if_free(HandleSlab *slab) {
+    if (slab->allocator.num_free() != (long)HandleTable::slab_capacity || do_mlock) return;
+
+    // new_slab hands out unowned slabs with the lock held, so nobody can start allocating from
+    // it while we look. With every handle free, nobody can be freeing into it either.
+    ck::scoped_lock lk(this->lock);
+    if (slab->get_owner() != nullptr) return;
+    if (slab->allocator.num_free() != (long)HandleTable::slab_capacity) return;
+    // Already released, and not used since
+    if (slab->allocator.num_free_in_bump_allocator() == (long)HandleTable::slab_capacity) return;
+
+    log_debug("Releasing the memory of free slab %lu", slab->idx);
+    auto start = get_slab_start(slab->idx);
+    madvise(start, HandleTable::slab_size, MADV_DONTNEED);
+    // The free list was in that memory: start over from an empty slab
+    slab->allocator.configure(start, sizeof(alaska::Mapping), HandleTable::slab_capacity);
   }
 
 
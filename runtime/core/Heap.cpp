@@ -25,133 +25,169 @@ namespace alaska {
 
 
   PageManager::PageManager(void) {
-    auto prot = PROT_READ | PROT_WRITE;
-    auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
-    this->heap = mmap(NULL, alaska::heap_size, prot, flags, -1, 0);
-    ALASKA_ASSERT(
-        this->heap != MAP_FAILED, "Failed to allocate the heap's backing memory. Aborting.");
+    // Initialize the free lists w/ null, so the first allocation is a simple bump.
+    for (auto &fl : this->free_lists)
+      fl = nullptr;
+
+    // Reserve the first region up front, and set the bump allocator to its start.
+    add_region();
+  }
+
+  PageManager::~PageManager() {
+    for (long r = 0; r < num_regions; r++) {
+      log_debug("PageManager: Deallocating region at %p", this->regions[r]);
+      munmap(this->regions[r], alaska::heap_size);
+    }
+  }
+
 
-    // Set the bump allocator to the start of the heap.
-    this->bump = this->heap;
-    this->end = (void *)((uintptr_t)this->heap + alaska::heap_size);
+  void PageManager::add_region(void) {
+    ALASKA_ASSERT(num_regions < alaska::max_heap_regions, "Out of memory in the page manager.");
 
-    // Initialize the free list w/ null, so the first allocation is a simple bump.
-    this->free_list = nullptr;
+    void *region = mmap_heap_region();
+    ALASKA_ASSERT(((uintptr_t)region + alaska::heap_size) >> pt_address_bits == 0,
+        "The heap region is outside of what the page table can map.");
 
-    log_debug("PageManager: Heap allocated at %p", this->heap);
+    this->bump = region;
+    this->end = (void *)((uintptr_t)region + alaska::heap_size);
+    this->regions[num_regions] = region;
+    // Publish the region to contains() once it is written
+    __atomic_store_n(&num_regions, num_regions + 1, __ATOMIC_RELEASE);
+
+    log_debug("PageManager: Region %ld allocated at %p", num_regions - 1, region);
   }
 
-  PageManager::~PageManager() {
-    log_debug("PageManager: Deallocating heap at %p", this->heap);
-    munmap(this->heap, alaska::heap_size);
+
+  bool PageManager::contains(void *ptr) const {
+    long n = get_region_count();
+    for (long r = 0; r < n; r++) {
+      if (ptr >= regions[r] && (uintptr_t)ptr < (uintptr_t)regions[r] + alaska::heap_size)
+        return true;
+    }
+    return false;
   }
 
 
-  void *PageManager::alloc_page(void) {
+  static int span_order(long count) {
+    ALASKA_ASSERT(count > 0 && count <= alaska::spans_per_page && (count & (count - 1)) == 0,
+        "span counts must be a power of two, up to a page");
+    return __builtin_ctzl(count);
+  }
+
+
+  void *PageManager::alloc_spans(long count) {
     ck::scoped_lock lk(this->lock);  // TODO: don't lock.
+    void *spans = take_spans(span_order(count));
+    alloc_count += count;
+    return spans;
+  }
 
 
-    if (this->free_list != nullptr) {
-      // If we have a free page, pop it off the free list and return it.
-      FreePage *fp = this->free_list;
-      this->free_list = fp->next;
-      log_trace("PageManager: reusing free page at %p", fp);
-      alloc_count++;
+  void *PageManager::take_spans(int order) {
+    if (this->free_lists[order] != nullptr) {
+      // If we have a free run, pop it off the free list and return it.
+      FreePage *fp = this->free_lists[order];
+      this->free_lists[order] = fp->next;
+      log_trace("PageManager: reusing free spans at %p", fp);
       return (void *)fp;
     }
 
+    if (order + 1 < alaska::num_span_orders) {
+      // Split a run twice as long, and keep the second half for later.
+      void *spans = take_spans(order + 1);
+      FreePage *buddy = (FreePage *)((uintptr_t)spans + (alaska::span_size << order));
+      buddy->next = this->free_lists[order];
+      this->free_lists[order] = buddy;
+      return spans;
+    }
+
     // If we don't have a free page, we need to allocate a new one with the bump allocator.
+    if (unlikely(this->bump == this->end)) add_region();
     void *page = this->bump;
     log_trace("PageManager: bumping to %p", this->bump);
     this->bump = (void *)((uintptr_t)this->bump + alaska::page_size);
 
     log_trace("PageManager: end = %p", this->end);
 
-    // TODO: this is *so unlikely* to happen. This check is likely expensive and not needed.
-    ALASKA_ASSERT(page < this->end, "Out of memory in the page manager.");
-    alloc_count++;
-
     return page;
   }
 
-  void PageManager::free_page(void *page) {
+  void PageManager::free_spans(void *spans, long count) {
     // check that the pointer is within the heap and early return if it is not
-    if (unlikely(page < this->heap || page >= this->end)) {
+    if (unlikely(not contains(spans))) {
       return;
     }
 
+    int order = span_order(count);
     ck::scoped_lock lk(this->lock);  // TODO: don't lock.
 
-    // cast the page to a FreePage to store metadata in.
-    FreePage *fp = (FreePage *)page;
+    // cast the spans to a FreePage to store metadata in.
+    FreePage *fp = (FreePage *)spans;
 
     // Super simple: push to the free list.
-    fp->next = this->free_list;
-    this->free_list = fp;
+    fp->next = this->free_lists[order];
+    this->free_lists[order] = fp;
 
-    alloc_count--;
+    alloc_count -= count;
   }
 
 
-  static void *allocate_page_table(void) {
-    return alaska_internal_calloc(1LU << bits_per_pt_level, sizeof(void *));
+  static void *allocate_page_table(long bits) {
+    // mmapped, so the parts of a table which don't cover the heap are never committed.
+    return mmap_alloc((1LU << bits) * sizeof(void *));
   }
 
-  HeapPageTable::HeapPageTable(void *heap_start)
-      : heap_start(heap_start) {
+  HeapPageTable::HeapPageTable(void) {
     // Allocate the root of the page table. The subsequent mappings will be allocated on demand.
-    root = (alaska::HeapPage ***)allocate_page_table();
+    root = (alaska::HeapPage ***)allocate_page_table(pt_root_bits);
   }
   HeapPageTable::~HeapPageTable() {
     // Free all the entries.
+    for (long i = 0; i < (1L << pt_root_bits); i++) {
+      if (root[i] != nullptr) mmap_free(root[i], (1LU << pt_leaf_bits) * sizeof(void *));
+    }
+    mmap_free(root, (1LU << pt_root_bits) * sizeof(void *));
   }
 
 
 
-  alaska::HeapPage *HeapPageTable::get(void *page) {
-    auto *p = walk(page);
-    if (p == nullptr) return nullptr;
-    return *p;
-  }
-  alaska::HeapPage *HeapPageTable::get_unaligned(void *addr) {
-    uintptr_t heap_offset = (uintptr_t)addr - (uintptr_t)heap_start;
-    uintptr_t page_ind = heap_offset / alaska::page_size;
-    void *page = (void *)((uintptr_t)heap_start + page_ind * alaska::page_size);
-
-    auto *p = walk(page);
-    if (p == nullptr) return nullptr;
-    return *p;
+  void HeapPageTable::set(void *page, alaska::HeapPage *hp) {
+    __atomic_store_n(walk_alloc(page), hp, __ATOMIC_RELEASE);
   }
 
-  void HeapPageTable::set(void *page, alaska::HeapPage *hp) { *walk(page) = hp; }
-
+  void HeapPageTable::set_range(void *start, size_t size, alaska::HeapPage *hp) {
+    for (size_t off = 0; off < size; off += alaska::span_size)
+      set((void *)((uintptr_t)start + off), hp);
+  }
 
-  alaska::HeapPage **HeapPageTable::walk(void *vpage) {
-    // `page` here means the offset from the start of the heap.
-    uintptr_t page_off = (uintptr_t)vpage - (uintptr_t)heap_start;
-    // Extrac the page number (just an index into the page table structure)
-    off_t page_number = page_off >> alaska::page_shift_factor;
 
-    if (unlikely((uint64_t)page_number > (uint64_t)(1LU << (bits_per_pt_level * 2)))) {
-      return NULL;
-    }
+  alaska::HeapPage **HeapPageTable::walk_alloc(void *vpage) {
+    // Extract the span number (just an index into the page table structure)
+    uint64_t span_number = (uintptr_t)vpage >> alaska::span_shift_factor;
+    ALASKA_ASSERT(span_number >> pt_bits == 0, "HeapPageTable: address out of range");
 
     // Gross math here. Can't avoid it.
-    // Effectively, we are using the bits in the page number to index into two-level page table
+    // Effectively, we are using the bits in the span number to index into two-level page table
     // structure in the exact same way that we would on a real x86_64 system's page table.
-    off_t ind1 = page_number & pt_level_mask;
-    off_t ind2 = (page_number >> bits_per_pt_level) & pt_level_mask;
+    off_t ind1 = span_number >> pt_leaf_bits;
+    off_t ind2 = span_number & pt_leaf_mask;
 
     log_debug(
-        "HeapPageTable: walk(%p) -> pn: %lu, inds: (%zu, %zu)", vpage, page_number, ind1, ind2);
+        "HeapPageTable: walk(%p) -> sn: %lu, inds: (%zu, %zu)", vpage, span_number, ind1, ind2);
 
     // Grab the entry from the root page table.
-    HeapPage **pt1 = root[ind1];
+    HeapPage **pt1 = __atomic_load_n(&root[ind1], __ATOMIC_ACQUIRE);
     // It is null, allocate a new entry and set it.
     if (unlikely(pt1 == nullptr)) {
-      // If the first level page table entry is null, we need to allocate a new page table.
-      pt1 = (HeapPage **)allocate_page_table();
-      root[ind1] = pt1;
+      // If the first level page table entry is null, we need to allocate a new page table. If
+      // another thread beat us to it, use theirs.
+      auto *fresh = (HeapPage **)allocate_page_table(pt_leaf_bits);
+      if (__atomic_compare_exchange_n(
+              &root[ind1], &pt1, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        pt1 = fresh;
+      } else {
+        mmap_free(fresh, (1LU << pt_leaf_bits) * sizeof(void *));
+      }
     }
 
     return &pt1[ind2];
@@ -163,21 +199,22 @@ namespace alaska {
   ////////////////////////////////////
   Heap::Heap(alaska::Configuration &config)
       : pm()
-      , pt(pm.get_start())
+      , pt()
       , huge_allocator(config.huge_strategy) {
     log_debug("Heap: Initialized heap");
   }
 
   Heap::~Heap(void) {}
 
-  SizedPage *Heap::get_sizedpage(size_t size, ThreadCache *owner) {
+  SizedPage *Heap::get_sizedpage(size_t size, ThreadCache *owner, int refills) {
     ck::scoped_lock lk(this->lock);  // TODO: don't lock.
     int cls = alaska::size_to_class(size);
     auto &mag = this->size_classes[cls];
     // Look for a sized page in the magazine with at least one allocation space available.
     // TODO: it would be smart to adjust this requirement dynamically based on the allocation
     // request.
-    auto *p = this->find_or_alloc_page<SizedPage>(mag, owner, 1, [&](auto p) {
+    long spans = SizedPage::span_count(cls, refills);
+    auto *p = this->find_or_alloc_page<SizedPage>(mag, owner, 1, spans, [&](auto p) {
       p->set_size_class(cls);
     });
     return p;
@@ -187,7 +224,7 @@ namespace alaska {
   LocalityPage *Heap::get_localitypage(size_t size_requirement, ThreadCache *owner) {
     ck::scoped_lock lk(this->lock);  // TODO: don't lock.
     auto *p = this->find_or_alloc_page<LocalityPage>(
-        locality_pages, owner, size_requirement, [](auto *p) {
+        locality_pages, owner, size_requirement, alaska::spans_per_page, [](auto *p) {
         });
     return p;
   }
@@ -258,12 +295,15 @@ namespace alaska {
 
   void Heap::dump_json(FILE *stream) {
     fprintf(stream, "{\"pages\": [");
-    for (off_t i = 0; true; i++) {
-      auto page = pt.get(pm.get_page(i));
-      if (page == NULL) break;
-      if (i != 0) fprintf(stream, ",");
+    bool first = true;
+    pm.for_each_span([&](void *span) {
+      auto page = pt.get(span);
+      // Each page is dumped once, from its first span
+      if (page == NULL or page->start() != span) return;
+      if (not first) fprintf(stream, ",");
+      first = false;
       page->dump_json(stream);
-    }
+    });
     fprintf(stream, "]}");
   }
 
@@ -341,6 +381,27 @@ namespace alaska {
     return ptr;
   }
 
+  void *mmap_heap_region(void *hint) {
+    auto prot = PROT_READ | PROT_WRITE;
+    auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    // mmap only promises 4k alignment, but the page table (and every HeapPage) assumes pages
+    // start on a page_size boundary. Reserve a page extra and trim off the slop on either side.
+    size_t reservation = alaska::heap_size + alaska::page_size;
+    void *mapping = mmap(hint, reservation, prot, flags, -1, 0);
+    ALASKA_ASSERT(mapping != MAP_FAILED, "Failed to allocate the heap's backing memory. Aborting.");
+
+    uintptr_t start = (uintptr_t)mapping;
+    uintptr_t region = (start + alaska::page_size - 1) & ~(alaska::page_size - 1);
+    uintptr_t end = start + reservation;
+    if (region != start) munmap(mapping, region - start);
+    if (region + alaska::heap_size != end) {
+      munmap((void *)(region + alaska::heap_size), end - (region + alaska::heap_size));
+    }
+
+    ALASKA_ASSERT((region & (alaska::page_size - 1)) == 0, "The heap region is not page aligned.");
+    return (void *)region;
+  }
+
   void mmap_free(void *ptr, size_t bytes) {
     // round bytes up to 4096
     bytes = (bytes + 4095) & ~4095;
@@ -16,8 +16,9 @@ namespace alaska {
 
   HeapPage::~HeapPage() {}
 
-  HeapPage::HeapPage(void *backing_memory)
-      : memory(backing_memory) {
+  HeapPage::HeapPage(void *backing_memory, size_t size)
+      : memory(backing_memory)
+      , memory_size(size) {
     mag_list = LIST_HEAD_INIT(mag_list);
   }
 
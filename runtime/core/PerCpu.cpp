@@ -0,0 +1,226 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+#include <alaska/PerCpu.hpp>
+#include <sched.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <alaska/Logger.hpp>
+
+// glibc (2.35 and later) registers an rseq area for every thread, and says
+// where it is with these. musl doesn't, so the runtime registers its own.
+extern "C" ptrdiff_t __rseq_offset __attribute__((weak));
+extern "C" unsigned int __rseq_size __attribute__((weak));
+
+#define RSEQ_SIG 0x53053053
+#define RSEQ_CPU_ID_UNINITIALIZED ((uint32_t)-1)
+
+namespace alaska {
+
+  // struct rseq from linux/rseq.h, which not every libc has headers for
+  struct alignas(32) RseqArea {
+    uint32_t cpu_id_start;
+    uint32_t cpu_id;
+    uint64_t rseq_cs;
+    uint32_t flags;
+  };
+
+  __thread volatile uint32_t *cpu_id_slot = nullptr;
+  static __thread RseqArea rseq_area = {0, RSEQ_CPU_ID_UNINITIALIZED, 0, 0};
+  // Set once rseq has failed on this thread, so we don't keep trying
+  static __thread bool rseq_failed = false;
+
+
+  static volatile uint32_t *find_cpu_id_slot(void) {
+    if (&__rseq_size != nullptr && __rseq_size != 0) {
+      auto *area = (RseqArea *)((char *)__builtin_thread_pointer() + __rseq_offset);
+      return &area->cpu_id;
+    }
+
+#ifdef SYS_rseq
+    if (syscall(SYS_rseq, &rseq_area, sizeof(rseq_area), 0, RSEQ_SIG) == 0) {
+      return &rseq_area.cpu_id;
+    }
+#endif
+    return nullptr;
+  }
+
+
+  int current_cpu_slow(void) {
+    if (cpu_id_slot == nullptr && not rseq_failed) {
+      cpu_id_slot = find_cpu_id_slot();
+      rseq_failed = cpu_id_slot == nullptr;
+      if (cpu_id_slot != nullptr && (int)*cpu_id_slot >= 0) return *cpu_id_slot;
+    }
+
+    // No rseq (an old kernel, or a seccomp policy that blocks it)
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu;
+  }
+
+
+  int num_cpus(void) {
+    static int count = 0;
+    if (count == 0) {
+      long n = sysconf(_SC_NPROCESSORS_CONF);
+      count = n > 0 ? n : 1;
+    }
+    return count;
+  }
+
+
+  // The rseq area the kernel keeps up to date for this thread, or null if rseq is unavailable.
+  static inline RseqArea *current_rseq_area(void) {
+    if (unlikely(cpu_id_slot == nullptr)) {
+      current_cpu_slow();
+      if (cpu_id_slot == nullptr) return nullptr;
+    }
+    return (RseqArea *)((char *)cpu_id_slot - offsetof(RseqArea, cpu_id));
+  }
+
+  bool rseq_available(void) {
+#ifdef __x86_64__
+    return current_rseq_area() != nullptr;
+#else
+    return false;
+#endif
+  }
+
+
+  PerCpuStacks::PerCpuStacks(int lists)
+      : lists(lists) {
+    size_t bytes = sizeof(Stack) * lists * alaska::num_cpus();
+    // Most CPUs never touch most of their stacks, so don't commit them up front.
+    stacks = (Stack *)mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ALASKA_ASSERT(stacks != MAP_FAILED, "failed to allocate per-CPU stacks");
+  }
+
+  PerCpuStacks::~PerCpuStacks(void) {
+    munmap(stacks, sizeof(Stack) * lists * alaska::num_cpus());
+  }
+
+  long PerCpuStacks::size(void) const {
+    long n = 0;
+    for (long i = 0; i < (long)alaska::num_cpus() * lists; i++)
+      n += __atomic_load_n(&stacks[i].count, __ATOMIC_RELAXED);
+    return n;
+  }
+
+
+  // Both critical sections follow the layout rseq(2) asks for (and librseq uses): a struct
+  // rseq_cs describing the section goes in __rseq_cs, and the abort handler, which is preceded by
+  // the signature the thread registered with, goes in __rseq_failure. The section runs from 1 to
+  // 2, and commits with its last instruction (the store of the new count). On abort, the kernel
+  // has already cleared rseq_cs, so the handler starts over from the top, which sets it again.
+  // The CPU id is read inside the section, so the stack it picks can't change under it.
+
+  void *PerCpuStacks::pop(int list) {
+#ifdef __x86_64__
+    auto *area = current_rseq_area();
+    if (unlikely(area == nullptr)) return nullptr;
+
+    void *value;
+    __asm__ __volatile__(
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0, 0\n\t"                 // version, flags
+        ".quad 1f, 2f - 1f, 4f\n\t"      // start_ip, post_commit_offset, abort_ip
+        ".popsection\n\t"
+        ".pushsection __rseq_failure, \"ax\"\n\t"
+        ".byte 0x0f, 0xb9, 0x3d\n\t"     // ud1, so the signature disassembles as its operand
+        ".long %c[sig]\n\t"
+        "4:\n\t"
+        "jmp 5f\n\t"
+        ".popsection\n\t"
+        "5:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %c[rseq_cs](%[area])\n\t"
+        "1:\n\t"
+        "xorl %k[value], %k[value]\n\t"
+        "movl %c[cpu_id](%[area]), %%eax\n\t"
+        "cmpl %k[ncpus], %%eax\n\t"
+        "jae 2f\n\t"
+        "imulq %[stride], %%rax\n\t"
+        "addq %[first], %%rax\n\t"
+        "movq (%%rax), %%rcx\n\t"       // count
+        "testq %%rcx, %%rcx\n\t"
+        "jz 2f\n\t"
+        "movq (%%rax, %%rcx, 8), %[value]\n\t"  // values[count - 1]
+        "decq %%rcx\n\t"
+        "movq %%rcx, (%%rax)\n\t"       // commit
+        "2:\n\t"
+        : [value] "=&r"(value)
+        : [area] "r"(area), [ncpus] "r"(alaska::num_cpus()), [stride] "r"(sizeof(Stack) * lists),
+        [first] "r"(&stacks[list]), [sig] "i"(RSEQ_SIG), [rseq_cs] "i"(offsetof(RseqArea, rseq_cs)),
+        [cpu_id] "i"(offsetof(RseqArea, cpu_id))
+        : "rax", "rcx", "memory", "cc");
+    return value;
+#else
+    return nullptr;
+#endif
+  }
+
+
+  bool PerCpuStacks::push(int list, void *value, const uint64_t *guard, uint64_t expect) {
+#ifdef __x86_64__
+    auto *area = current_rseq_area();
+    if (unlikely(area == nullptr)) return false;
+
+    int pushed;
+    __asm__ __volatile__(
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0, 0\n\t"
+        ".quad 1f, 2f - 1f, 4f\n\t"
+        ".popsection\n\t"
+        ".pushsection __rseq_failure, \"ax\"\n\t"
+        ".byte 0x0f, 0xb9, 0x3d\n\t"
+        ".long %c[sig]\n\t"
+        "4:\n\t"
+        "jmp 5f\n\t"
+        ".popsection\n\t"
+        "5:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %c[rseq_cs](%[area])\n\t"
+        "1:\n\t"
+        "xorl %k[pushed], %k[pushed]\n\t"
+        "cmpq %[expect], (%[guard])\n\t"
+        "jne 2f\n\t"
+        "movl %c[cpu_id](%[area]), %%eax\n\t"
+        "cmpl %k[ncpus], %%eax\n\t"
+        "jae 2f\n\t"
+        "imulq %[stride], %%rax\n\t"
+        "addq %[first], %%rax\n\t"
+        "movq (%%rax), %%rcx\n\t"       // count
+        "cmpq %[capacity], %%rcx\n\t"
+        "jae 2f\n\t"
+        "movq %[value], 8(%%rax, %%rcx, 8)\n\t"  // values[count]
+        "incq %%rcx\n\t"
+        "movl $1, %k[pushed]\n\t"
+        "movq %%rcx, (%%rax)\n\t"       // commit
+        "2:\n\t"
+        : [pushed] "=&r"(pushed)
+        : [area] "r"(area), [ncpus] "r"(alaska::num_cpus()), [stride] "r"(sizeof(Stack) * lists),
+        [first] "r"(&stacks[list]), [value] "r"(value), [guard] "r"(guard), [expect] "r"(expect),
+        [capacity] "i"(capacity), [sig] "i"(RSEQ_SIG),
+        [rseq_cs] "i"(offsetof(RseqArea, rseq_cs)), [cpu_id] "i"(offsetof(RseqArea, cpu_id))
+        : "rax", "rcx", "memory", "cc");
+    return pushed;
+#else
+    return false;
+#endif
+  }
+}  // namespace alaska
@@ -15,6 +15,7 @@
 #include <alaska/SizeClass.hpp>
 #include <alaska/BarrierManager.hpp>
 #include <alaska/Localizer.hpp>
+#include <alaska/PerCpu.hpp>
 #include "alaska/alaska.hpp"
 #include "alaska/utils.h"
 #include <stdlib.h>
@@ -31,7 +32,8 @@ namespace alaska {
   Runtime::Runtime(alaska::Configuration config)
       : config(config)
       , handle_table(config)
-      , heap(config) {
+      , heap(config)
+      , cpu_objects(alaska::size_to_class(cpu_cached_size) + 1) {
     // Validate that there is not already a runtime (TODO: atomics?)
     ALASKA_ASSERT(g_runtime == nullptr, "Cannot create more than one runtime");
 
@@ -46,6 +48,12 @@ namespace alaska {
 
   Runtime::~Runtime() {
     log_debug("Destroying Alaska Runtime");
+    if (cpu_tcs != nullptr) {
+      for (int cpu = 0; cpu < alaska::num_cpus(); cpu++) {
+        if (cpu_tcs[cpu] != nullptr) del_threadcache(cpu_tcs[cpu]);
+      }
+      alaska_internal_free(cpu_tcs);
+    }
     // Unset the global instance so another runtime can be allocated
     atomic_set(g_runtime, nullptr);
   }
@@ -106,6 +114,15 @@ namespace alaska {
 
 
   ThreadCache *Runtime::new_threadcache(void) {
+    tcs_lock.lock();
+    if (not retired_tcs.is_empty()) {
+      // Adopt one, slab and all
+      auto *tc = retired_tcs.take_last();
+      tcs_lock.unlock();
+      return tc;
+    }
+    tcs_lock.unlock();
+
     auto tc = new ThreadCache(next_thread_cache_id++, *this);
     tcs_lock.lock();
     tcs.add(tc);
@@ -114,12 +131,96 @@ namespace alaska {
   }
 
   void Runtime::del_threadcache(ThreadCache *tc) {
+    // Nobody else owns its pages, so nobody else would ever use them.
+    tc->release_pages(true);
     tcs_lock.lock();
     tcs.remove(tc);
     delete tc;
     tcs_lock.unlock();
   }
 
+  void Runtime::retire_threadcache(ThreadCache *tc) {
+    tc->release_pages(false);
+    tcs_lock.lock();
+    if (retired_tcs.size() < config.thread_cache_pool_size) {
+      retired_tcs.push(tc);
+      tcs_lock.unlock();
+      return;
+    }
+    tcs_lock.unlock();
+    del_threadcache(tc);
+  }
+
+
+  ThreadCache *Runtime::cpu_threadcache(int cpu) {
+    auto **caches = __atomic_load_n(&cpu_tcs, __ATOMIC_ACQUIRE);
+    if (unlikely(caches == nullptr)) {
+      size_t size = sizeof(ThreadCache *) * alaska::num_cpus();
+      auto **fresh = (ThreadCache **)alaska_internal_calloc(1, size);
+      if (__atomic_compare_exchange_n(
+              &cpu_tcs, &caches, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        caches = fresh;
+      } else {
+        alaska_internal_free(fresh);
+      }
+    }
+
+    // A CPU that came online after num_cpus was counted shares a cache
+    auto *&slot = caches[cpu % alaska::num_cpus()];
+    auto *tc = __atomic_load_n(&slot, __ATOMIC_ACQUIRE);
+    if (likely(tc != nullptr)) return tc;
+
+    auto *fresh = new_threadcache();
+    if (__atomic_compare_exchange_n(&slot, &tc, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return fresh;
+    }
+    // Someone else on this CPU won the race
+    del_threadcache(fresh);
+    return tc;
+  }
+
+
+  void *Runtime::cpu_halloc(size_t size, bool zero) {
+    if (likely(size - 1 < cpu_cached_size)) {
+      // Round small objects up to their class, so they can be cached when they are freed (the
+      // cached objects are handed back out untouched, so they must all be the same size).
+      int cls = alaska::size_to_class(size);
+      size = alaska::class_to_size(cls);
+      // Zeroing means writing through the object's address, which a barrier could move out from
+      // under us once we have it. The thread cache's lock holds barriers off, so go through it.
+      if (likely(not zero)) {
+        void *handle = cpu_objects.pop(cls);
+        if (likely(handle != nullptr)) return handle;
+      }
+    }
+    return LockedThreadCache(*cpu_threadcache(alaska::current_cpu()))->halloc(size, zero);
+  }
+
+
+  void Runtime::cpu_hfree(void *handle) {
+    auto *m = alaska::Mapping::from_handle_safe(handle);
+    if (likely(m != nullptr)) {
+      // Objects only move in barriers, which bump the epoch before they move anything. If one
+      // starts while we look at the object, the push sees the new epoch and gives up (a barrier
+      // stops this thread with a signal, which also restarts a push it interrupts).
+      uint64_t epoch = __atomic_load_n(&alaska_barrier_epoch, __ATOMIC_ACQUIRE);
+      void *ptr = m->get_pointer();
+      auto *page = heap.pt.get_unaligned(ptr);
+      if (likely(page != nullptr)) {
+        size_t size = page->size_of(ptr);
+        // Only objects which are exactly their class's size (see cpu_halloc) can be cached.
+        if (size - 1 < cpu_cached_size) {
+          int cls = alaska::size_to_class(size);
+          if (alaska::class_to_size(cls) == size &&
+              cpu_objects.push(cls, handle, &alaska_barrier_epoch, epoch)) {
+            return;
+          }
+        }
+      }
+    }
+    LockedThreadCache(*cpu_threadcache(alaska::current_cpu()))->hfree(handle);
+  }
+
 
   void Runtime::lock_all_thread_caches(void) {
     tcs_lock.lock();
@@ -160,6 +261,21 @@ namespace alaska {
 }  // namespace alaska
 
 
+// Bumped every time the world is stopped (see Runtime::with_barrier). Compiled
+// code which keeps translations around without pinning them (batched
+// translation buffers) re-translates when this changes.
+extern "C" {
+uint64_t alaska_barrier_epoch = 0;
+}
+
+#ifdef ALASKA_COUNT_TRANSLATIONS
+// Bumped by every alaska_translate (see core/translate.cpp), and reported at exit by rt/init.cpp.
+extern "C" {
+uint64_t alaska_translation_count = 0;
+}
+#endif
+
+
 // Simply use clock_gettime, which is fast enough on most systems
 extern "C" uint64_t alaska_timestamp() {
   struct timespec spec;
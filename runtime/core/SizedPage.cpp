@@ -59,34 +59,48 @@ namespace alaska {
   void SizedPage::set_size_class(int cls) {
     size_class = cls;
 
-    size_t object_size = alaska::class_to_size(cls);
+    auto &info = alaska::size_class_info(cls);
+    size_t object_size = info.size;
     this->object_size = object_size;
+    this->recip = info.recip;
 
-    capacity = (double)alaska::page_size /
-               (double)(round_up(object_size, alaska::alignment) + sizeof(SizedPage::Header));
+    long spans = this->size() / alaska::span_size;
+    ALASKA_SANITY((spans & (spans - 1)) == 0, "SizedPages must be a power of two spans");
+    auto &layout = info.layouts[__builtin_ctzl(spans)];
+    capacity = layout.capacity;
     live_objects = 0;
 
     if (capacity == 0) {
       log_warn(
           "SizedPage allocated with an object which was too large (%zu bytes in a %zu byte page. "
           "max object = %zu). No capacity!",
-          object_size, alaska::page_size, alaska::max_object_size);
+          object_size, this->size(), alaska::max_object_size);
     } else {
       log_trace("set_size_class(%d). os=%zu, cap=%zu", cls, object_size, capacity);
     }
 
 
-    // Headers live first
+    // Headers live first. The allocator formats them as it extends into the page.
     headers = (SizedPage::Header *)memory;
-    memset(headers, 0, sizeof(SizedPage::Header) * capacity);
     // Then, objects are placed later.
-    objects = (Block *)round_up((uintptr_t)(headers + capacity), alaska::alignment);
+    objects = (Block *)((uintptr_t)memory + layout.objects_offset);
 
 
     log_info("cls = %-2d, memory = %p, headers = %p, objects = %p", cls, memory, headers, objects);
 
     // initialize
-    allocator.configure(objects, object_size, capacity);
+    allocator.configure(objects, object_size, capacity, headers, sizeof(SizedPage::Header));
+  }
+
+
+  long SizedPage::span_count(int cls, int refills) {
+    auto &info = alaska::size_class_info(cls);
+    int order = 0;
+    while (order + 1 < alaska::num_span_orders && info.layouts[order].capacity < min_objects)
+      order++;
+    order += refills;
+    if (order >= alaska::num_span_orders) order = alaska::num_span_orders - 1;
+    return 1L << order;
   }
 
 
@@ -137,7 +151,8 @@ namespace alaska {
     Header *last_object = nullptr;
 
     Header *left = headers;  // the first object
-    Header *right = headers + capacity - 1;
+    // Nothing past the frontier was ever allocated
+    Header *right = headers + formatted() - 1;
 
 
 
@@ -226,7 +241,7 @@ namespace alaska {
 
     // Simple two finger walk to swap every allocation
     long left = 0;
-    long right = capacity - 1;
+    long right = formatted() - 1;
     long swapped = 0;
 
     while (right > left) {
@@ -293,9 +308,9 @@ namespace alaska {
     };
     state last_state = unknown;
     size_t objects = 0;
+    long frontier = formatted();
     for (long i = 0; true; i++) {
-      auto *h = ind_to_header(i);
-      state curstate = h->is_free() ? freed : allocated;
+      state curstate = (i >= frontier or ind_to_header(i)->is_free()) ? freed : allocated;
       bool print = false;
 
       if (last_state != unknown and curstate != last_state) print = true;
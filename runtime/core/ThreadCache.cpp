@@ -73,7 +73,8 @@ namespace alaska {
 
   SizedPage *ThreadCache::new_sized_page(int cls) {
     // Get a new heap
-    auto *heap = runtime.heap.get_sizedpage(alaska::class_to_size(cls), this);
+    auto *heap = runtime.heap.get_sizedpage(alaska::class_to_size(cls), this, refills[cls]);
+    if (refills[cls] < alaska::page_shift_factor - alaska::span_shift_factor) refills[cls]++;
 
     // And set the owner
     heap->set_owner(this);
@@ -87,6 +88,26 @@ namespace alaska {
   }
 
 
+  void ThreadCache::release_pages(bool slab) {
+    for (int cls = 0; cls < alaska::num_size_classes; cls++) {
+      if (size_classes[cls] == nullptr) continue;
+      runtime.heap.put_page(size_classes[cls]);
+      size_classes[cls] = nullptr;
+      refills[cls] = 0;
+    }
+
+    if (locality_page != nullptr) {
+      runtime.heap.put_page(locality_page);
+      locality_page = nullptr;
+    }
+
+    if (slab && handle_slab != nullptr) {
+      handle_slab->set_owner(nullptr);
+      handle_slab = nullptr;
+    }
+  }
+
+
   LocalityPage *ThreadCache::new_locality_page(size_t required_size) {
     // Get a new heap
     auto *lp = runtime.heap.get_localitypage(required_size, this);
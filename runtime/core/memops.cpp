@@ -0,0 +1,316 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// Memory routines for the stubs in stub/memcpy.c. Those are compiled through
+// alaska, so they can be handed handles. They call these (which are not), so
+// the compiler translates each argument once and keeps it pinned for the call.
+//
+// They are written here, instead of calling libc, as the libc alaska programs
+// are linked against (musl, see ld.alaska-clang) has simple scalar versions.
+// On x86-64, the widest of SSE2, AVX2 and AVX-512 is picked at runtime. Large
+// copies and sets use non-temporal stores, so they do not flush the cache.
+
+#include <alaska.h>
+#include <alaska/utils.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __x86_64__
+#include <cpuid.h>
+#include <immintrin.h>
+
+
+// Copies and sets at least this big bypass the cache. Like glibc, it is most
+// of each core's share of the last level cache (but at least 1MiB), or 4MiB if
+// we can't find out how big that is.
+static size_t nt_threshold = 0;
+
+// Out of line, so the copies do not have to save registers for sysconf.
+__attribute__((noinline, cold)) static size_t compute_nt_threshold(void) {
+  long llc = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t t = 4 * 1024 * 1024;
+  if (llc > 0 && cpus > 0) t = (size_t)llc / cpus * 3 / 4;
+  nt_threshold = t < 1024 * 1024 ? 1024 * 1024 : t;
+  return nt_threshold;
+}
+
+static ALASKA_INLINE size_t get_nt_threshold(void) {
+  if (unlikely(nt_threshold == 0)) return compute_nt_threshold();
+  return nt_threshold;
+}
+
+
+// Whether `rep movsb` is fast (ERMS). Between REP_MOVSB_MIN and the
+// non-temporal threshold, it copies faster than the vector loops below, as
+// the cpu moves whole lines without the loads and stores going through the
+// store buffer.
+#define REP_MOVSB_MIN (16 * 1024)
+static int erms = -1;
+
+__attribute__((noinline, cold)) static bool compute_erms(void) {
+  unsigned a, b, c, d;
+  erms = __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1 << 9));
+  return erms;
+}
+
+static ALASKA_INLINE bool has_erms(void) {
+  if (unlikely(erms < 0)) return compute_erms();
+  return erms;
+}
+
+static ALASKA_INLINE void rep_movsb(uint8_t *d, const uint8_t *s, size_t n) {
+  asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+}
+
+
+// Everything under 16 bytes. The loads all happen before the stores, so this
+// is also correct for overlapping buffers.
+static ALASKA_INLINE void copy_small(uint8_t *d, const uint8_t *s, size_t n) {
+  if (n >= 8) {
+    uint64_t a, b;
+    memcpy(&a, s, 8);
+    memcpy(&b, s + n - 8, 8);
+    memcpy(d, &a, 8);
+    memcpy(d + n - 8, &b, 8);
+  } else if (n >= 4) {
+    uint32_t a, b;
+    memcpy(&a, s, 4);
+    memcpy(&b, s + n - 4, 4);
+    memcpy(d, &a, 4);
+    memcpy(d + n - 4, &b, 4);
+  } else if (n >= 2) {
+    uint16_t a, b;
+    memcpy(&a, s, 2);
+    memcpy(&b, s + n - 2, 2);
+    memcpy(d, &a, 2);
+    memcpy(d + n - 2, &b, 2);
+  } else if (n == 1) {
+    *d = *s;
+  }
+}
+
+static ALASKA_INLINE void set_small(uint8_t *d, uint8_t c, size_t n) {
+  uint64_t v = 0x0101010101010101ULL * c;
+  if (n >= 8) {
+    memcpy(d, &v, 8);
+    memcpy(d + n - 8, &v, 8);
+  } else if (n >= 4) {
+    memcpy(d, &v, 4);
+    memcpy(d + n - 4, &v, 4);
+  } else if (n >= 2) {
+    memcpy(d, &v, 2);
+    memcpy(d + n - 2, &v, 2);
+  } else if (n == 1) {
+    *d = c;
+  }
+}
+
+
+// Copy n >= W bytes with W byte vectors. The first and last vector are loaded
+// up front and stored last, and the loop in between stores to aligned
+// addresses. Going backward (for memmove with d > s) or forward otherwise,
+// every load in the loop happens before any store that could overlap it. The
+// forward loop loads four vectors before storing any of them, so a store does
+// not stall the next load when d and s are a multiple of 4KiB apart.
+#define DEFINE_COPY(isa, target_isa, W, vec, loadu, store, storeu, stream)                   \
+  __attribute__((target(target_isa))) static void copy_##isa(                                 \
+      uint8_t *d, const uint8_t *s, size_t n, bool backward) {                                \
+    size_t nt = get_nt_threshold();                                                           \
+    vec head = loadu((const vec *)s);                                                         \
+    vec tail = loadu((const vec *)(s + n - W));                                               \
+    if (n > 2 * W) {                                                                          \
+      size_t first = W - ((uintptr_t)d & (W - 1));                                            \
+      size_t last = n - ((uintptr_t)(d + n) & (W - 1));                                       \
+      if (backward) {                                                                         \
+        for (size_t i = last; i > first;) {                                                   \
+          i -= W;                                                                             \
+          store((vec *)(d + i), loadu((const vec *)(s + i)));                                 \
+        }                                                                                     \
+      } else {                                                                                \
+        size_t i = first;                                                                     \
+        if (n >= nt) {                                                                        \
+          for (; i < last; i += W)                                                            \
+            stream((vec *)(d + i), loadu((const vec *)(s + i)));                              \
+          _mm_sfence();                                                                       \
+        }                                                                                     \
+        for (; i + 4 * W <= last; i += 4 * W) {                                               \
+          vec a = loadu((const vec *)(s + i));                                                \
+          vec b = loadu((const vec *)(s + i + W));                                            \
+          vec c = loadu((const vec *)(s + i + 2 * W));                                        \
+          vec e = loadu((const vec *)(s + i + 3 * W));                                        \
+          store((vec *)(d + i), a);                                                           \
+          store((vec *)(d + i + W), b);                                                       \
+          store((vec *)(d + i + 2 * W), c);                                                   \
+          store((vec *)(d + i + 3 * W), e);                                                   \
+        }                                                                                     \
+        for (; i < last; i += W)                                                              \
+          store((vec *)(d + i), loadu((const vec *)(s + i)));                                 \
+      }                                                                                       \
+    }                                                                                         \
+    storeu((vec *)(d + n - W), tail);                                                         \
+    storeu((vec *)d, head);                                                                   \
+  }
+
+// Set n >= W bytes, in the same way as the copies above.
+#define DEFINE_SET(isa, target_isa, W, vec, splat, store, storeu, stream)                     \
+  __attribute__((target(target_isa))) static void set_##isa(uint8_t *d, uint8_t c, size_t n) { \
+    size_t nt = get_nt_threshold();                                                          \
+    vec v = splat((char)c);                                                                  \
+    storeu((vec *)d, v);                                                                     \
+    storeu((vec *)(d + n - W), v);                                                           \
+    size_t first = W - ((uintptr_t)d & (W - 1));                                             \
+    size_t last = n - ((uintptr_t)(d + n) & (W - 1));                                        \
+    if (n >= nt) {                                                                           \
+      for (size_t i = first; i < last; i += W)                                               \
+        stream((vec *)(d + i), v);                                                           \
+      _mm_sfence();                                                                          \
+    } else {                                                                                 \
+      for (size_t i = first; i < last; i += W)                                               \
+        store((vec *)(d + i), v);                                                            \
+    }                                                                                        \
+  }
+
+DEFINE_COPY(sse2, "sse2", 16, __m128i, _mm_loadu_si128, _mm_store_si128, _mm_storeu_si128,
+    _mm_stream_si128)
+DEFINE_COPY(avx2, "avx2", 32, __m256i, _mm256_loadu_si256, _mm256_store_si256,
+    _mm256_storeu_si256, _mm256_stream_si256)
+DEFINE_COPY(avx512, "avx512f", 64, __m512i, _mm512_loadu_si512, _mm512_store_si512,
+    _mm512_storeu_si512, _mm512_stream_si512)
+
+DEFINE_SET(sse2, "sse2", 16, __m128i, _mm_set1_epi8, _mm_store_si128, _mm_storeu_si128,
+    _mm_stream_si128)
+DEFINE_SET(avx2, "avx2", 32, __m256i, _mm256_set1_epi8, _mm256_store_si256,
+    _mm256_storeu_si256, _mm256_stream_si256)
+DEFINE_SET(avx512, "avx512f", 64, __m512i, _mm512_set1_epi8, _mm512_store_si512,
+    _mm512_storeu_si512, _mm512_stream_si512)
+
+
+static ALASKA_INLINE int byte_diff(const uint8_t *a, const uint8_t *b, unsigned mask) {
+  unsigned i = __builtin_ctz(mask);
+  return (int)a[i] - (int)b[i];
+}
+
+// Compare n >= 16 bytes, two vectors at a time. The last vector overlaps the
+// one before it, which is fine: those bytes compared equal.
+static int cmp_sse2(const uint8_t *a, const uint8_t *b, size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m128i x0 = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(a + i + 16));
+    __m128i e0 = _mm_cmpeq_epi8(x0, _mm_loadu_si128((const __m128i *)(b + i)));
+    __m128i e1 = _mm_cmpeq_epi8(x1, _mm_loadu_si128((const __m128i *)(b + i + 16)));
+    if (_mm_movemask_epi8(_mm_and_si128(e0, e1)) != 0xFFFF) {
+      unsigned ne = ~(unsigned)_mm_movemask_epi8(e0) & 0xFFFF;
+      if (ne) return byte_diff(a + i, b + i, ne);
+      return byte_diff(a + i + 16, b + i + 16, ~(unsigned)_mm_movemask_epi8(e1) & 0xFFFF);
+    }
+  }
+  for (; i < n; i += 16) {
+    if (i + 16 > n) i = n - 16;
+    __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+    unsigned ne = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xFFFF;
+    if (ne) return byte_diff(a + i, b + i, ne);
+  }
+  return 0;
+}
+
+__attribute__((target("avx2"))) static int cmp_avx2(const uint8_t *a, const uint8_t *b, size_t n) {
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    __m256i x0 = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i x1 = _mm256_loadu_si256((const __m256i *)(a + i + 32));
+    __m256i e0 = _mm256_cmpeq_epi8(x0, _mm256_loadu_si256((const __m256i *)(b + i)));
+    __m256i e1 = _mm256_cmpeq_epi8(x1, _mm256_loadu_si256((const __m256i *)(b + i + 32)));
+    if ((unsigned)_mm256_movemask_epi8(_mm256_and_si256(e0, e1)) != 0xFFFFFFFF) {
+      unsigned ne = ~(unsigned)_mm256_movemask_epi8(e0);
+      if (ne) return byte_diff(a + i, b + i, ne);
+      return byte_diff(a + i + 32, b + i + 32, ~(unsigned)_mm256_movemask_epi8(e1));
+    }
+  }
+  for (; i < n; i += 32) {
+    if (i + 32 > n) i = n - 32;
+    __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+    unsigned ne = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+    if (ne) return byte_diff(a + i, b + i, ne);
+  }
+  return 0;
+}
+
+
+static ALASKA_INLINE void copy(uint8_t *d, const uint8_t *s, size_t n, bool backward) {
+  if (n < 16) return copy_small(d, s, n);
+  if (!backward && n >= REP_MOVSB_MIN && n < get_nt_threshold() && has_erms()) {
+    return rep_movsb(d, s, n);
+  }
+  if (n >= 64 && __builtin_cpu_supports("avx512f")) return copy_avx512(d, s, n, backward);
+  if (n >= 32 && __builtin_cpu_supports("avx2")) return copy_avx2(d, s, n, backward);
+  copy_sse2(d, s, n, backward);
+}
+
+extern "C" void *__alaska_memcpy(void *dest, const void *src, size_t n) {
+  copy((uint8_t *)dest, (const uint8_t *)src, n, false);
+  return dest;
+}
+
+extern "C" void *__alaska_memmove(void *dest, const void *src, size_t n) {
+  // Copying forward is only wrong if the source is behind the destination.
+  bool backward = (uintptr_t)dest - (uintptr_t)src < n;
+  copy((uint8_t *)dest, (const uint8_t *)src, n, backward);
+  return dest;
+}
+
+extern "C" void *__alaska_memset(void *dest, int c, size_t n) {
+  auto *d = (uint8_t *)dest;
+  if (n < 16) {
+    set_small(d, c, n);
+  } else if (n >= 64 && __builtin_cpu_supports("avx512f")) {
+    set_avx512(d, c, n);
+  } else if (n >= 32 && __builtin_cpu_supports("avx2")) {
+    set_avx2(d, c, n);
+  } else {
+    set_sse2(d, c, n);
+  }
+  return dest;
+}
+
+extern "C" int __alaska_memcmp(const void *s1, const void *s2, size_t n) {
+  auto *a = (const uint8_t *)s1;
+  auto *b = (const uint8_t *)s2;
+  if (n >= 32 && __builtin_cpu_supports("avx2")) return cmp_avx2(a, b, n);
+  if (n >= 16) return cmp_sse2(a, b, n);
+  for (size_t i = 0; i < n; i++) {
+    if (a[i] != b[i]) return (int)a[i] - (int)b[i];
+  }
+  return 0;
+}
+
+#else
+
+// Elsewhere, libc's versions are as good as anything we would write.
+extern "C" void *__alaska_memcpy(void *dest, const void *src, size_t n) {
+  return memcpy(dest, src, n);
+}
+extern "C" void *__alaska_memmove(void *dest, const void *src, size_t n) {
+  return memmove(dest, src, n);
+}
+extern "C" void *__alaska_memset(void *dest, int c, size_t n) { return memset(dest, c, n); }
+extern "C" int __alaska_memcmp(const void *s1, const void *s2, size_t n) {
+  return memcmp(s1, s2, n);
+}
+
+#endif
@@ -24,6 +24,9 @@
 #include <alaska/Logger.hpp>
 #include "alaska/Runtime.hpp"
 #include <dlfcn.h>
+#if defined(__x86_64__) && defined(ALASKA_GATHER_TRANSLATE)
+#include <immintrin.h>
+#endif
 
 /**
  * Note: This file is inlined by the compiler to make locks faster.
@@ -64,6 +67,11 @@ void *alaska_translate_escape(void *ptr) {
 extern void alaska_htlb_sim_track(uintptr_t handle);
 #endif
 
+#ifdef ALASKA_COUNT_TRANSLATIONS
+// In core/Runtime.cpp, so the copy of this file inlined into the program counts into it too
+extern "C" uint64_t alaska_translation_count;
+#endif
+
 
 
 extern "C" void do_handle_fault(void) { return; }
@@ -78,6 +86,9 @@ void *alaska_translate(void *ptr) {
 #ifdef ALASKA_HTLB_SIM
   alaska_htlb_sim_track((uintptr_t)ptr);
 #endif
+#ifdef ALASKA_COUNT_TRANSLATIONS
+  __atomic_fetch_add(&alaska_translation_count, 1, __ATOMIC_RELAXED);
+#endif
 
   int64_t bits = (int64_t)ptr;
   int64_t mapped_bits;
@@ -118,6 +129,112 @@ retry_translation:
   return result;
 }
 
+
+
+// Batched translation, for loops that walk arrays of handles. Non-handles
+// (including NULL and -1) pass through unchanged, as in alaska_translate.
+//
+// With ALASKA_GATHER_TRANSLATE, AVX2/AVX-512 versions gather the mappings of a
+// whole register of handles at once. They are picked at runtime so the bitcode
+// of this file does not depend on what the application was compiled for. They
+// are off by default, as gathers are microcoded (and slower than the scalar
+// loop) on many parts, including current AMD cores and Intel cores with the
+// gather data sampling mitigation.
+
+static ALASKA_INLINE void *translate_batch_one(void *ptr) {
+  int64_t bits = (int64_t)ptr;
+  if (unlikely(bits >= 0 || bits == -1)) return ptr;
+  void *mapped = alaska::Mapping::from_handle(ptr)->get_pointer_fast();
+  (void)*(volatile uint8_t *)mapped;
+  return APPLY_OFFSET(mapped, bits);
+}
+
+#if defined(__x86_64__) && defined(ALASKA_GATHER_TRANSLATE)
+#define MAPPING_SHIFT (ALASKA_SIZE_BITS - ALASKA_SQUEEZE_BITS)
+#define OFFSET_MASK ((1LL << ALASKA_SIZE_BITS) - 1)
+
+__attribute__((target("avx2"))) static size_t translate_batch_avx2(
+    void *const *handles, void **out, size_t count) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi64x(-1);
+  const __m256i offset_mask = _mm256_set1_epi64x(OFFSET_MASK);
+  alignas(32) uint64_t mapped[4];
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i h = _mm256_loadu_si256((const __m256i *)(handles + i));
+    // A handle has the top bit set, and is not -1.
+    __m256i is_handle =
+        _mm256_andnot_si256(_mm256_cmpeq_epi64(h, ones), _mm256_cmpgt_epi64(zero, h));
+    int lanes = _mm256_movemask_pd(_mm256_castsi256_pd(is_handle));
+    if (lanes == 0) {
+      _mm256_storeu_si256((__m256i *)(out + i), h);
+      continue;
+    }
+
+    __m256i m = _mm256_srli_epi64(h, MAPPING_SHIFT);
+    __m256i p = _mm256_mask_i64gather_epi64(h, (const long long *)0, m, is_handle, 1);
+    _mm256_store_si256((__m256i *)mapped, p);
+    __m256i r = _mm256_add_epi64(p, _mm256_and_si256(h, offset_mask));
+    _mm256_storeu_si256((__m256i *)(out + i), _mm256_blendv_epi8(h, r, is_handle));
+
+    for (int l = 0; l < 4; l++)
+      if (lanes & (1 << l)) (void)*(volatile uint8_t *)mapped[l];
+  }
+  return i;
+}
+
+__attribute__((target("avx512f"))) static size_t translate_batch_avx512(
+    void *const *handles, void **out, size_t count) {
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i ones = _mm512_set1_epi64(-1);
+  const __m512i offset_mask = _mm512_set1_epi64(OFFSET_MASK);
+  alignas(64) uint64_t mapped[8];
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m512i h = _mm512_loadu_si512((const void *)(handles + i));
+    __mmask8 is_handle = _mm512_cmplt_epi64_mask(h, zero) & _mm512_cmpneq_epi64_mask(h, ones);
+    if (is_handle == 0) {
+      _mm512_storeu_si512((void *)(out + i), h);
+      continue;
+    }
+
+    __m512i m = _mm512_maskz_srli_epi64(0xFF, h, MAPPING_SHIFT);
+    __m512i p = _mm512_mask_i64gather_epi64(h, is_handle, m, (const void *)0, 1);
+    _mm512_store_si512((void *)mapped, p);
+    __m512i r = _mm512_mask_add_epi64(h, is_handle, p, _mm512_and_si512(h, offset_mask));
+    _mm512_storeu_si512((void *)(out + i), r);
+
+    for (int l = 0; l < 8; l++)
+      if (is_handle & (1 << l)) (void)*(volatile uint8_t *)mapped[l];
+  }
+  return i;
+}
+#endif
+
+extern "C" void alaska_translate_batch(void *const *handles, void **out, size_t count) {
+#ifdef ALASKA_HTLB_SIM
+  for (size_t i = 0; i < count; i++)
+    alaska_htlb_sim_track((uintptr_t)handles[i]);
+#endif
+#ifdef ALASKA_COUNT_TRANSLATIONS
+  __atomic_fetch_add(&alaska_translation_count, count, __ATOMIC_RELAXED);
+#endif
+
+  size_t i = 0;
+#if defined(__x86_64__) && defined(ALASKA_GATHER_TRANSLATE)
+  if (__builtin_cpu_supports("avx512f")) {
+    i = translate_batch_avx512(handles, out, count);
+  } else if (__builtin_cpu_supports("avx2")) {
+    i = translate_batch_avx2(handles, out, count);
+  }
+#endif
+  for (; i < count; i++)
+    out[i] = translate_batch_one(handles[i]);
+}
+
+
 void alaska_release(void *ptr) {
   // This function is just a marker that `ptr` is now dead (no longer used)
   // and should not have any real meaning in the runtime
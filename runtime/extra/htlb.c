@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include "../include/alaska/sim/trace.h"
+
+#ifndef ALASKA_SIZE_BITS
+#define ALASKA_SIZE_BITS 24
+#endif
 
 #define TAG_BITS 1  // 6 bits
 #define WIDTH (1 << TAG_BITS)
@@ -42,10 +47,9 @@ void tlb_init(struct tlb *tlb) {
   }
 }
 
-void tlb_access(struct tlb *tlb, uint64_t handle) {
+void tlb_access(struct tlb *tlb, uint32_t handle_id) {
   struct line *line = NULL;         // The line we end up chosing
   struct line *oldest_line = NULL;  // The LRU line
-  uint32_t handle_id = (handle >> 32);
 
   // grab the set
   struct set *set = &tlb->sets[handle_id % NUM_SETS];
@@ -77,12 +81,40 @@ void tlb_access(struct tlb *tlb, uint64_t handle) {
   line->last_used = tlb->time++;
 }
 
+void tlb_invalidate(struct tlb *tlb, uint32_t handle_id) {
+  struct set *set = &tlb->sets[handle_id % NUM_SETS];
+  for (int l = 0; l < ASSOCIATIVITY; l++) {
+    struct line *cur = &set->lines[l];
+    if (cur->valid && cur->handle == handle_id) cur->valid = false;
+  }
+}
+
 void tlb_dump(struct tlb *tlb) {
   printf("Hits:   %zu\n", tlb->hits);
   printf("Misses: %zu\n", tlb->misses);
   printf("rate:   %lf%%\n", (tlb->hits / (double)(tlb->hits + tlb->misses)) * 100.0);
 }
 
+// Replay a binary trace written by the runtime's HTLB simulator (see trace.h)
+int tlb_drive_with_binary_trace(struct tlb *tlb, FILE *stream) {
+  uint64_t last = 0, addr;
+  int kind;
+
+  while (alaska_trace_decode(stream, &last, &addr, &kind)) {
+    // Only handles go through the HTLB
+    if ((int64_t)addr >= 0) continue;
+    uint32_t handle_id = (addr & ~(1LU << 63)) >> ALASKA_SIZE_BITS;
+    if (kind == ALASKA_TRACE_INVALIDATE) {
+      tlb_invalidate(tlb, handle_id);
+    } else {
+      tlb_access(tlb, handle_id);
+    }
+  }
+
+  fclose(stream);
+  return 0;
+}
+
 int tlb_drive_with_file(struct tlb *tlb, const char *path) {
   size_t len;
   ssize_t read;
@@ -94,10 +126,21 @@ int tlb_drive_with_file(struct tlb *tlb, const char *path) {
     return -ENOENT;
   }
 
+  struct alaska_trace_header hdr;
+  if (fread(&hdr, sizeof(hdr), 1, stream) == 1 && hdr.magic == ALASKA_TRACE_MAGIC) {
+    if (hdr.version != ALASKA_TRACE_VERSION) {
+      fprintf(stderr, "Unsupported trace version %u\n", hdr.version);
+      fclose(stream);
+      return -EINVAL;
+    }
+    return tlb_drive_with_binary_trace(tlb, stream);
+  }
+  rewind(stream);
+
   while ((read = getline(&line, &len, stream)) != -1) {
     uint64_t handle = 0;
     if (sscanf(line, "tr 0x%zx", &handle) == 1) {
-      tlb_access(tlb, handle);
+      tlb_access(tlb, handle >> 32);
     }
   }
 
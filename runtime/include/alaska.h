@@ -41,11 +41,23 @@ extern unsigned long alaska_timestamp(void);
 
 struct alaska_blob_config {
   uintptr_t code_start, code_end;
-  void *stackmap;
+  // The program's stackmaps: one for each object file that has one
+  void *stackmap, *stackmap_end;
+  // The table alaska-safepoints built from the stackmap, if any
+  // (see alaska/SafepointTable.h)
+  void *safepoints;
 };
 // In barrier.cpp
 void alaska_blob_init(struct alaska_blob_config *cfg);
 
+// Memory routines which take translated pointers (see core/memops.cpp). The
+// stubs of memcpy and friends call these, so the compiler translates their
+// arguments once, and keeps them pinned for the call.
+extern void *__alaska_memcpy(void *dest, const void *src, size_t n);
+extern void *__alaska_memmove(void *dest, const void *src, size_t n);
+extern void *__alaska_memset(void *dest, int c, size_t n);
+extern int __alaska_memcmp(const void *s1, const void *s2, size_t n);
+
 // Not a good function to call. This is always an external function in the compiler's eyes
 extern void *__alaska_leak(void *);
 
@@ -24,5 +24,13 @@ namespace alaska {
     virtual void end(void){};
 
     unsigned long barrier_count = 0;
+    // How long begin() took to stop the world (time-to-safepoint), in ns.
+    uint64_t tts_total_ns = 0;
+    uint64_t tts_max_ns = 0;
+
+    void record_time_to_safepoint(uint64_t ns) {
+      tts_total_ns += ns;
+      if (ns > tts_max_ns) tts_max_ns = ns;
+    }
   };
 }  // namespace alaska
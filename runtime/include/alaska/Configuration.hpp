@@ -23,5 +23,13 @@ namespace alaska {
 
     // Allocate using a custom mmap backend by default for large objects.
     HugeAllocationStrategy huge_strategy = HugeAllocationStrategy::CUSTOM_MMAP_BACKED;
+
+    // How many thread caches of exited threads to keep for new threads to
+    // adopt (see Runtime::retire_threadcache)
+    int thread_cache_pool_size = 16;
+
+    // Runtime::with_barrier skips a barrier that would start sooner than this
+    // after the last one (in ns)
+    uint64_t min_barrier_interval = 250 * 1000 * 1000;
   };
 }  // namespace alaska
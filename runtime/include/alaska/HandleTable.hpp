@@ -84,6 +84,11 @@ namespace alaska {
   // This is a class which manages the mapping from pages in the handle table to slabs. If a
   // handle table is already allocated, this class will panic when being constructed.
   // In the actual runtime implementation, there will be a global instance of this class.
+  //
+  // The table reserves all the address space a handle can encode up front (PROT_NONE), and
+  // commits it as slabs are needed, so it never moves and growing it never blocks anyone but the
+  // threads which need the new space. Slabs which become entirely free while nobody owns them
+  // give their memory back to the kernel.
   class HandleTable final {
    public:
     static constexpr size_t slab_size = alaska::page_size;
@@ -94,7 +99,7 @@ namespace alaska {
     HandleTable(const alaska::Configuration &config);
     ~HandleTable(void);
 
-    // Allocate a fresh slab, resizing the table if necessary.
+    // Allocate a fresh slab, committing more of the table if necessary.
     alaska::HandleSlab *fresh_slab(ThreadCache *new_owner);
     // Get *some* unowned slab, the amount of free entries currently doesn't really matter.
     alaska::HandleSlab *new_slab(ThreadCache *new_owner);
@@ -102,8 +107,11 @@ namespace alaska {
     // Given a mapping, return the index of the slab it belongs to.
     slabidx_t mapping_slab_idx(Mapping *m) const;
 
-    auto slab_count() const { return m_slabs.size(); }
-    auto capacity() const { return m_capacity; }
+    auto slab_count() const { return __atomic_load_n(&m_num_slabs, __ATOMIC_ACQUIRE); }
+    // How many slabs are committed
+    auto capacity() const { return __atomic_load_n(&m_capacity, __ATOMIC_ACQUIRE); }
+    // How many slabs the table could ever hold
+    auto max_capacity() const { return m_max_capacity; }
 
     void dump(FILE *stream);
 
@@ -131,13 +139,20 @@ namespace alaska {
 
 
    private:
-    void grow();
+    // Make sure slab `idx` is committed
+    void commit(slabidx_t idx);
+    // Give the memory behind `slab` back to the kernel if it is unowned and entirely free
+    void release_if_free(alaska::HandleSlab *slab);
     bool do_mlock = false;
 
-    // A lock for the handle table
+    // A lock for the handle table (handing out slabs which already exist)
     ck::mutex lock;
-    // How many slabs this table can hold (how big is the mmap region)
+    // Only taken to commit more of the table
+    ck::mutex commit_lock;
+    // How many slabs are committed (readable and writable)
     uint64_t m_capacity;
+    // How many slabs the reservation can hold
+    uint64_t m_max_capacity;
     // The actual memory for the mmap region.
     alaska::Mapping *m_table;
 
@@ -145,6 +160,9 @@ namespace alaska {
     // How much the table increases it's capacity by each time it grows.
     static constexpr int growth_factor = 2;
 
-    ck::vec<alaska::HandleSlab *> m_slabs;
+    // One entry for each slab which could exist. Slabs are published with a release store once
+    // they are constructed, so an entry below m_num_slabs might still be null for a moment.
+    alaska::HandleSlab **m_slabs;
+    slabidx_t m_num_slabs = 0;
   };
 }  // namespace alaska
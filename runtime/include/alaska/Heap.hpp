@@ -29,10 +29,9 @@ namespace alaska {
   static constexpr size_t megabyte = 1024 * kilobyte;
   static constexpr size_t gigabyte = 1024 * megabyte;
 
-  // For now, the heap is a fixed size, large contiguious
-  // block of memory managed by the PageManager. Eventually,
-  // we will split it up into different mmap regions, but that's
-  // just a problem solved by another layer of allocators.
+  // The heap is made of regions: large contiguous blocks of address space which the
+  // PageManager reserves one at a time, as the previous one fills up. heap_size is the size of
+  // one region, and there can be up to max_heap_regions of them.
 
 
 #ifndef HEAP_SIZE_SHIFT_FACTOR
@@ -45,13 +44,16 @@ namespace alaska {
 #endif
 
   static constexpr size_t heap_size = 1LU << heap_size_shift_factor;
+  static constexpr long max_heap_regions = 512;
 
 
 
   // The PageManager is responsible for managing the memory backing the heap, and subdividing it
-  // into pages which are handed to HeapPage instances. The main interface here is to allocate a
-  // page of size alaska::page_size, and allow it to be freed again. Fundamentally, the PageManager
-  // is a trivial bump allocator that uses a free-list to manage reuse.
+  // into spans which are handed to HeapPage instances. The main interface here is to allocate a
+  // power of two run of spans (up to alaska::page_size bytes), and allow it to be freed again.
+  // Fundamentally, the PageManager is a trivial bump allocator of full pages, with a free-list for
+  // each run length to manage reuse. A run which is not on its free list is split from a longer
+  // one, like a buddy allocator that never merges the buddies back together.
   //
   // The methods behind this structure are currently behind a lock.
   class PageManager final {
@@ -59,76 +61,111 @@ namespace alaska {
     PageManager();
     ~PageManager();
 
+    // Allocate or free `count` contiguous spans. `count` must be a power of two, and at most
+    // alaska::spans_per_page.
+    void *alloc_spans(long count);
+    void free_spans(void *spans, long count);
 
-    void *alloc_page(void);
-    void free_page(void *page);
-    void *get_start(void) const { return heap; }
+    void *alloc_page(void) { return alloc_spans(alaska::spans_per_page); }
+    void free_page(void *page) { free_spans(page, alaska::spans_per_page); }
 
+    // Is `ptr` in one of the heap's regions?
+    bool contains(void *ptr) const;
+    inline long get_region_count(void) const {
+      return __atomic_load_n(&num_regions, __ATOMIC_ACQUIRE);
+    }
 
     double get_usage_frac(void) const {
-      return 100.0 * (alloc_count / (double)(heap_size / page_size));
+      return 100.0 * (alloc_count / (double)(get_region_count() * (heap_size / span_size)));
     }
 
-    inline void *get_page(off_t i) {
-      return(void*)((off_t)heap + (i * page_size));
-    }
+    // Call f on every span which has ever been bumped, in address order within each region.
+    template <typename Fn>
+    void for_each_span(Fn f);
 
 
-    inline uint64_t get_allocated_page_count(void) const { return alloc_count; }
+    inline uint64_t get_allocated_span_count(void) const { return alloc_count; }
+    inline uint64_t get_allocated_page_count(void) const { return alloc_count / spans_per_page; }
 
    private:
     struct FreePage {
       FreePage *next;
     };
 
-    // This is the memory backing the heap. It is `alaska::heap_size` bytes long.
-    void *heap;
-    void *end;   // the end of the heap. If bump == end, we are OOM. make heap_size bigger!
-    void *bump;  // the current bump pointer
-    uint64_t alloc_count = 0;  // How many pages are currently in use
+    // Pop a run of 2^order spans, splitting longer ones or bumping as needed.
+    void *take_spans(int order);
+    // Reserve another region, and start bumping in it.
+    void add_region(void);
+
+    // The regions backing the heap. Each is `alaska::heap_size` bytes long. They are only ever
+    // added, so they can be read without the lock up to num_regions.
+    void *regions[max_heap_regions];
+    long num_regions = 0;
+    void *end;   // the end of the last region. If bump == end, we need a new region.
+    void *bump;  // the current bump pointer, in the last region
+    uint64_t alloc_count = 0;  // How many spans are currently in use
     ck::mutex lock;            // Just a lock.
 
-    alaska::PageManager::FreePage *free_list;
+    // free_lists[o] holds free runs of 2^o spans
+    alaska::PageManager::FreePage *free_lists[num_span_orders];
   };
 
 
 
   // allocate pages to fit `bytes` bytes from the kernel.
   void *mmap_alloc(size_t bytes);
+  // Reserve `alaska::heap_size` bytes for a heap region, starting on a page_size boundary. `hint`
+  // is passed on to mmap, and need not be aligned.
+  void *mmap_heap_region(void *hint = NULL);
   // free pages allocated by mmap_alloc
   void mmap_free(void *ptr, size_t bytes);
 
-  // how many bits are needed to manage page table lookups.
-  static constexpr long pt_bits = heap_size_shift_factor - page_shift_factor;
+  // The page table covers the whole user address space (one entry per span), so the heap's
+  // regions can be wherever mmap puts them. How many bits are needed to manage lookups:
+  static constexpr long pt_address_bits = 48;
+  static constexpr long pt_bits = pt_address_bits - span_shift_factor;
   static constexpr long pt_levels = 2;  // This is only used for math. The structure is 2 levels.
   static_assert(pt_levels == 2, "We require 2 levels of page table");
-  static constexpr long bits_per_pt_level = pt_bits / pt_levels;
-  static_assert(
-      bits_per_pt_level * pt_levels == pt_bits, "bits_per_pt_level * pt_levels != pt_bits");
-  static constexpr long pt_level_mask = (1 << bits_per_pt_level) - 1;
+  // The leaves take the low bits of the span number, the root the rest.
+  static constexpr long pt_leaf_bits = pt_bits / pt_levels;
+  static constexpr long pt_root_bits = pt_bits - pt_leaf_bits;
+  static constexpr long pt_leaf_mask = (1 << pt_leaf_bits) - 1;
 
-  // The HeapPageTable maps the virtual addresses of pages allocated by the PageManager to their
+  // The HeapPageTable maps the virtual addresses of spans allocated by the PageManager to their
   // managing HeapPage instances. Internally, it operates very similar to a virtual memory page
-  // table (a radix tree).
-  //
-  // TODO: THREAD SAFETY! THREAD SAFETY! THREAD SAFETY!
+  // table (a radix tree). Lookups take no lock and never allocate: an address whose leaf doesn't
+  // exist just isn't in the heap. Only set() allocates leaves, racing to install them with a CAS.
+  // The tables are mmapped, so only the parts that cover the heap are ever committed.
   class HeapPageTable {
    public:
-    HeapPageTable(void *heap_start);
+    HeapPageTable(void);
     ~HeapPageTable(void);
-    alaska::HeapPage *get(void *page);            // Get the HeapPage given an aligned address
-    alaska::HeapPage *get_unaligned(void *page);  // Get the HeapPage given an unaligned address
+    // Get the HeapPage given an aligned address
+    alaska::HeapPage *get(void *page) { return get_unaligned(page); }
+    // Get the HeapPage given an unaligned address
+    inline alaska::HeapPage *get_unaligned(void *page);
+    // Map the span at `page` to `heap_page`
     void set(void *page, alaska::HeapPage *heap_page);
+    // Map every span in [start, start + size) to `heap_page`
+    void set_range(void *start, size_t size, alaska::HeapPage *heap_page);
 
 
    private:
-    // A pointer to the start of the heap. This is used to compute the page number in the heap.
-    void *heap_start;
-    alaska::HeapPage **walk(void *page);
+    alaska::HeapPage **walk_alloc(void *page);
     alaska::HeapPage ***root;
   };
 
 
+  inline alaska::HeapPage *HeapPageTable::get_unaligned(void *addr) {
+    uint64_t span_number = (uintptr_t)addr >> alaska::span_shift_factor;
+    if (unlikely(span_number >> pt_bits)) return nullptr;
+
+    HeapPage **leaf = __atomic_load_n(&root[span_number >> pt_leaf_bits], __ATOMIC_ACQUIRE);
+    if (leaf == nullptr) return nullptr;
+    return __atomic_load_n(&leaf[span_number & pt_leaf_mask], __ATOMIC_ACQUIRE);
+  }
+
+
   // The Heap provides a simple interface for allocating and freeing memory. It's main job
   // is to take requests for allocations of a certain size, and to redirect those requests to
   // alaska::HeapPage instances, which manage memory issued by the PageManager. The interesting
@@ -145,9 +182,11 @@ namespace alaska {
     Heap(alaska::Configuration &config);
     ~Heap(void);
 
-    // Get an unowned sized page given a certain size request.
+    // Get an unowned sized page given a certain size request. If a new page has to be made,
+    // `refills` (how many pages of this class the owner has gone through) decides how many spans
+    // it gets: see SizedPage::span_count.
     // TODO: Allow filtering by fullness?
-    alaska::SizedPage *get_sizedpage(size_t size, ThreadCache *owner = nullptr);
+    alaska::SizedPage *get_sizedpage(size_t size, ThreadCache *owner = nullptr, int refills = 0);
     alaska::LocalityPage *get_localitypage(size_t size_requirement, ThreadCache *owner = nullptr);
 
 
@@ -176,8 +215,8 @@ namespace alaska {
 
    private:
     template <typename T, typename Fn>
-    T *find_or_alloc_page(
-        alaska::Magazine<T> &mag, ThreadCache *owner, size_t avail_requirement, Fn &&init);
+    T *find_or_alloc_page(alaska::Magazine<T> &mag, ThreadCache *owner, size_t avail_requirement,
+        long spans, Fn &&init);
 
     // This lock is taken whenever global state in the heap is changed by a thread cache.
     ck::mutex lock;
@@ -187,9 +226,22 @@ namespace alaska {
 
 
 
+  template <typename Fn>
+  void PageManager::for_each_span(Fn f) {
+    ck::scoped_lock lk(this->lock);
+    for (long r = 0; r < num_regions; r++) {
+      uintptr_t start = (uintptr_t)regions[r];
+      // Every region but the last one has been bumped all the way through
+      uintptr_t limit = r == num_regions - 1 ? (uintptr_t)bump : start + alaska::heap_size;
+      for (uintptr_t span = start; span < limit; span += alaska::span_size)
+        f((void *)span);
+    }
+  }
+
+
   template <typename T, typename Fn>
-  T *Heap::find_or_alloc_page(
-      alaska::Magazine<T> &mag, ThreadCache *owner, size_t avail_requirement, Fn &&init_fn) {
+  T *Heap::find_or_alloc_page(alaska::Magazine<T> &mag, ThreadCache *owner,
+      size_t avail_requirement, long spans, Fn &&init_fn) {
     ALASKA_SANITY(
         this->lock.is_locked(), "The lock must be held before calling find_or_alloc_page");
     if (mag.size() != 0) {
@@ -207,10 +259,10 @@ namespace alaska {
 
 
     // Allocate a new sized page
-    void *memory = this->pm.alloc_page();
-    T *p = new T(memory);
-    // Map it in the page table for fast lookup
-    pt.set(memory, p);
+    void *memory = this->pm.alloc_spans(spans);
+    T *p = new T(memory, spans * alaska::span_size);
+    // Map each of its spans in the page table for fast lookup
+    pt.set_range(memory, p->size(), p);
     mag.add(p);
     p->set_owner(owner);
 
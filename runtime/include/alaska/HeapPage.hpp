@@ -19,10 +19,17 @@
 
 namespace alaska {
 
-  // This dictates how big a page is. Note: This must be an odd number
-  // due to details about how the page table is implemented.
+  // This dictates how big a page is (at most).
   static constexpr uint64_t page_shift_factor = 21;
   static constexpr size_t page_size = 1LU << page_shift_factor;
+  // The heap is handed out in spans. A HeapPage is a power of two run of
+  // spans, from one span up to a full page_size, and the HeapPageTable maps
+  // every span to the HeapPage it is a part of.
+  static constexpr uint64_t span_shift_factor = 16;
+  static constexpr size_t span_size = 1LU << span_shift_factor;
+  static constexpr long spans_per_page = page_size / span_size;
+  // Runs of 2^0 through 2^(num_span_orders - 1) spans
+  static constexpr int num_span_orders = page_shift_factor - span_shift_factor + 1;
   static constexpr size_t huge_object_thresh = 0xFFFF;
 
   // Forward Declaration
@@ -59,7 +66,7 @@ namespace alaska {
   // single contiguous block of memory that is managed by some policy.
   class HeapPage : public alaska::OwnedBy<ThreadCache>, public alaska::InternalHeapAllocated {
    public:
-    HeapPage(void* backing_memory);
+    HeapPage(void* backing_memory, size_t size = alaska::page_size);
     virtual ~HeapPage();
 
     // The size argument is already aligned and rounded up to a multiple of the rounding size.
@@ -74,7 +81,9 @@ namespace alaska {
 
 
     void* start(void) const { return memory; }
-    void* end(void) const { return (void*)((uintptr_t)memory + page_size); }
+    void* end(void) const { return (void*)((uintptr_t)memory + memory_size); }
+    // How many bytes of backing memory this page has.
+    size_t size(void) const { return memory_size; }
 
     virtual void dump_html(FILE* stream) { fprintf(stream, "TODO"); }
     virtual void dump_json(FILE* stream) {
@@ -82,8 +91,9 @@ namespace alaska {
     }
 
    protected:
-    // This is the backing memory for the page. it is alaska::page_size bytes long.
+    // This is the backing memory for the page. it is memory_size bytes long.
     void* memory = nullptr;
+    size_t memory_size = alaska::page_size;
 
    public:
     // Intrusive linked list for magazine membership
@@ -94,7 +104,7 @@ namespace alaska {
   inline bool HeapPage::contains(void* pt) const {
     uintptr_t ptr = reinterpret_cast<uintptr_t>(pt);
     uintptr_t start = reinterpret_cast<uintptr_t>(memory);
-    uintptr_t end = start + alaska::page_size;
+    uintptr_t end = start + memory_size;
     return ptr >= start && ptr < end;
   }
 
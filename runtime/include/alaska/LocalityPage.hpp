@@ -41,8 +41,8 @@ namespace alaska {
       }
     };
 
-    LocalityPage(void *backing_memory)
-        : alaska::HeapPage(backing_memory) {
+    LocalityPage(void *backing_memory, size_t size = alaska::page_size)
+        : alaska::HeapPage(backing_memory, size) {
       data = backing_memory;
       data_bump_next = data;
       md_bump_next = get_md(0);
@@ -78,7 +78,7 @@ namespace alaska {
    private:
     Metadata *find_md(void *ptr);
     inline Metadata *get_md(uint32_t offset) {
-      return (Metadata *)((uintptr_t)data + page_size) - (offset + 1);
+      return (Metadata *)((uintptr_t)data + memory_size) - (offset + 1);
     }
 
     inline void *get_ptr(uint32_t index) { return get_md(index)->get_data(); }
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <alaska/utils.h>
+
+namespace alaska {
+
+  // Where the kernel keeps the current CPU of this thread up to date: the
+  // cpu_id of its rseq area (see rseq(2)), which is either the one libc
+  // registered, or one the runtime registered itself. Null until the thread's
+  // first call to current_cpu.
+  extern __thread volatile uint32_t *cpu_id_slot;
+
+  int current_cpu_slow(void);
+
+  // The CPU the calling thread is running on. Nothing stops the thread from
+  // migrating right after, so this can only be used to pick which per-CPU
+  // structure is least likely to be contended, not to avoid locking it.
+  inline int current_cpu(void) {
+    if (likely(cpu_id_slot != nullptr)) {
+      int cpu = (int)*cpu_id_slot;
+      if (likely(cpu >= 0)) return cpu;
+    }
+    return current_cpu_slow();
+  }
+
+  // How many CPUs the system could have. Every CPU id is below this.
+  int num_cpus(void);
+
+  // Can this thread use rseq critical sections (PerCpuStacks)? Registers rseq if it has to.
+  bool rseq_available(void);
+
+
+  // A small stack of pointers for every CPU, for each of `lists` lists. Push and pop run in rseq
+  // critical sections on the stack of the CPU the caller is running on: if the thread is
+  // preempted, migrated or signalled part way through, the kernel restarts the operation, so they
+  // need no lock, and a thread stalled in one never holds up anyone else. Without rseq (or off
+  // x86_64), push always fails and pop always comes back empty, so callers need a slow path.
+  class PerCpuStacks final {
+   public:
+    static constexpr long capacity = 31;
+
+    PerCpuStacks(int lists);
+    ~PerCpuStacks(void);
+
+    // Pop the top of this CPU's stack `list`, or null if it is empty.
+    void *pop(int list);
+    // Push `value` onto this CPU's stack `list`, if it has room and `*guard` still equals
+    // `expect` when the push commits.
+    bool push(int list, void *value, const uint64_t *guard, uint64_t expect);
+    // How many values are in the stacks, on every CPU. Racy, unless nothing else is using them.
+    long size(void) const;
+
+    // Empty every stack on every CPU into `f`. Nothing else may be using the stacks.
+    template <typename Fn>
+    void drain(Fn f);
+
+   private:
+    // One cache line's worth or so: the count, then the values from the bottom up.
+    struct Stack {
+      uint64_t count;
+      void *values[capacity];
+    };
+    Stack *stacks;  // stacks[cpu * lists + list]
+    int lists;
+  };
+
+
+  template <typename Fn>
+  void PerCpuStacks::drain(Fn f) {
+    for (long i = 0; i < (long)alaska::num_cpus() * lists; i++) {
+      while (stacks[i].count > 0)
+        f(stacks[i].values[--stacks[i].count]);
+    }
+  }
+}  // namespace alaska
@@ -17,8 +17,10 @@
 #include <alaska/Heap.hpp>
 #include <alaska/alaska.hpp>
 #include <ck/set.h>
+#include <ck/vec.h>
 #include <alaska/Configuration.hpp>
 #include <alaska/Localizer.hpp>
+#include <alaska/PerCpu.hpp>
 
 namespace alaska {
   /**
@@ -45,10 +47,18 @@ namespace alaska {
     // This is the actual heap
     alaska::Heap heap;
 
+    // Objects up to this size which were freed through cpu_hfree, kept (handle and all) on a
+    // stack for their size class on the CPU that freed them, for cpu_halloc to hand straight back.
+    static constexpr size_t cpu_cached_size = 1024;
+    alaska::PerCpuStacks cpu_objects;
+
 
     // This is a set of all the active thread caches in the system
     ck::set<alaska::ThreadCache *> tcs;
     ck::mutex tcs_lock;
+    // Thread caches whose threads have exited, waiting to be adopted by new
+    // threads. They still have their handle slab, but no pages.
+    ck::vec<alaska::ThreadCache *> retired_tcs;
 
     // A pointer to the runtime's current barrier manager.
     // This is defaulted to a "nop" manager which simply does nothing.
@@ -73,6 +83,18 @@ namespace alaska {
     // Allocate and free thread caches.
     ThreadCache *new_threadcache(void);
     void del_threadcache(ThreadCache *);
+    // Called when the thread using a thread cache exits. Its pages go back to
+    // the heap, and the thread cache itself goes to the next thread that
+    // calls new_threadcache, if the pool (config.thread_cache_pool_size) has
+    // room for it.
+    void retire_threadcache(ThreadCache *);
+    // The thread cache shared by every thread running on `cpu` (see
+    // ALASKA_PER_CPU_CACHES). Created the first time it's asked for.
+    ThreadCache *cpu_threadcache(int cpu);
+    // Allocate and free through the calling CPU's caches. Small objects come from and go to
+    // cpu_objects without taking any lock. Anything else, or a miss, locks the CPU's thread cache.
+    void *cpu_halloc(size_t size, bool zero = false);
+    void cpu_hfree(void *handle);
     void dump(FILE *stream);
 
 
@@ -84,15 +106,18 @@ namespace alaska {
     template <typename Fn>
     bool with_barrier(Fn &&cb) {
       auto now = alaska_timestamp();
-      if (now - last_barrier_time < min_barrier_interval) {
+      if (now - last_barrier_time < config.min_barrier_interval) {
         return false;
       }
       last_barrier_time = now;
 
       lock_all_thread_caches();
+      auto stop_start = alaska_timestamp();
       if (barrier_manager->begin()) {
+        barrier_manager->record_time_to_safepoint(alaska_timestamp() - stop_start);
         in_barrier = true;
         barrier_manager->barrier_count++;
+        __atomic_fetch_add(&alaska_barrier_epoch, 1, __ATOMIC_RELEASE);
         cb();
         in_barrier = false;
         barrier_manager->end();
@@ -106,10 +131,11 @@ namespace alaska {
 
    private:
     int next_thread_cache_id = 0;
+    // One per CPU, indexed by CPU id (see cpu_threadcache)
+    ThreadCache **cpu_tcs = nullptr;
 
 
     unsigned long last_barrier_time = 0;
-    unsigned long min_barrier_interval = 250 * 1000 * 1000;
 
 
     void lock_all_thread_caches(void);
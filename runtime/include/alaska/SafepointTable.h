@@ -0,0 +1,68 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+#pragma once
+
+#include <stdint.h>
+
+// The safepoints of a blob of managed code, in the form the barrier uses them.
+// The runtime builds this from the blob's stackmaps (.llvm_stackmaps) the first
+// time a barrier needs it. alaska-safepoints can instead build it once, after
+// linking, to be linked into the program as __alaska_safepoint_table: then the
+// runtime uses it in place, in read only memory shared by every process
+// running the program, and never parses the stackmap.
+//
+// Code addresses are offsets from the start of the blob's managed text
+// (__alaska_text_start), so they don't depend on where it is loaded.
+//
+//   struct alaska_safepoint_table header;
+//   uint32_t safepoints[num_safepoints];              (sorted)
+//   struct alaska_pin_set pin_sets[num_safepoints];
+//   uint32_t patches[num_patches];                    (the start of each poll)
+//   uint32_t block_rets[num_block_rets];              (sorted)
+
+#define ALASKA_SAFEPOINT_TABLE_MAGIC 0x54505341  // "ASPT"
+#define ALASKA_SAFEPOINT_TABLE_VERSION 1
+
+// The pin set of a poll, rather than of the return address of a call
+#define ALASKA_PIN_SET_POLL 1
+
+struct alaska_pin_set {
+  uint32_t count;  // How many entries?
+  uint16_t reg;    // Which (DWARF) register is it relative to?
+  uint16_t flags;  // ALASKA_PIN_SET_*
+  int32_t offset;  // Offset from that register
+};
+
+struct alaska_safepoint_table {
+  uint32_t magic;
+  uint32_t version;
+  // alaska_stackmap_hash of the stackmap the table was made from. A table
+  // which does not match the stackmap it is loaded with is ignored.
+  uint64_t stackmap_hash;
+  uint32_t num_safepoints;
+  uint32_t num_patches;
+  uint32_t num_block_rets;
+  uint32_t reserved;
+};
+
+
+// Hash one of a stackmap's functions (its offset from the start of managed
+// text, and how many records it has) into h, which starts as
+// ALASKA_STACKMAP_HASH_INIT. This catches a table left over from a different
+// build or link of the program, without reading any of the stackmap's records.
+#define ALASKA_STACKMAP_HASH_INIT 0xcbf29ce484222325ULL
+
+static inline uint64_t alaska_stackmap_hash(uint64_t h, uint64_t offset, uint64_t records) {
+  // FNV-1a, a word at a time
+  h = (h ^ offset) * 0x100000001b3ULL;
+  h = (h ^ records) * 0x100000001b3ULL;
+  return h;
+}
@@ -12,7 +12,9 @@
 #pragma once
 
 #include <unistd.h>
+#include <stdint.h>
 #include <alaska/HeapPage.hpp>
+#include <alaska/utils.h>
 
 namespace alaska {
   namespace internal {
@@ -48,12 +50,127 @@ namespace alaska {
   static constexpr long num_size_classes = 72;
   static constexpr long class_huge = num_size_classes;
 
+  // The size of the header a SizedPage keeps for each object
+  static constexpr size_t sized_page_header_size = 8;
+
+
+  // Division by a fixed divisor as a multiply and a shift. It is exact for every numerator below
+  // 2^reciprocal_bits, which covers any offset into a page: with L = ceil(log2(d)) and
+  // magic = ceil(2^(bits + L) / d), the rounding error of magic is less than d, so it adds less
+  // than n / 2^(bits + L) < 1/d to n/d, which is never enough to reach the next integer.
+  static constexpr int reciprocal_bits = alaska::page_shift_factor;
+  struct Reciprocal {
+    uint64_t magic = 0;
+    int shift = 0;
+
+    constexpr Reciprocal(void) = default;
+    constexpr explicit Reciprocal(uint64_t divisor) {
+      int log = divisor <= 1 ? 0 : 64 - __builtin_clzl(divisor - 1);
+      shift = reciprocal_bits + log;
+      magic = ((1LU << shift) + divisor - 1) / divisor;
+    }
+
+    constexpr uint64_t divide(uint64_t n) const { return (n * magic) >> shift; }
+  };
+
+
+  // How objects of a size class are laid out in a SizedPage of some number of spans: the headers
+  // come first, then the objects.
+  struct SizedPageLayout {
+    uint32_t capacity;        // How many objects fit
+    uint32_t objects_offset;  // Where the first object starts, from the start of the page
+  };
+
+  struct SizeClassInfo {
+    uint32_t size;                              // The size of each object
+    alaska::Reciprocal recip;                   // Divides by size
+    SizedPageLayout layouts[num_span_orders];  // For a page of 2^i spans
+  };
+
+
+  namespace internal {
+    // clang-format off
+    // The sizes of each class, in units of `alignment`. Taken from mimalloc.
+    static constexpr uint32_t class_words[num_size_classes] = {
+           1,      2,      3,      4,      5,      6,      7,      8, /* 8 */
+          10,     12,     14,     16,     20,     24,     28,     32, /* 16 */
+          40,     48,     56,     64,     80,     96,    112,    128, /* 24 */
+         160,    192,    224,    256,    320,    384,    448,    512, /* 32 */
+         640,    768,    896,   1024,   1280,   1536,   1792,   2048, /* 40 */
+        2560,   3072,   3584,   4096,   5120,   6144,   7168,   8192, /* 48 */
+       10240,  12288,  14336,  16384,  20480,  24576,  28672,  32768, /* 56 */
+       40960,  49152,  57344,  65536,  81920,  98304, 114688, 131072, /* 64 */
+      163840, 196608, 229376, 262144, 327680, 393216, 458752, 524288, /* 72 */
+    };
+    // clang-format on
+
+    // mimalloc's binning: the first 8 sizes each get a class, then each power of two is split
+    // into 4 classes by the next two bits (~12.5% worst internal fragmentation).
+    constexpr int compute_size_class(size_t sz) {
+      size_t wsize = (sz + alignment - 1) / alignment;
+      if (wsize == 0) wsize = 1;
+      if (wsize < 8) return wsize - 1;
+      wsize--;
+      // find the highest bit
+      int b = 63 - __builtin_clzl(wsize);
+      // - adjust with 4 because we do not round the first 8 sizes which each get an exact bin
+      return ((b << 2) + (int)((wsize >> (b - 2)) & 0x03)) - 4;
+    }
+
+    struct SizeClassTable {
+      SizeClassInfo classes[num_size_classes];
+    };
+
+    constexpr SizeClassTable make_size_class_table(void) {
+      SizeClassTable t = {};
+      for (int cls = 0; cls < num_size_classes; cls++) {
+        auto &info = t.classes[cls];
+        info.size = class_words[cls] * alignment;
+        info.recip = Reciprocal(info.size);
+        for (int order = 0; order < num_span_orders; order++) {
+          size_t bytes = alaska::span_size << order;
+          size_t capacity = bytes / (info.size + sized_page_header_size);
+          size_t headers = capacity * sized_page_header_size;
+          info.layouts[order].capacity = capacity;
+          info.layouts[order].objects_offset = (headers + alignment - 1) & ~(alignment - 1);
+        }
+      }
+      return t;
+    }
+    inline constexpr SizeClassTable size_class_table = make_size_class_table();
+
+
+    // Small sizes (the common case) find their class with a single load.
+    static constexpr size_t small_size_max = 1024;
+    struct SmallClassTable {
+      uint8_t classes[small_size_max / alignment + 1];
+    };
+
+    constexpr SmallClassTable make_small_class_table(void) {
+      SmallClassTable t = {};
+      for (size_t w = 0; w <= small_size_max / alignment; w++)
+        t.classes[w] = compute_size_class(w * alignment);
+      return t;
+    }
+    inline constexpr SmallClassTable small_class_table = make_small_class_table();
+  }  // namespace internal
+
+
+  inline const SizeClassInfo &size_class_info(int cls) {
+    return internal::size_class_table.classes[cls];
+  }
+
+  inline int size_to_class(size_t sz) {
+    if (likely(sz <= internal::small_size_max))
+      return internal::small_class_table.classes[(sz + alignment - 1) / alignment];
+    return internal::compute_size_class(sz);
+  }
+
+  inline size_t class_to_size(int cls) { return size_class_info(cls).size; }
+
   // Returns size of the memory block that will be allcoated if you ask for `sz` bytes.
   size_t round_up_size(size_t sz);
 
-  int size_to_class(size_t sz);
-  size_t class_to_size(int cls);
-
   bool should_be_huge_object(size_t size);
 
 }  // namespace alaska
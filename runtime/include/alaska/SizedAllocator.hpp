@@ -12,9 +12,11 @@
 #pragma once
 
 #include <stdlib.h>
+#include <string.h>
 #include <sys/cdefs.h>
 #include <alaska/ShardedFreeList.hpp>
 #include <alaska/HeapPage.hpp>
+#include <alaska/SizeClass.hpp>
 #include <alaska/track.hpp>
 
 namespace alaska {
@@ -23,6 +25,10 @@ namespace alaska {
 
   // A general abstraction for allocating objects from a block of memory
   // NOTE: it is assumed that objects_end is aligned to object_size somehow.
+  //
+  // Objects can have a parallel array of fixed size headers. They are not touched until the
+  // bump pointer passes their object: extend() zeroes them, so headers past frontier() are
+  // never written (or committed), and headers before it are always formatted.
   class SizedAllocator {
    public:
     SizedAllocator(void) = default;
@@ -43,7 +49,8 @@ namespace alaska {
       alaska_track_free(ptr, 0);
     }
 
-    void configure(void *objects, size_t object_size, long object_count);
+    void configure(void *objects, size_t object_size, long object_count,
+        void *headers = nullptr, size_t header_size = 0);
 
     inline bool some_available(void) {
       return free_list.has_local_free() || free_list.has_remote_free() ||
@@ -58,16 +65,18 @@ namespace alaska {
     inline long num_free_in_free_list(void) const { return free_list.num_free(); }
 
     inline long num_free_in_bump_allocator(void) const {
-      return (((uintptr_t)objects_end - (uintptr_t)bump_next) / object_size);
+      return index_recip.divide((uintptr_t)objects_end - (uintptr_t)bump_next);
     }
 
 
     // return the index of the object
     inline long object_index(void *ob) {
-      return ((uintptr_t)ob - (uintptr_t)this->objects_start) / this->object_size;
+      return index_recip.divide((uintptr_t)ob - (uintptr_t)this->objects_start);
     }
 
     long extend(long count);
+    // The first object which has never been handed to the free list by extend()
+    inline void *frontier(void) const { return bump_next; }
 
 
     void reset_free_list(void) { free_list.reset(); }
@@ -80,6 +89,10 @@ namespace alaska {
     void *objects_end;                  // The end of the object memory (exclusive)
     void *bump_next;                    // The next object to be bump allocated.
     size_t object_size;                 // How large each object is
+    alaska::Reciprocal index_recip;     // Divides by object_size (the memory is at most a page)
+    void *headers = nullptr;            // The header of each object, if there are any
+    size_t header_size = 0;             // How large each header is
+    long extend_count = 128;            // How many objects alloc_slow extends by
     alaska::ShardedFreeList free_list;  // A free list for tracking releases
   };
 
@@ -100,7 +113,7 @@ namespace alaska {
 
 
   __attribute__((noinline)) inline void *SizedAllocator::alloc_slow(void) {
-    long extended_count = extend(128);
+    long extended_count = extend(extend_count);
 
     // 1. If we managed to extend the list, return one of the blocks from it.
     if (extended_count > 0) {
@@ -128,6 +141,12 @@ namespace alaska {
     if (end > (off_t)objects_end) end = (off_t)objects_end;
     bump_next = (void *)end;
 
+    if (headers != nullptr && end > start) {
+      // Format the headers of the objects we are about to make allocatable
+      void *first = (void *)((uintptr_t)headers + object_index((void *)start) * header_size);
+      memset(first, 0, index_recip.divide(end - start) * header_size);
+    }
+
     for (off_t o = end - object_size; o >= start; o -= object_size) {
       free_list.free_local((void *)o);
       extended_count++;
@@ -137,10 +156,19 @@ namespace alaska {
   }
 
 
-  inline void SizedAllocator::configure(void *objects, size_t object_size, long object_count) {
+  inline void SizedAllocator::configure(void *objects, size_t object_size, long object_count,
+      void *headers, size_t header_size) {
     this->objects_start = this->bump_next = objects;
     this->objects_end = (void *)((uintptr_t)objects + (object_count * object_size));
     this->object_size = object_size;
+    this->index_recip = alaska::Reciprocal(object_size);
+    this->headers = headers;
+    this->header_size = header_size;
+    // Extending writes a free list link into every object, so don't extend past about a
+    // (small) page of memory at a time, or big objects commit memory nobody asked for yet.
+    this->extend_count = 4096 / object_size;
+    if (this->extend_count > 128) this->extend_count = 128;
+    if (this->extend_count < 1) this->extend_count = 1;
     // Re-construct the free list just in case
     this->free_list = ShardedFreeList();
   }
@@ -37,6 +37,13 @@ namespace alaska {
 
     void set_size_class(int cls);
     int get_size_class(void) const { return size_class; }
+
+    // How many spans a new page of class `cls` should get. The first page of a class is just
+    // big enough for min_objects, so a class which is barely used (or a thread which goes idle)
+    // doesn't pin a whole page. Each time the owner needs a new one (`refills`), the page
+    // doubles, until hot classes get a full page.
+    static long span_count(int cls, int refills);
+    static constexpr long min_objects = 16;
     size_t get_object_size(void) const { return object_size; }
 
     void dump_html(FILE *stream) override;
@@ -59,6 +66,11 @@ namespace alaska {
       inline auto get_mapping(void) const { return (alaska::Mapping *)((uint64_t)(_mapping) * 8); }
       inline bool is_free(void) const { return get_mapping() == NULL; }
     };
+    static_assert(sizeof(Header) == alaska::sized_page_header_size, "SizeClassInfo's layouts are off");
+
+    // How many headers have been formatted. The rest belong to objects which were never
+    // allocated, and haven't been touched.
+    long formatted(void) { return allocator.object_index(allocator.frontier()); }
 
     long header_to_ind(Header *h);
     Header *ind_to_header(long oid);
@@ -69,6 +81,7 @@ namespace alaska {
 
     int size_class;      // The size class of this page
     size_t object_size;  // The byte size of the size class of this page (saves a load)
+    alaska::Reciprocal recip;  // Divides by object_size
     Header *headers;     // The start of the headers
     void *objects;
     long capacity;
@@ -86,7 +99,7 @@ namespace alaska {
   inline long SizedPage::header_to_ind(Header *h) { return (h - headers); }
   inline SizedPage::Header *SizedPage::ind_to_header(long oid) { return headers + oid; }
   inline long SizedPage::object_to_ind(void *ob) {
-    return ((uintptr_t)ob - (uintptr_t)objects) / this->object_size;
+    return recip.divide((uintptr_t)ob - (uintptr_t)objects);
   }
   inline void *SizedPage::ind_to_object(long oid) {
     return (void *)((uintptr_t)objects + oid * this->object_size);
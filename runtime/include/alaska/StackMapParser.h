@@ -315,6 +315,15 @@ public:
   /// Get the version number of this stackmap. (Always returns 3).
   unsigned getVersion() const { return 3; }
 
+  /// Get the size of this stackmap in bytes. The linker concatenates the
+  /// stackmap of each object file, and the next one starts here.
+  size_t getSizeInBytes() const {
+    if (getNumRecords() == 0)
+      return ConstantsListOffset + getNumConstants() * ConstantSize;
+    auto Last = getRecord(getNumRecords() - 1);
+    return StackMapRecordOffsets[getNumRecords() - 1] + Last.getSizeInBytes();
+  }
+
   /// Get the number of functions in the stack map.
   uint32_t getNumFunctions() const {
     return read<uint32_t>(&StackMapSection[NumFunctionsOffset]);
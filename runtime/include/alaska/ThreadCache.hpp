@@ -43,6 +43,11 @@ namespace alaska {
     bool localize(alaska::Mapping &m, uint64_t epoch);
     bool localize(void *handle, uint64_t epoch);
 
+    // Hand the pages this thread cache owns back to the global heap, so other
+    // thread caches can allocate from them. If `slab` is set, its handle slab
+    // is given up too.
+    void release_pages(bool slab);
+
 
    protected:
     friend class LockedThreadCache;
@@ -79,6 +84,9 @@ namespace alaska {
     // it might allocate from. When a size class fills up, it is
     // returned to the global heap and another one is allocated.
     alaska::SizedPage *size_classes[alaska::num_size_classes] = {nullptr};
+    // How many pages of each size class this thread cache has gone through. New pages of the
+    // classes it uses the most get more spans (see SizedPage::span_count).
+    uint8_t refills[alaska::num_size_classes] = {0};
     // Each thread cache also has a private "Locality Page", which
     // objects can be relocated to according to some external
     // policy. This page is special because it can contain many
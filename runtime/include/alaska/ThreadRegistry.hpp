@@ -11,72 +11,210 @@
 
 #pragma once
 
-#include <alaska/list_head.h>
-#include <ck/map.h>
+#include <pthread.h>
 #include <ck/lock.h>
 #include <alaska/Logger.hpp>
 #include <alaska/alaska.hpp>
+#include <alaska/utils.h>
 
 namespace alaska {
 
 
 
   // A ThreadRegistry allows threads to be added and removed,
-  // and allows a little bit of data to be attached to the thread
+  // and allows a little bit of data to be attached to the thread.
+  //
+  // The threads are kept in an intrusive list which can be walked without
+  // taking any lock, and each thread finds its own entry through a thread
+  // local slot, so get_data is a TLS load. Joining and leaving take a short
+  // lock among themselves (which is also how a barrier stops threads from
+  // being created, see lock_thread_creation). An entry unlinked by leave is
+  // only freed once every walk that might still be looking at it is done:
+  // walks announce themselves in one of two counters, chosen by the epoch they
+  // start in, and the epoch only advances past a counter once it drains.
   template <typename T>
   class ThreadRegistry final : public alaska::InternalHeapAllocated {
    public:
-    ThreadRegistry(void) {}
     using ThreadData = T;
 
+    ThreadRegistry(void) {}
+    ~ThreadRegistry(void) {
+      free_entries(m_head, &Entry::next);
+      free_entries(m_retired, &Entry::next_retired);
+    }
+
     // Join with the current thread
     void join(ThreadData init_data = {}) {
       log_debug("thread join %lx\n", pthread_self());
+      auto *e = new Entry;
+      e->thread = pthread_self();
+      e->data = init_data;
+
       auto l = take_lock();
-      m_registry[pthread_self()] = init_data;
+      e->next = m_head;
+      // Walks see the entry once it is fully initialized
+      __atomic_store_n(&m_head, e, __ATOMIC_RELEASE);
+      __atomic_fetch_add(&m_num_threads, 1, __ATOMIC_RELAXED);
+      t_self = {this, e};
     }
 
     ThreadData leave(void) {
       log_debug("thread leave %lx\n", pthread_self());
       auto l = take_lock();
-      auto self = pthread_self();
-      auto td = m_registry[self];
-      m_registry.remove(self);
+      Entry *e = self();
+      ALASKA_ASSERT(e != nullptr, "a thread left a ThreadRegistry it never joined");
+      t_self = {};
+
+      for (Entry **link = &m_head; *link != nullptr; link = &(*link)->next) {
+        if (*link == e) {
+          // A walk that already passed *link still sees e, and its next.
+          __atomic_store_n(link, e->next, __ATOMIC_RELEASE);
+          break;
+        }
+      }
+      __atomic_fetch_sub(&m_num_threads, 1, __ATOMIC_RELAXED);
+
+      auto td = e->data;
+      retire(e);
       return td;
     }
 
 
     // Get the data for the *current thread*
     ThreadData &get_data(void) {
-      auto l = take_lock();  // SLOW
-      return m_registry[pthread_self];
+      Entry *e = self();
+      ALASKA_ASSERT(e != nullptr, "get_data on a thread that has not joined");
+      return e->data;
     }
 
 
+    // Call f on each thread. Threads may join or leave while this runs: the
+    // ones that do may or may not be seen, but everything f is given stays
+    // valid until it returns.
     template <typename Fn>
     void for_each(Fn f) {
-      auto l = take_lock();
-      for (auto &[pthread, data] : m_registry)
-        f(pthread, data);
+      auto epoch = enter_walk();
+      walk(f);
+      exit_walk(epoch);
     }
 
     ck::scoped_lock take_lock(void) { return this->m_lock; }
 
 
-    inline long num_threads() { return m_registry.size(); }
+    inline long num_threads() { return __atomic_load_n(&m_num_threads, __ATOMIC_RELAXED); }
 
     void lock_thread_creation(void) { m_lock.lock(); }
     void unlock_thread_creation(void) { m_lock.unlock(); }
 
 
+    // Like for_each, for a caller which holds the lock (take_lock or
+    // lock_thread_creation), so nobody can join or leave.
     template <typename Fn>
     void for_each_locked(Fn f) {
-      for (auto &[pthread, data] : m_registry)
-        f(pthread, data);
+      walk(f);
     }
 
    private:
+    struct Entry : public alaska::InternalHeapAllocated {
+      pthread_t thread;
+      ThreadData data;
+      Entry *next = nullptr;
+      // A walk may still be standing on a retired entry, so it keeps next
+      Entry *next_retired = nullptr;
+      uint64_t retired_epoch = 0;
+    };
+
+    // This thread's entry. It is shared by every registry of the same T, so
+    // it remembers which registry it belongs to.
+    struct Self {
+      ThreadRegistry *registry = nullptr;
+      Entry *entry = nullptr;
+    };
+    static inline thread_local Self t_self;
+
+    Entry *self(void) {
+      if (likely(t_self.registry == this)) return t_self.entry;
+      // Joined a different registry of the same type last. Rare.
+      auto epoch = enter_walk();
+      Entry *found = nullptr;
+      auto me = pthread_self();
+      for (Entry *e = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE); e != nullptr;
+           e = __atomic_load_n(&e->next, __ATOMIC_ACQUIRE)) {
+        if (pthread_equal(e->thread, me)) {
+          found = e;
+          break;
+        }
+      }
+      exit_walk(epoch);
+      return found;
+    }
+
+    template <typename Fn>
+    void walk(Fn &f) {
+      for (Entry *e = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE); e != nullptr;
+           e = __atomic_load_n(&e->next, __ATOMIC_ACQUIRE)) {
+        f(e->thread, e->data);
+      }
+    }
+
+
+    uint64_t enter_walk(void) {
+      while (true) {
+        uint64_t epoch = __atomic_load_n(&m_epoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&m_walkers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+        // If the epoch moved on, the counter might have already been checked.
+        if (__atomic_load_n(&m_epoch, __ATOMIC_SEQ_CST) == epoch) return epoch;
+        __atomic_fetch_sub(&m_walkers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+      }
+    }
+
+    void exit_walk(uint64_t epoch) { __atomic_fetch_sub(&m_walkers[epoch & 1], 1, __ATOMIC_SEQ_CST); }
+
+
+    // Called with the lock held, once e is unreachable from m_head.
+    void retire(Entry *e) {
+      e->retired_epoch = __atomic_load_n(&m_epoch, __ATOMIC_SEQ_CST);
+      e->next_retired = m_retired;
+      m_retired = e;
+
+      // The walks that started before e was unlinked started in its epoch (or
+      // the one before). Move the epoch on as far as the walks allow: each step
+      // needs the walks two epochs back to be done, as they share a counter.
+      for (int i = 0; i < 2; i++) {
+        uint64_t epoch = __atomic_load_n(&m_epoch, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&m_walkers[(epoch + 1) & 1], __ATOMIC_SEQ_CST) != 0) break;
+        __atomic_store_n(&m_epoch, epoch + 1, __ATOMIC_SEQ_CST);
+      }
+
+      // Anything retired two epochs ago can no longer be seen by any walk
+      uint64_t epoch = __atomic_load_n(&m_epoch, __ATOMIC_SEQ_CST);
+      for (Entry **link = &m_retired; *link != nullptr;) {
+        Entry *r = *link;
+        if (r->retired_epoch + 2 <= epoch) {
+          *link = r->next_retired;
+          delete r;
+        } else {
+          link = &r->next_retired;
+        }
+      }
+    }
+
+    static void free_entries(Entry *e, Entry *Entry::*next) {
+      while (e != nullptr) {
+        Entry *n = e->*next;
+        delete e;
+        e = n;
+      }
+    }
+
+
     ck::mutex m_lock;
-    ck::map<pthread_t, ThreadData> m_registry;
+    Entry *m_head = nullptr;
+    long m_num_threads = 0;
+
+    uint64_t m_epoch = 0;
+    long m_walkers[2] = {0, 0};
+    // Left, but maybe still being looked at by a walk
+    Entry *m_retired = nullptr;
   };
 }  // namespace alaska
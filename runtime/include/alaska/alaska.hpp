@@ -43,8 +43,12 @@ extern "C" {
 void *alaska_encode(alaska::Mapping *m, off_t offset);
 void *alaska_translate_escape(void *ptr);
 void *alaska_translate(void *ptr);
+void alaska_translate_batch(void *const *handles, void **out, size_t count);
 void alaska_release(void *ptr);
 void *alaska_ensure_present(alaska::Mapping *m);
+
+// core/Runtime.cpp
+extern uint64_t alaska_barrier_epoch;
 }
 
 namespace alaska {
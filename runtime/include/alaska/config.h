@@ -3,9 +3,16 @@
 // Include the autoconf.h header from menuconfig.
 
 #ifdef __amd64__
+#ifdef ALASKA_POLL_GUARD_PAGE
+// With guard page polls, each poll is rewritten once, at startup, to
+// `test %al, (page)`: a 7 byte load from the polling page, which the barrier
+// makes unreadable to stop threads at their next poll.
+#define ALASKA_PATCH_SIZE 7
+#else
 // On x86, we simply use `ud2` to trigger a SIGILL
 #define ALASKA_PATCH_SIZE 2
 #endif
+#endif
 
 
 #ifdef __aarch64__
@@ -19,4 +26,14 @@
 #define ALASKA_PATCH_SIZE 2
 #endif
 
+#if defined(ALASKA_POLL_GUARD_PAGE) && !defined(__amd64__)
+#error "ALASKA_POLL_GUARD_PAGE is only supported on x86-64"
+#endif
+
+// With ALASKA_FRAME_POINTER_SCAN, managed code keeps frame pointers, and the
+// barrier walks managed frames by following them instead of with libunwind.
+#if defined(ALASKA_FRAME_POINTER_SCAN) && !defined(__amd64__)
+#error "ALASKA_FRAME_POINTER_SCAN is only supported on x86-64"
+#endif
+
 #define ALASKA_SQUEEZE_BITS 3
@@ -0,0 +1,88 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace alaska::sim {
+
+  enum class ReplacementPolicy { LRU, PLRU, SRRIP, Random };
+
+  const char *policy_name(ReplacementPolicy policy);
+
+
+  // A flat set-associative cache of handle ids, used for design-space
+  // exploration of HTLB geometries. Unlike L1HTLB/L2HTLB, this models only
+  // hits and misses, so it can be run over a trace for many configurations at
+  // once. Tags for a set are laid out contiguously (padded out to a multiple
+  // of 8 ways) so a lookup is a handful of SIMD compares.
+  class SetAssocCache final {
+   public:
+    SetAssocCache(uint32_t num_sets, uint32_t num_ways, ReplacementPolicy policy);
+
+    // Access a handle id, returning true on a hit. Misses fill the line.
+    bool access(uint32_t hid);
+    // Drop a handle id from the cache if it is present.
+    void invalidate(uint32_t hid);
+    void reset(void);
+
+    uint32_t num_sets(void) const { return m_num_sets; }
+    uint32_t num_ways(void) const { return m_num_ways; }
+    ReplacementPolicy policy(void) const { return m_policy; }
+
+    uint64_t accesses = 0;
+    uint64_t hits = 0;
+
+   private:
+    uint32_t m_num_sets, m_num_ways;
+    uint32_t m_stride;  // m_num_ways, rounded up to a multiple of 8
+    ReplacementPolicy m_policy;
+
+    // A tag is `hid + 1`, so zero means the way is invalid. Padding ways are
+    // always zero, so they never match a valid tag.
+    std::vector<uint32_t> m_tags;
+    // Per-way replacement state: LRU timestamps, or SRRIP re-reference values.
+    std::vector<uint64_t> m_meta;
+    // Per-set MRU bits for PLRU.
+    std::vector<uint64_t> m_mru;
+    uint64_t m_time = 0;
+    uint64_t m_rng = 0x9E3779B97F4A7C15ULL;
+
+    int find(const uint32_t *set, uint32_t tag) const;
+    uint32_t victim(uint32_t set_index);
+    void touch(uint32_t set_index, uint32_t way, bool fill);
+  };
+
+
+  // Simulate many HTLB geometries over the same access stream in one pass.
+  class HTLBSweep final {
+   public:
+    void add(uint32_t num_sets, uint32_t num_ways, ReplacementPolicy policy);
+    // Add the cross product of the given geometries and policies.
+    void add_all(const std::vector<uint32_t> &entries, const std::vector<uint32_t> &ways,
+        const std::vector<ReplacementPolicy> &policies);
+
+    void access(uint32_t hid) {
+      for (auto &c : caches)
+        c.access(hid);
+    }
+    void invalidate(uint32_t hid) {
+      for (auto &c : caches)
+        c.invalidate(hid);
+    }
+
+    void dump_csv(FILE *stream);
+
+    std::vector<SetAssocCache> caches;
+  };
+}  // namespace alaska::sim
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+#pragma once
+
+/*
+ * Binary format of the handle access traces written by the HTLB simulator
+ * (set ALASKA_HTLB_TRACE=<path> when running with ALASKA_HTLB_SIM). This
+ * header is plain C so standalone tools like extra/htlb.c can replay them.
+ *
+ * A trace starts with an 8 byte header (the magic and a version number)
+ * and is followed by a stream of events. Each event is the zigzag-encoded
+ * delta from the previous address, written as an LEB128 varint. Since most
+ * accesses hit the same handle or a nearby one, the common case is one or
+ * two bytes per access.
+ *
+ * Invalidations (from hfree) are rare, so rather than spending a tag bit on
+ * every event they are introduced by an escape: the non-canonical varint
+ * `0x80 0x00`, which the encoder never otherwise produces. The delta that
+ * follows the escape is the invalidated handle.
+ *
+ * Events from different threads are written in the order their buffers were
+ * drained, so the trace is ordered per thread, not globally.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define ALASKA_TRACE_MAGIC 0x52544841 /* "AHTR" */
+#define ALASKA_TRACE_VERSION 1
+
+#define ALASKA_TRACE_ACCESS 0
+#define ALASKA_TRACE_INVALIDATE 1
+
+struct alaska_trace_header {
+  uint32_t magic;
+  uint32_t version;
+};
+
+/* Encode one event into `out` (at least 12 bytes), returning the length. */
+static inline size_t alaska_trace_encode(
+    uint8_t *out, uint64_t *last, uint64_t addr, int kind) {
+  size_t len = 0;
+  int64_t delta = (int64_t)(addr - *last);
+  uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+  *last = addr;
+
+  if (kind == ALASKA_TRACE_INVALIDATE) {
+    out[len++] = 0x80;
+    out[len++] = 0x00;
+  }
+
+  while (zz >= 0x80) {
+    out[len++] = (uint8_t)(zz | 0x80);
+    zz >>= 7;
+  }
+  out[len++] = (uint8_t)zz;
+  return len;
+}
+
+/* Decode the next event from `stream`. Returns 0 at end of file. */
+static inline int alaska_trace_decode(FILE *stream, uint64_t *last, uint64_t *addr, int *kind) {
+  uint64_t zz = 0;
+  int shift = 0;
+  int c;
+
+  *kind = ALASKA_TRACE_ACCESS;
+
+  while (1) {
+    if ((c = getc(stream)) == EOF) return 0;
+    if (c == 0x80 && shift == 0) {
+      int next = getc(stream);
+      if (next == EOF) return 0;
+      if (next == 0x00) {
+        *kind = ALASKA_TRACE_INVALIDATE;
+        continue;
+      }
+      ungetc(next, stream);
+    }
+    zz |= (uint64_t)(c & 0x7F) << shift;
+    shift += 7;
+    if ((c & 0x80) == 0) break;
+  }
+
+  *last += (uint64_t)((int64_t)(zz >> 1) ^ -(int64_t)(zz & 1));
+  *addr = *last;
+  return 1;
+}
@@ -11,6 +11,7 @@
 #define UNW_LOCAL_ONLY
 #include <libunwind.h>
 #include <alaska/StackMapParser.h>
+#include <alaska/SafepointTable.h>
 #include <alaska/config.h>
 
 
@@ -24,7 +25,6 @@
 #include <alaska/ThreadRegistry.hpp>
 
 #include <ck/lock.h>
-#include <ck/map.h>
 #include <ck/set.h>
 #include <ck/vec.h>
 #include <ck/func.h>
@@ -37,6 +37,7 @@
 #include <sys/signal.h>
 #include <sys/mman.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 
 
@@ -47,12 +48,6 @@ enum class StackState {
 };
 
 
-struct PinSetInfo {
-  uint32_t count = 0;   // How many entries?
-  uint32_t regNum = 0;  // Which libunwind register?
-  int32_t offset = 0;   // offset from that register?
-};
-
 struct StackMapping {
   bool direct;
   uint32_t regNum;
@@ -60,49 +55,117 @@ struct StackMapping {
   uint64_t id;
 };
 
-struct ManagedBlobRegion {
+// A blob of managed code (see alaska_blob_init), and its safepoints: its
+// polls, and the return addresses of its calls. They are in the layout of
+// alaska/SafepointTable.h, either in the table linked into the program or
+// built from the stackmap the first time a barrier needs them. Every frame of
+// every barrier is looked up here, so the addresses are kept apart from the
+// rest: a binary search only touches a few cache lines of them.
+struct ManagedBlob {
   uintptr_t start, end;
+  // The stackmap, until the safepoints have been found
+  uint8_t* stackmap;
+  uint8_t* stackmap_end;
+  const uint32_t* safepoints;
+  const alaska_pin_set* pin_sets;
+  uint32_t num_safepoints;
+  const uint32_t* patches;
+  uint32_t num_patches;
+  // the return addresses from calls to potentially blocking functions
+  const uint32_t* block_rets;
+  uint32_t num_block_rets;
 };
 
-
-static ck::vec<ManagedBlobRegion> managed_blob_text_regions;
-static ck::map<uintptr_t, PinSetInfo> pin_map;
-// the return addresses from calls to potentially blocking functions
-static ck::set<uintptr_t> block_rets;
+static ck::vec<ManagedBlob> managed_blobs;
 
 
 #ifdef __amd64__
 using inst_t = uint16_t;
+static const inst_t inst_sig = 0x0B'0F;  // ud2
+static const inst_t inst_nop = 0x90'66;  // A 2 byte nop
 #endif
 #ifdef __aarch64__
+// Arm is way easier than x86...
 using inst_t = uint32_t;
+static const inst_t inst_sig = 0x00000000;  // udf #0
+static const inst_t inst_nop = 0xd503201f;  // nop
 #endif
 #ifdef __riscv
 using inst_t = uint16_t;
+static const inst_t inst_sig = 0x0000;  // unimp
+static const inst_t inst_nop = 0x0001;  // nop
 #endif
 
-struct PatchPoint {
-  inst_t* pc;
-  inst_t inst_nop;
-  inst_t inst_sig;
-};
-static ck::vec<PatchPoint> patchPoints;
 
+#ifdef ALASKA_POLL_GUARD_PAGE
+// With guard page polls, the code is never patched during a barrier. Instead,
+// every poll loads from this page, and a barrier stops threads by making it
+// unreadable, so each of them faults (SIGSEGV) at its next poll. Arming a
+// barrier is then one mprotect, no matter how many polls the program has,
+// and the text does not have to stay writable. The page is mapped in the low
+// 2GB so a poll can address it with a 32 bit displacement.
+static void* poll_page = nullptr;
+
+static void* get_poll_page(void) {
+  if (poll_page == nullptr) {
+    poll_page = mmap(NULL, 4096, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (poll_page == MAP_FAILED) {
+      perror("alaska: failed to map the safepoint polling page");
+      abort();
+    }
+  }
+  return poll_page;
+}
+
+static bool is_poll_fault(siginfo_t* info) {
+  return poll_page != nullptr && (uintptr_t)info->si_addr - (uintptr_t)poll_page < 4096;
+}
+
+static void patchSignal() { mprotect(get_poll_page(), 4096, PROT_NONE); }
 
+// The SIGSEGV action that was there before ours (see setup_signal_handlers).
+// Faults that aren't polls belong to it: the program's own handler, or a
+// sanitizer's. Zeroed, it is SIG_DFL.
+static struct sigaction previous_segv_action;
 
-static void patchSignal() {
-  for (auto& p : patchPoints) {
-    __atomic_store_n(p.pc, p.inst_sig, __ATOMIC_RELEASE);
+static void forward_fault(int sig, siginfo_t* info, void* ptr) {
+  auto& prev = previous_segv_action;
+  if (!(prev.sa_flags & SA_SIGINFO) && (prev.sa_handler == SIG_DFL || prev.sa_handler == SIG_IGN)) {
+    // Put it back, and let the fault happen again under it when we return.
+    sigaction(SIGSEGV, &prev, NULL);
+    return;
   }
+
+  // Run it as the kernel would have, with its mask
+  sigset_t mask;
+  pthread_sigmask(SIG_BLOCK, &prev.sa_mask, &mask);
+  if (prev.sa_flags & SA_SIGINFO) {
+    prev.sa_sigaction(sig, info, ptr);
+  } else {
+    prev.sa_handler(sig);
+  }
+  pthread_sigmask(SIG_SETMASK, &mask, NULL);
 }
 
+static void patchNop(void) { mprotect(get_poll_page(), 4096, PROT_READ); }
 
-static void patchNop(void) {
-  for (auto& p : patchPoints) {
-    __atomic_store_n(p.pc, p.inst_nop, __ATOMIC_RELEASE);
+#else
+
+static void patch_polls(inst_t inst) {
+  for (auto& blob : managed_blobs) {
+    for (uint32_t i = 0; i < blob.num_patches; i++) {
+      __atomic_store_n((inst_t*)(blob.start + blob.patches[i]), inst, __ATOMIC_RELEASE);
+    }
   }
 }
 
+static void patchSignal() { patch_polls(inst_sig); }
+
+static void patchNop(void) { patch_polls(inst_nop); }
+#endif
+
+static void find_safepoints(void);
+
 static void setup_signal_handlers(void);
 static void clear_pending_signals(void);
 
@@ -145,15 +208,55 @@ void alaska_dump_thread_states(void) {
 }
 
 
+static const ManagedBlob* find_blob(uintptr_t pc) {
+  for (auto& blob : managed_blobs) {
+    if (pc >= blob.start && pc < blob.end) return &blob;
+  }
+  return nullptr;
+}
+
+static bool in_managed_text(uintptr_t pc) { return find_blob(pc) != nullptr; }
+
+// The index of `offset` in a sorted table of them, or -1
+static long find_offset(const uint32_t* table, uint32_t count, uint32_t offset) {
+  uint32_t lo = 0, hi = count;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (table[mid] < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < count && table[lo] == offset) return lo;
+  return -1;
+}
+
+static const alaska_pin_set* find_safepoint(uintptr_t pc) {
+  auto* blob = find_blob(pc);
+  if (blob == nullptr) return nullptr;
+  long i = find_offset(blob->safepoints, blob->num_safepoints, pc - blob->start);
+  return i < 0 ? nullptr : &blob->pin_sets[i];
+}
+
+static bool is_poll(uintptr_t pc) {
+  auto* psi = find_safepoint(pc);
+  return psi != nullptr && (psi->flags & ALASKA_PIN_SET_POLL);
+}
+
+static bool is_block_ret(uintptr_t pc) {
+  auto* blob = find_blob(pc);
+  return blob != nullptr &&
+         find_offset(blob->block_rets, blob->num_block_rets, pc - blob->start) >= 0;
+}
+
+
 static StackState get_stack_state(uintptr_t return_address) {
-  if (pin_map.contains(return_address)) {
+  if (is_poll(return_address)) {
     return StackState::ManagedTracked;
   }
 
-  for (auto [start, end] : managed_blob_text_regions) {
-    if (return_address >= start && return_address < end) {
-      return StackState::ManagedUntracked;
-    }
+  if (in_managed_text(return_address)) {
+    return StackState::ManagedUntracked;
   }
 
   return StackState::Unmanaged;
@@ -184,6 +287,8 @@ static ck::mutex dump_lock;
 static bool in_might_block_function(uintptr_t start_addr) {
   void* buffer[512];
 
+  find_safepoints();
+
   int depth = backtrace(buffer, 512);
   dump_lock.lock();
   bool found_start = false;
@@ -196,14 +301,11 @@ static bool in_might_block_function(uintptr_t start_addr) {
 
     const char* msg = "\e[33m(unmanaged)\e[0m";
 
-    for (auto [start, end] : managed_blob_text_regions) {
-      if (addr >= start && addr < end) {
-        // red
-        msg = "\e[31m(managed)\e[0m";
-        break;
-      }
+    if (in_managed_text(addr)) {
+      // red
+      msg = "\e[31m(managed)\e[0m";
     }
-    if (pin_map.contains(addr)) {
+    if (is_poll(addr)) {
       // green
       msg = "\e[32m(managed)\e[0m";
     }
@@ -216,7 +318,7 @@ static bool in_might_block_function(uintptr_t start_addr) {
 
 
   for (int i = 0; i < depth; i++) {
-    if (block_rets.contains((uintptr_t)buffer[i])) {
+    if (is_block_ret((uintptr_t)buffer[i])) {
       return true;
     }
   }
@@ -224,13 +326,79 @@ static bool in_might_block_function(uintptr_t start_addr) {
   return false;
 }
 
+static void add_pin_set(const alaska_pin_set& psi, uintptr_t base, ck::set<void*>& out) {
+  void** localSet = (void**)(base + psi.offset);
+
+  for (uint32_t i = 0; i < psi.count; i++) {
+    if (might_be_handle(localSet[i])) {
+      out.add(localSet[i]);
+    }
+  }
+}
+
+
+#ifdef ALASKA_FRAME_POINTER_SCAN
+// A frame of managed code, which keeps frame pointers (see PinTrackingPass):
+// fp points at the caller's saved fp, with the return address above it.
+struct Frame {
+  uintptr_t pc, sp, fp;
+};
+
+static bool step_frame_pointer(Frame& f) {
+  // The caller's frame is above this one, and (like every frame with a frame
+  // pointer on x86-64) 16 byte aligned. If not, we were stopped somewhere fp
+  // has not been set up yet, and libunwind will have to find the caller.
+  if (f.fp < f.sp || (f.fp & 15) != 0) return false;
+
+  auto* fp = (uintptr_t*)f.fp;
+  f.pc = fp[1];
+  f.sp = f.fp + 16;
+  f.fp = fp[0];
+  return true;
+}
+
+// Collect the pins of the managed frames from f on, without asking libunwind
+// to decode their unwind tables. Stops at the first frame of unmanaged code,
+// or at a frame it can't find the caller of, leaving it in f.
+static void scan_managed_frames(Frame& f, ck::set<void*>& out) {
+  while (true) {
+    if (auto* psi = find_safepoint(f.pc); psi != nullptr && psi->count != 0) {
+      if (psi->reg == UNW_X86_64_RSP) {
+        add_pin_set(*psi, f.sp, out);
+      } else if (psi->reg == UNW_X86_64_RBP) {
+        add_pin_set(*psi, f.fp, out);
+      } else {
+        printf("pin set relative to unexpected register %u at %lx\n", psi->reg, f.pc);
+        abort();
+      }
+    }
+
+    if (not step_frame_pointer(f)) return;
+    if (f.pc == 0 || not in_managed_text(f.pc)) return;
+  }
+}
+#endif
+
+
+static void check_unwind(int res, const char* what) {
+  if (res < 0) {
+    printf("alaska: %s failed while scanning the stack. (libunwind error %d)\n", what, res);
+    abort();
+  }
+}
+
+
 void alaska::barrier::get_pinned_handles(ck::set<void*>& out) {
   unw_cursor_t cursor;
   unw_context_t uc;
   unw_word_t pc, sp, reg;
+#ifdef ALASKA_FRAME_POINTER_SCAN
+  // The cursor keeps pointing at the context it was started from
+  unw_context_t restart_uc;
+#endif
 
-  unw_getcontext(&uc);
-  unw_init_local(&cursor, &uc);
+  check_unwind(unw_getcontext(&uc), "unw_getcontext");
+  check_unwind(unw_init_local(&cursor, &uc), "unw_init_local");
   while (1) {
     int res = unw_step(&cursor);
     if (res == 0) {
@@ -240,23 +408,40 @@ void alaska::barrier::get_pinned_handles(ck::set<void*>& out) {
       printf("unknown libunwind error! %d\n", res);
       abort();
     }
-    unw_get_reg(&cursor, UNW_REG_IP, &pc);
-    unw_get_reg(&cursor, UNW_REG_SP, &sp);
+    check_unwind(unw_get_reg(&cursor, UNW_REG_IP, &pc), "unw_get_reg(ip)");
+    check_unwind(unw_get_reg(&cursor, UNW_REG_SP, &sp), "unw_get_reg(sp)");
     // printf("pc:%016lx sp:%016lx ", pc, sp);
-    auto it = pin_map.find(pc);
-    if (it != pin_map.end()) {
-      auto& psi = it->value;
-      if (psi.count == 0) continue;  // should not happen!
-      unw_get_reg(&cursor, psi.regNum, &reg);
-
 
-      void** localSet = (void**)(reg + psi.offset);
-
-      for (uint32_t i = 0; i < psi.count; i++) {
-        if (might_be_handle(localSet[i])) {
-          out.add(localSet[i]);
-        }
+#ifdef ALASKA_FRAME_POINTER_SCAN
+    // libunwind is only used to get out of the runtime (and signal frames)
+    // and through unmanaged code. Managed frames are walked by hand.
+    if (in_managed_text(pc)) {
+      unw_word_t fp;
+      check_unwind(unw_get_reg(&cursor, UNW_X86_64_RBP, &fp), "unw_get_reg(rbp)");
+      Frame f = {pc, sp, fp};
+      scan_managed_frames(f, out);
+      if (f.pc == 0) break;
+      if (f.sp != sp) {
+        // Let libunwind take it from the frame we stopped at, which has
+        // already been scanned, or is unmanaged. Setting registers on the
+        // cursor would write them to where it found them saved, in the
+        // frames being scanned, so start a new cursor from a copy of our
+        // context with the frame's registers in it. Its pc is a return
+        // address, which is what unw_init_local expects: it looks up the
+        // unwind info of the instruction before it, the call.
+        restart_uc = uc;
+        restart_uc.uc_mcontext.gregs[REG_RSP] = f.sp;
+        restart_uc.uc_mcontext.gregs[REG_RBP] = f.fp;
+        restart_uc.uc_mcontext.gregs[REG_RIP] = f.pc;
+        check_unwind(unw_init_local(&cursor, &restart_uc), "unw_init_local");
       }
+      continue;
+    }
+#endif
+
+    if (auto* psi = find_safepoint(pc); psi != nullptr && psi->count != 0) {
+      check_unwind(unw_get_reg(&cursor, psi->reg, &reg), "unw_get_reg(pin set base)");
+      add_pin_set(*psi, reg, out);
     }
   }
 }
@@ -364,6 +549,7 @@ bool alaska::barrier::begin(void) {
 
 
   // now, patch the threads!
+  find_safepoints();
   patchSignal();
   int retries = 0;
   int signals_sent = 0;
@@ -437,6 +623,14 @@ static void alaska_barrier_signal_handler(int sig, siginfo_t* info, void* ptr) {
   ucontext_t* ucontext = (ucontext_t*)ptr;
   uintptr_t return_address = 0;
 
+#ifdef ALASKA_POLL_GUARD_PAGE
+  if (sig == SIGSEGV && not is_poll_fault(info)) {
+    // Not a poll, but a real fault.
+    forward_fault(sig, info, ptr);
+    return;
+  }
+#endif
+
 #if defined(__amd64__)
   return_address = ucontext->uc_mcontext.gregs[REG_RIP];
 #elif defined(__aarch64__)
@@ -457,8 +651,8 @@ static void alaska_barrier_signal_handler(int sig, siginfo_t* info, void* ptr) {
       // while (!patches_done) {
       // }
 
-      for (auto [start, end] : managed_blob_text_regions) {
-        __builtin___clear_cache((char*)start, (char*)end);
+      for (auto& blob : managed_blobs) {
+        __builtin___clear_cache((char*)blob.start, (char*)blob.end);
       }
 
       printf(
@@ -500,8 +694,8 @@ static void alaska_barrier_signal_handler(int sig, siginfo_t* info, void* ptr) {
 
   clear_pending_signals();
 
-  for (auto [start, end] : managed_blob_text_regions) {
-    __builtin___clear_cache((char*)start, (char*)end);
+  for (auto& blob : managed_blobs) {
+    __builtin___clear_cache((char*)blob.start, (char*)blob.end);
   }
 }
 
@@ -515,6 +709,9 @@ static void setup_signal_handlers(void) {
   sigemptyset(&sa.sa_mask);
   sigaddset(&sa.sa_mask, SIGILL);
   sigaddset(&sa.sa_mask, SIGUSR2);
+#ifdef ALASKA_POLL_GUARD_PAGE
+  sigaddset(&sa.sa_mask, SIGSEGV);
+#endif
 
   // Store siginfo (ucontext) on the stack of the signal
   // handlers (so we can grab the return address)
@@ -524,6 +721,15 @@ static void setup_signal_handlers(void) {
   // Attach this action on two signals:
   assert(sigaction(SIGILL, &sa, NULL) == 0);
   assert(sigaction(SIGUSR2, &sa, NULL) == 0);
+#ifdef ALASKA_POLL_GUARD_PAGE
+  // Polls fault on the polling page instead of executing ud2. Every thread
+  // comes through here, so only the first one sees the action to forward to.
+  struct sigaction prev;
+  assert(sigaction(SIGSEGV, &sa, &prev) == 0);
+  if (!(prev.sa_flags & SA_SIGINFO) || prev.sa_sigaction != alaska_barrier_signal_handler) {
+    previous_segv_action = prev;
+  }
+#endif
 }
 
 
@@ -551,13 +757,44 @@ static void clear_pending_signals(void) {
 
 // void alaska::barrier::remove_self_thread(void) { alaska::thread_tracking::leave(); }
 
-/**
- * This function parses a stackmap emitted from LLVM and pushes all
- * the patch points to
- */
-void parse_stack_map(uint8_t* t) {
-  alaska::StackMapParser p(t);
+struct Safepoint {
+  uint32_t offset;
+  alaska_pin_set pin_set;
+  // Where its record is in the stackmaps
+  uint32_t record;
+};
+
+// By offset, then in record order: qsort isn't stable, and of the records at
+// one offset the first one is kept, just like alaska-safepoints does.
+static int compare_safepoints(const void* a, const void* b) {
+  auto* sa = (const Safepoint*)a;
+  auto* sb = (const Safepoint*)b;
+  if (sa->offset != sb->offset) return (sa->offset > sb->offset) - (sa->offset < sb->offset);
+  return (sa->record > sb->record) - (sa->record < sb->record);
+}
+
+static int compare_offsets(const void* a, const void* b) {
+  auto oa = *(const uint32_t*)a, ob = *(const uint32_t*)b;
+  return (oa > ob) - (oa < ob);
+}
 
+
+// The linker concatenates the stackmaps of every object file, so a program
+// that was transformed one translation unit at a time (alaska --alaska-per-tu)
+// has one for each of them. Call fn on each, in order.
+template <typename Fn>
+static void for_each_stack_map(const ManagedBlob& blob, Fn fn) {
+  for (uint8_t* map = blob.stackmap; map < blob.stackmap_end;) {
+    alaska::StackMapParser p(map);
+    fn(p);
+    map += p.getSizeInBytes();
+  }
+}
+
+
+// Add the safepoints, polls and blocking calls of one of the blob's stackmaps
+static void parse_stack_map_records(ManagedBlob& blob, alaska::StackMapParser& p,
+    ck::vec<Safepoint>& found, ck::vec<uint32_t>& patches, ck::vec<uint32_t>& block_rets) {
   auto currFunc = p.functions_begin();
   size_t recordCount = 0;
 
@@ -570,52 +807,22 @@ void parse_stack_map(uint8_t* t) {
     }
 
     if (record.getID() == 'BLOK') {
-      block_rets.add(addr);
+      block_rets.push(addr - blob.start);
     }
 
-    if (record.getID() == 'PATC') {
-      // Apply the instruction patch
-      auto* rip = (void*)(addr - ALASKA_PATCH_SIZE);
-
-      PatchPoint p;
-      p.pc = (inst_t*)rip;
-
-
-      // X86:
-#ifdef __amd64__
-      // Byte pointer to the instruction.
-      p.inst_sig = 0x0B'0F;
-      // A 2 byte nop
-      p.inst_nop = 0x90'66;
-#endif
-
-// Arm is way easier than x86...
-#ifdef __aarch64__
-      p.inst_nop = 0xd503201f;  // nop
-      p.inst_sig = 0x00000000;  // udf #0
-#endif
-
-
-#ifdef __riscv
-      p.inst_nop = 0x0001;  // nop
-      p.inst_sig = 0x0000;  // unimp
-#endif
-
-      patchPoints.push(p);
-    }
     if (record.getID() == 'PATC') {
       addr -= ALASKA_PATCH_SIZE;
+      patches.push(addr - blob.start);
     }
 
-    PinSetInfo psi;
-    psi.count = 0;
+    alaska_pin_set psi = {};
 
     for (std::uint16_t i = 3; i < record.getNumLocations(); i++) {
       auto l = record.getLocation(i);
 
       switch (l.getKind()) {
         case alaska::StackMapParser::LocationKind::Direct:
-          psi.regNum = l.getDwarfRegNum();
+          psi.reg = l.getDwarfRegNum();
           psi.offset = l.getOffset();
           break;
 
@@ -664,33 +871,148 @@ void parse_stack_map(uint8_t* t) {
     }
 
     if (record.getID() == 'PATC') {
-      pin_map[addr] = psi;
-      //       if (record.getID() == 'BLOK') {
-      // #ifdef __amd64__
-      //         pin_map[addr - 5] = psi;  // TODO(HACK)
-      // #endif
-      // #ifdef __aarch64__
-      //         pin_map[addr - 4] = psi;
-      // #endif
-      //       }
+      // Where the poll traps
+      psi.flags |= ALASKA_PIN_SET_POLL;
+      found.push({(uint32_t)(addr - blob.start), psi, (uint32_t)found.size()});
+    } else if (record.getID() == 0 || record.getID() == 'BLOK') {
+      // A call: its pin set is in use while the callee (and whatever it
+      // calls) runs, so it is found by the return address.
+      if (psi.count != 0) found.push({(uint32_t)(addr - blob.start), psi, (uint32_t)found.size()});
     }
   }
+}
 
 
-  patchNop();
+/**
+ * This function parses a stackmap emitted from LLVM, and builds the blob's
+ * safepoint table from it. alaska-safepoints does the same thing after
+ * linking, so keep the two in sync.
+ */
+static void parse_stack_map(ManagedBlob& blob) {
+  ck::vec<Safepoint> found;
+  ck::vec<uint32_t> patches;
+  ck::vec<uint32_t> block_rets;
+
+  for_each_stack_map(blob, [&](alaska::StackMapParser& p) {
+    parse_stack_map_records(blob, p, found, patches, block_rets);
+  });
+
+  qsort(found.data(), found.size(), sizeof(Safepoint), compare_safepoints);
+  qsort(block_rets.data(), block_rets.size(), sizeof(uint32_t), compare_offsets);
+
+  // These live as long as the program does, just like a linked in table.
+  auto* safepoints = (uint32_t*)malloc(sizeof(uint32_t) * found.size());
+  auto* pin_sets = (alaska_pin_set*)malloc(sizeof(alaska_pin_set) * found.size());
+  auto* patch_offsets = (uint32_t*)malloc(sizeof(uint32_t) * patches.size());
+  auto* block_ret_offsets = (uint32_t*)malloc(sizeof(uint32_t) * block_rets.size());
+
+  uint32_t count = 0;
+  for (auto& sp : found) {
+    if (count != 0 && safepoints[count - 1] == sp.offset) continue;
+    safepoints[count] = sp.offset;
+    pin_sets[count] = sp.pin_set;
+    count++;
+  }
+  memcpy(patch_offsets, patches.data(), sizeof(uint32_t) * patches.size());
+  memcpy(block_ret_offsets, block_rets.data(), sizeof(uint32_t) * block_rets.size());
+
+  blob.safepoints = safepoints;
+  blob.pin_sets = pin_sets;
+  blob.num_safepoints = count;
+  blob.patches = patch_offsets;
+  blob.num_patches = patches.size();
+  blob.block_rets = block_ret_offsets;
+  blob.num_block_rets = block_rets.size();
+  blob.stackmap = nullptr;
+}
+
+
+static uint64_t hash_stack_map(const ManagedBlob& blob) {
+  uint64_t hash = ALASKA_STACKMAP_HASH_INIT;
+  for_each_stack_map(blob, [&](alaska::StackMapParser& p) {
+    for (auto it = p.functions_begin(); it != p.functions_end(); it++) {
+      uint64_t offset = it->getFunctionAddress() - blob.start;
+      hash = alaska_stackmap_hash(hash, offset, it->getRecordCount());
+    }
+  });
+  return hash;
+}
+
+// Use the safepoint table alaska-safepoints linked into the program, if it was
+// made from this blob's stackmap.
+static bool use_safepoint_table(ManagedBlob& blob, const alaska_safepoint_table* table) {
+  if (table == nullptr || blob.stackmap == nullptr) return false;
+  if (table->magic != ALASKA_SAFEPOINT_TABLE_MAGIC) return false;
+  if (table->version != ALASKA_SAFEPOINT_TABLE_VERSION) return false;
+  if (table->stackmap_hash != hash_stack_map(blob)) {
+    printf("alaska: the safepoint table does not match the stackmap. Ignoring it.\n");
+    return false;
+  }
+
+  auto* safepoints = (const uint32_t*)(table + 1);
+  blob.safepoints = safepoints;
+  blob.num_safepoints = table->num_safepoints;
+  blob.pin_sets = (const alaska_pin_set*)(safepoints + table->num_safepoints);
+  blob.patches = (const uint32_t*)(blob.pin_sets + table->num_safepoints);
+  blob.num_patches = table->num_patches;
+  blob.block_rets = blob.patches + table->num_patches;
+  blob.num_block_rets = table->num_block_rets;
+  blob.stackmap = nullptr;
+  return true;
+}
+
+
+// Build the safepoint tables of the blobs that don't have one yet. Nothing
+// needs them until the first barrier, and a program that never has one
+// doesn't pay for parsing its stackmap. A barrier patches every poll of every
+// blob, so there is nothing to gain from parsing one function at a time.
+static void find_safepoints(void) {
+  for (auto& blob : managed_blobs) {
+    if (blob.stackmap != nullptr) parse_stack_map(blob);
+  }
 }
 
 
 
 void alaska_blob_init(struct alaska_blob_config* cfg) {
-  managed_blob_text_regions.push({cfg->code_start, cfg->code_end});
+  // Each translation unit transformed on its own has its own copy of the stub,
+  // and every copy registers the same blob: all of the program's managed code,
+  // and all of its stackmaps. The first one is enough.
+  for (auto& blob : managed_blobs) {
+    if (blob.start == cfg->code_start && blob.end == cfg->code_end) return;
+  }
+
+  ManagedBlob blob = {};
+  blob.start = cfg->code_start;
+  blob.end = cfg->code_end;
+  blob.stackmap = (uint8_t*)cfg->stackmap;
+  blob.stackmap_end = (uint8_t*)cfg->stackmap_end;
+  use_safepoint_table(blob, (const alaska_safepoint_table*)cfg->safepoints);
 
   // Not particularly safe, but we will ignore that for now.
   auto patch_page = (void*)((uintptr_t)cfg->code_start & ~0xFFF);
   size_t size = round_up(cfg->code_end - cfg->code_start, 4096);
   mprotect(patch_page, size + 4096, PROT_EXEC | PROT_READ | PROT_WRITE);
 
-  if (cfg->stackmap) parse_stack_map((uint8_t*)cfg->stackmap);
+#ifdef ALASKA_POLL_GUARD_PAGE
+  // The polls have to be rewritten before they run, so the safepoints can't
+  // wait for the first barrier.
+  if (blob.stackmap != nullptr) parse_stack_map(blob);
+
+  // Rewrite each poll, once, to `test %al, (poll_page)`. The flags it
+  // clobbers are dead at the call that the poll replaced.
+  uint8_t load[ALASKA_PATCH_SIZE] = {0x84, 0x04, 0x25};
+  uint32_t page = (uint32_t)(uintptr_t)get_poll_page();
+  memcpy(load + 3, &page, sizeof(page));
+  for (uint32_t i = 0; i < blob.num_patches; i++) {
+    memcpy((void*)(blob.start + blob.patches[i]), load, sizeof(load));
+  }
+
+  // The polls have all been rewritten, and are never patched again.
+  mprotect(patch_page, size + 4096, PROT_EXEC | PROT_READ);
+#endif
+
+  managed_blobs.push(blob);
 }
 
 // This function doesn't really need to exist,
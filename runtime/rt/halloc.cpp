@@ -21,29 +21,67 @@
 #include <ck/set.h>
 #include <alaska/Runtime.hpp>
 #include <alaska/ThreadCache.hpp>
+#include <alaska/PerCpu.hpp>
 #include <alaska.h>
 #include <errno.h>
+#include <pthread.h>
 
 
 
+#ifdef ALASKA_PER_CPU_CACHES
+// Threads share the cache of the CPU they are running on, so the memory
+// cached scales with the cores rather than the threads. Small objects go
+// through the runtime's per-CPU stacks (Runtime::cpu_halloc), which need no
+// lock, and only misses lock the CPU's thread cache. Nothing is owned by a
+// thread, so there is nothing to retire when one exits: the pthread key below
+// only exists without this option.
+alaska::ThreadCache *get_tc_r(void) {
+  // A thread that migrates between here and locking the cache just shares it
+  // with another CPU's threads for one operation.
+  return alaska::Runtime::get().cpu_threadcache(alaska::current_cpu());
+}
+
+#else
+
 // TODO: don't have this be global!
 static __thread alaska::ThreadCache *g_tc = nullptr;
 
+// The thread cache is also stored under this key, so it is handed back to the
+// runtime when its thread exits (even through pthread_exit). If something
+// allocates again in a later thread-local destructor, the thread just gets
+// another one, which is retired again on the next round of destructors.
+static pthread_key_t tc_key;
+static pthread_once_t tc_key_once = PTHREAD_ONCE_INIT;
+
+static void retire_tc(void *tc) {
+  g_tc = nullptr;
+  if (auto *rt = alaska::Runtime::get_ptr()) rt->retire_threadcache((alaska::ThreadCache *)tc);
+}
+
+static void make_tc_key(void) { pthread_key_create(&tc_key, retire_tc); }
 
 
 alaska::ThreadCache *get_tc_r(void) {
   if (unlikely(g_tc == nullptr)) {
     g_tc = alaska::Runtime::get().new_threadcache();
+    pthread_once(&tc_key_once, make_tc_key);
+    pthread_setspecific(tc_key, g_tc);
   }
   return g_tc;
 }
+#endif
+
 alaska::LockedThreadCache get_tc(void) { return *get_tc_r(); }
 
 
 
 
 static void *_halloc(size_t sz, int zero) {
+#ifdef ALASKA_PER_CPU_CACHES
+  void *result = alaska::Runtime::get().cpu_halloc(sz, zero);
+#else
   void *result = get_tc()->halloc(sz, zero);
+#endif
 
   // This seems right...
   if (result == NULL) errno = ENOMEM;
@@ -109,7 +147,11 @@ void hfree(void *ptr) {
 #endif
 
   // Simply ask the thread cache to free it!
+#ifdef ALASKA_PER_CPU_CACHES
+  alaska::Runtime::get().cpu_hfree(ptr);
+#else
   get_tc()->hfree(ptr);
+#endif
 }
 
 
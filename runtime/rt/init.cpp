@@ -58,4 +58,22 @@ void __attribute__((constructor(102))) alaska_init(void) {
   pthread_create(&barrier_thread, NULL, barrier_thread_func, NULL);
 }
 
-void __attribute__((destructor)) alaska_deinit(void) {}
+#ifdef ALASKA_COUNT_TRANSLATIONS
+// Bumped by every call to alaska_translate (see core/translate.cpp)
+extern "C" uint64_t alaska_translation_count;
+#endif
+
+void __attribute__((destructor)) alaska_deinit(void) {
+#ifdef ALASKA_COUNT_TRANSLATIONS
+  fprintf(stderr, "alaska: %lu translations\n", alaska_translation_count);
+#endif
+
+  // Report how long it took to stop the world, which is bounded by how often
+  // compiled code polls.
+  if (getenv("ALASKA_BARRIER_STATS") != NULL) {
+    auto &bm = the_barrier_manager;
+    fprintf(stderr, "alaska: %lu barriers, time-to-safepoint mean %.1fus max %.1fus\n",
+        bm.barrier_count, bm.barrier_count ? bm.tts_total_ns / 1000.0 / bm.barrier_count : 0.0,
+        bm.tts_max_ns / 1000.0);
+  }
+}
@@ -7,11 +7,13 @@
 
 #include <alaska/Runtime.hpp>
 #include <alaska/sim/HTLB.hpp>
+#include <alaska/sim/trace.h>
 #include "alaska/alaska.hpp"
 #include "alaska/config.h"
 #include "alaska/sim/StatisticsManager.hpp"
 #include <sys/time.h>
 #include <semaphore.h>
+#include <time.h>
 
 
 #define L1_ENTS 96
@@ -37,17 +39,21 @@
 // #define RATE 10'000'000UL
 // #define RATE 100'000UL
 
+// How many events a thread records before handing its buffer to the simulator.
+#define TRACE_BUFFER_EVENTS 4096
+// How often (ms) the simulator thread wakes up on its own to pick up stragglers.
+#define DRAIN_INTERVAL_MS 10
+// How many buffers there can be (recording, waiting, or being simulated), about 16MB of them.
+// Once they are all in use, threads drop their events until the simulator catches up.
+#define TRACE_MAX_BUFFERS 256
+
 static long access_count = 0;
 static alaska::sim::HTLB *g_htlb = NULL;
-static ck::mutex htlb_lock;
 static thread_local volatile bool track_on_this_thread = true;
 
 
 static char sim_name[512];
 
-
-static pthread_mutex_t dump_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t dump_cond = PTHREAD_COND_INITIALIZER;
 static uint64_t dump_buf[TOTAL_ENTRIES * 2];
 
 extern alaska::LockedThreadCache get_tc(void);
@@ -67,6 +73,193 @@ static uint64_t time_ms(void) {
   uint64_t ms = tp.tv_sec * 1000 + tp.tv_usec / 1000;
   return ms;
 }
+
+
+
+// Each thread records the handles it translates into a private buffer, which
+// means the hot path in alaska_translate never takes a lock. Full buffers are
+// pushed onto `submitted` (a lock-free stack) and the simulator thread drains
+// them in batches, so the HTLB itself is only ever touched by one thread.
+struct TraceEvent {
+  uintptr_t addr;
+  uintptr_t kind;
+};
+
+struct TraceBuffer {
+  TraceBuffer *next;
+  size_t count;
+  TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+static TraceBuffer *submitted = NULL;
+static sem_t submitted_sem;
+
+// Drained buffers are recycled through this pool. Threads only hit it once
+// every TRACE_BUFFER_EVENTS accesses, so a lock is fine here.
+static ck::mutex pool_lock;
+static TraceBuffer *pool = NULL;
+static long buffers_allocated = 0;
+// Events recorded while there was no buffer for them, reported at exit
+static uint64_t dropped_events = 0;
+
+static pthread_key_t buffer_key;
+static thread_local TraceBuffer *tl_buffer = NULL;
+
+// Returns NULL if every buffer there can be is in use
+static TraceBuffer *alloc_buffer(void) {
+  {
+    ck::scoped_lock l(pool_lock);
+    if (pool != NULL) {
+      auto *b = pool;
+      pool = b->next;
+      b->next = NULL;
+      b->count = 0;
+      return b;
+    }
+    if (buffers_allocated == TRACE_MAX_BUFFERS) return NULL;
+    buffers_allocated++;
+  }
+  auto *b = (TraceBuffer *)alaska::mmap_alloc(sizeof(TraceBuffer));
+  b->next = NULL;
+  b->count = 0;
+  return b;
+}
+
+static void release_buffer(TraceBuffer *b) {
+  ck::scoped_lock l(pool_lock);
+  b->next = pool;
+  pool = b;
+}
+
+static void submit_buffer(TraceBuffer *b) {
+  TraceBuffer *head = __atomic_load_n(&submitted, __ATOMIC_RELAXED);
+  do {
+    b->next = head;
+  } while (!__atomic_compare_exchange_n(
+      &submitted, &head, b, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  sem_post(&submitted_sem);
+}
+
+// Called by pthreads when a thread exits so its partial buffer isn't lost.
+static void flush_thread_buffer(void *arg) {
+  auto *b = (TraceBuffer *)arg;
+  if (b == NULL) return;
+  tl_buffer = NULL;
+  if (b->count > 0) {
+    submit_buffer(b);
+  } else {
+    release_buffer(b);
+  }
+}
+
+static inline void record_event(uintptr_t addr, uintptr_t kind) {
+  auto *b = tl_buffer;
+  if (unlikely(b == NULL)) {
+    // Don't take the lock for every event while the simulator is behind
+    bool starved = __atomic_load_n(&pool, __ATOMIC_RELAXED) == NULL &&
+                   __atomic_load_n(&buffers_allocated, __ATOMIC_RELAXED) == TRACE_MAX_BUFFERS;
+    if (not starved) b = alloc_buffer();
+    if (b == NULL) {
+      __atomic_fetch_add(&dropped_events, 1, __ATOMIC_RELAXED);
+      return;
+    }
+    tl_buffer = b;
+    pthread_setspecific(buffer_key, b);
+  }
+
+  b->events[b->count++] = {addr, kind};
+
+  if (unlikely(b->count == TRACE_BUFFER_EVENTS)) {
+    submit_buffer(b);
+    // The next event tries again if there is no buffer for it
+    tl_buffer = alloc_buffer();
+    pthread_setspecific(buffer_key, tl_buffer);
+  }
+}
+
+
+
+// If ALASKA_HTLB_TRACE is set, every drained event is also written there in
+// the compressed format described in alaska/sim/trace.h.
+static FILE *trace_file = NULL;
+static uint64_t trace_last = 0;
+
+static void open_trace_file(void) {
+  const char *path = getenv("ALASKA_HTLB_TRACE");
+  if (path == NULL) return;
+
+  trace_file = fopen(path, "w");
+  if (trace_file == NULL) {
+    fprintf(stderr, "alaska: could not open trace file '%s'\n", path);
+    return;
+  }
+
+  struct alaska_trace_header hdr = {ALASKA_TRACE_MAGIC, ALASKA_TRACE_VERSION};
+  fwrite(&hdr, sizeof(hdr), 1, trace_file);
+}
+
+static void write_trace(TraceBuffer *b) {
+  uint8_t out[TRACE_BUFFER_EVENTS * 12];
+  size_t len = 0;
+  for (size_t i = 0; i < b->count; i++) {
+    auto &e = b->events[i];
+    len += alaska_trace_encode(out + len, &trace_last, e.addr, e.kind);
+  }
+  fwrite(out, 1, len, trace_file);
+}
+
+
+
+static void feed_localizer(alaska::Runtime &rt, alaska::ThreadCache *tc, FILE *log) {
+  auto &htlb = get_htlb();
+  auto &sm = htlb.get_stats();
+
+  htlb.dump_entries(dump_buf);
+
+  alaska::handle_id_t *buf = tc->localizer.get_hotness_buffer(TOTAL_ENTRIES);
+  memcpy(buf, dump_buf, sizeof(dump_buf));
+  tc->localizer.feed_hotness_buffer(TOTAL_ENTRIES, dump_buf);
+
+  rt.localization_epoch++;
+
+  sm.compute();
+  sm.dump_csv_row(log);
+
+  fflush(log);
+}
+
+// Run every event in a buffer through the simulated HTLB. Accesses are
+// replayed some time after they happened, so a mapping may have changed in
+// between. That is fine for the hit/miss statistics we care about.
+static void simulate_buffer(alaska::Runtime &rt, alaska::ThreadCache *tc, FILE *log, TraceBuffer *b) {
+  auto &htlb = get_htlb();
+
+  for (size_t i = 0; i < b->count; i++) {
+    auto &e = b->events[i];
+    auto m = alaska::Mapping::from_handle_safe((void *)e.addr);
+
+    if (e.kind == ALASKA_TRACE_INVALIDATE) {
+      if (m) htlb.invalidate_htlb(*m);
+      continue;
+    }
+
+    access_count++;
+    if (m) {
+      uint32_t offset = e.addr & ((1LU << ALASKA_SIZE_BITS) - 1);
+      htlb.access(*m, offset);
+    } else {
+      htlb.access_non_handle((void *)e.addr);
+    }
+
+    if (access_count > RATE) {
+      access_count = 0;
+      feed_localizer(rt, tc, log);
+    }
+  }
+
+  if (trace_file) write_trace(b);
+}
+
 static pthread_t sim_background_thread;
 static void *sim_background_thread_func(void *) {
   track_on_this_thread = false;
@@ -83,29 +276,51 @@ static void *sim_background_thread_func(void *) {
   auto &sm = get_htlb().get_stats();
   sm.dump_csv_header(log);
 
-
-
-
-  for (long trial = 0; true; trial++) {
-    pthread_mutex_lock(&dump_mutex);
-    pthread_cond_wait(&dump_cond, &dump_mutex);
-    alaska::handle_id_t *buf = tc->localizer.get_hotness_buffer(TOTAL_ENTRIES);
-    memcpy(buf, dump_buf, sizeof(dump_buf));
-    tc->localizer.feed_hotness_buffer(TOTAL_ENTRIES, dump_buf);
-
-    rt.localization_epoch++;
-
-    sm.compute();
-    sm.dump_csv_row(log);
-
-    fflush(log);
-    pthread_mutex_unlock(&dump_mutex);
+  open_trace_file();
+
+
+  while (true) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += DRAIN_INTERVAL_MS * 1'000'000L;
+    if (deadline.tv_nsec >= 1'000'000'000L) {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1'000'000'000L;
+    }
+    sem_timedwait(&submitted_sem, &deadline);
+
+    // Take the whole list at once, then reverse it so batches are simulated
+    // in the order they were submitted.
+    TraceBuffer *list = __atomic_exchange_n(&submitted, (TraceBuffer *)NULL, __ATOMIC_ACQUIRE);
+    TraceBuffer *ordered = NULL;
+    while (list != NULL) {
+      auto *next = list->next;
+      list->next = ordered;
+      ordered = list;
+      list = next;
+    }
+
+    while (ordered != NULL) {
+      auto *next = ordered->next;
+      simulate_buffer(rt, tc, log, ordered);
+      release_buffer(ordered);
+      ordered = next;
+    }
+
+    if (trace_file) fflush(trace_file);
   }
 
 
   return NULL;
 }
 
+static void __attribute__((destructor)) sim_deinit(void) {
+  uint64_t dropped = __atomic_load_n(&dropped_events, __ATOMIC_RELAXED);
+  if (dropped != 0) {
+    fprintf(stderr, "alaska: the HTLB simulator fell behind, and dropped %lu events\n", dropped);
+  }
+}
+
 static void __attribute__((constructor)) sim_init(void) {
   // printf("Simulation name: ");
   // fflush(stdout);
@@ -116,18 +331,22 @@ static void __attribute__((constructor)) sim_init(void) {
   // }
   strncpy(sim_name, "sim", sizeof(sim_name) - 1);
 
+  sem_init(&submitted_sem, 0, 0);
+  pthread_key_create(&buffer_key, flush_thread_buffer);
+
   pthread_create(&sim_background_thread, NULL, sim_background_thread_func, NULL);
 }
 
 
 void alaska_htlb_sim_invalidate(uintptr_t maybe_handle) {
   if (not alaska::is_initialized()) return;
-  ck::scoped_lock l(htlb_lock);
-  auto m = alaska::Mapping::from_handle_safe((void *)maybe_handle);
-  auto &htlb = get_htlb();
-  if (m) {
-    htlb.invalidate_htlb(*m);
+  if (not track_on_this_thread) {
+    // The simulator thread owns the HTLB, so it can invalidate directly.
+    auto m = alaska::Mapping::from_handle_safe((void *)maybe_handle);
+    if (m) get_htlb().invalidate_htlb(*m);
+    return;
   }
+  record_event(maybe_handle, ALASKA_TRACE_INVALIDATE);
 }
 
 
@@ -135,26 +354,6 @@ void alaska_htlb_sim_invalidate(uintptr_t maybe_handle) {
 
 void alaska_htlb_sim_track(uintptr_t maybe_handle) {
   if (not alaska::is_initialized()) return;
-  ck::scoped_lock l(htlb_lock);
-  auto m = alaska::Mapping::from_handle_safe((void *)maybe_handle);
-  auto &htlb = get_htlb();
-  access_count++;
-  if (m) {
-    uint32_t offset = maybe_handle & ((1LU << ALASKA_SIZE_BITS) - 1);
-    htlb.access(*m, offset);
-  } else {
-    htlb.access_non_handle((void *)maybe_handle);
-  }
-
-  if (access_count > RATE) {
-    access_count = 0;
-
-    // dump, and notify the movement thread!
-    pthread_mutex_lock(&dump_mutex);
-
-    htlb.dump_entries(dump_buf);
-
-    pthread_cond_signal(&dump_cond);
-    pthread_mutex_unlock(&dump_mutex);
-  }
+  if (not track_on_this_thread) return;
+  record_event(maybe_handle, ALASKA_TRACE_ACCESS);
 }
@@ -0,0 +1,221 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+#include <alaska/sim/SetAssoc.hpp>
+#include <alaska/utils.h>
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace alaska::sim;
+
+// SRRIP uses 2-bit re-reference prediction values
+#define RRPV_MAX 3
+
+const char *alaska::sim::policy_name(ReplacementPolicy policy) {
+  switch (policy) {
+    case ReplacementPolicy::LRU:
+      return "lru";
+    case ReplacementPolicy::PLRU:
+      return "plru";
+    case ReplacementPolicy::SRRIP:
+      return "srrip";
+    case ReplacementPolicy::Random:
+      return "random";
+  }
+  return "unknown";
+}
+
+
+SetAssocCache::SetAssocCache(uint32_t num_sets, uint32_t num_ways, ReplacementPolicy policy)
+    : m_num_sets(num_sets)
+    , m_num_ways(num_ways)
+    , m_stride(round_up(num_ways, 8))
+    , m_policy(policy) {
+  ALASKA_ASSERT(num_sets > 0 && num_ways > 0, "Cache must have at least one set and way");
+  ALASKA_ASSERT(num_ways <= 64, "PLRU state only supports up to 64 ways");
+  m_tags.resize(m_num_sets * m_stride);
+  m_meta.resize(m_num_sets * m_stride);
+  m_mru.resize(m_num_sets);
+  reset();
+}
+
+
+void SetAssocCache::reset(void) {
+  std::fill(m_tags.begin(), m_tags.end(), 0);
+  std::fill(m_meta.begin(), m_meta.end(), m_policy == ReplacementPolicy::SRRIP ? RRPV_MAX : 0);
+  std::fill(m_mru.begin(), m_mru.end(), 0);
+  m_time = 0;
+  accesses = 0;
+  hits = 0;
+}
+
+
+int SetAssocCache::find(const uint32_t *set, uint32_t tag) const {
+#if defined(__AVX2__)
+  __m256i needle = _mm256_set1_epi32(tag);
+  for (uint32_t i = 0; i < m_stride; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(set + i));
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, needle)));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+#elif defined(__SSE2__)
+  __m128i needle = _mm_set1_epi32(tag);
+  for (uint32_t i = 0; i < m_stride; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(set + i));
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, needle)));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+#else
+  for (uint32_t i = 0; i < m_stride; i++) {
+    if (set[i] == tag) return i;
+  }
+#endif
+  return -1;
+}
+
+
+uint32_t SetAssocCache::victim(uint32_t set_index) {
+  uint32_t *set = &m_tags[set_index * m_stride];
+  uint64_t *meta = &m_meta[set_index * m_stride];
+
+  // Always prefer an invalid way. Padding ways also compare equal to zero, so
+  // make sure the result is a real way.
+  int empty = find(set, 0);
+  if (empty >= 0 && (uint32_t)empty < m_num_ways) return empty;
+
+  switch (m_policy) {
+    case ReplacementPolicy::LRU: {
+      uint32_t oldest = 0;
+      for (uint32_t w = 1; w < m_num_ways; w++) {
+        if (meta[w] < meta[oldest]) oldest = w;
+      }
+      return oldest;
+    }
+
+    case ReplacementPolicy::PLRU: {
+      // The first way that has not been recently used.
+      uint64_t mru = m_mru[set_index];
+      return __builtin_ctzll(~mru);
+    }
+
+    case ReplacementPolicy::SRRIP:
+      while (true) {
+        for (uint32_t w = 0; w < m_num_ways; w++) {
+          if (meta[w] >= RRPV_MAX) return w;
+        }
+        for (uint32_t w = 0; w < m_num_ways; w++) {
+          meta[w]++;
+        }
+      }
+
+    case ReplacementPolicy::Random:
+      m_rng ^= m_rng << 13;
+      m_rng ^= m_rng >> 7;
+      m_rng ^= m_rng << 17;
+      return m_rng % m_num_ways;
+  }
+  return 0;
+}
+
+
+void SetAssocCache::touch(uint32_t set_index, uint32_t way, bool fill) {
+  uint64_t *meta = &m_meta[set_index * m_stride];
+
+  switch (m_policy) {
+    case ReplacementPolicy::LRU:
+      meta[way] = m_time;
+      break;
+
+    case ReplacementPolicy::PLRU: {
+      uint64_t all = m_num_ways == 64 ? ~0ULL : ((1ULL << m_num_ways) - 1);
+      uint64_t mru = m_mru[set_index] | (1ULL << way);
+      // Once every way has been used, start a new epoch with only this one.
+      if ((mru & all) == all) mru = 1ULL << way;
+      m_mru[set_index] = mru;
+      break;
+    }
+
+    case ReplacementPolicy::SRRIP:
+      // Insert with a "long" re-reference interval, promote on a hit.
+      meta[way] = fill ? RRPV_MAX - 1 : 0;
+      break;
+
+    case ReplacementPolicy::Random:
+      break;
+  }
+}
+
+
+bool SetAssocCache::access(uint32_t hid) {
+  uint32_t tag = hid + 1;
+  uint32_t set_index = hid % m_num_sets;
+  uint32_t *set = &m_tags[set_index * m_stride];
+
+  m_time++;
+  accesses++;
+
+  int way = find(set, tag);
+  if (way >= 0) {
+    hits++;
+    touch(set_index, way, false);
+    return true;
+  }
+
+  uint32_t v = victim(set_index);
+  set[v] = tag;
+  touch(set_index, v, true);
+  return false;
+}
+
+
+void SetAssocCache::invalidate(uint32_t hid) {
+  uint32_t set_index = hid % m_num_sets;
+  uint32_t *set = &m_tags[set_index * m_stride];
+
+  int way = find(set, hid + 1);
+  if (way < 0) return;
+
+  set[way] = 0;
+  m_meta[set_index * m_stride + way] = m_policy == ReplacementPolicy::SRRIP ? RRPV_MAX : 0;
+  m_mru[set_index] &= ~(1ULL << way);
+}
+
+
+
+void HTLBSweep::add(uint32_t num_sets, uint32_t num_ways, ReplacementPolicy policy) {
+  caches.emplace_back(num_sets, num_ways, policy);
+}
+
+
+void HTLBSweep::add_all(const std::vector<uint32_t> &entries, const std::vector<uint32_t> &ways,
+    const std::vector<ReplacementPolicy> &policies) {
+  for (auto e : entries) {
+    for (auto w : ways) {
+      if (w > e || e % w != 0) continue;
+      for (auto p : policies) {
+        add(e / w, w, p);
+      }
+    }
+  }
+}
+
+
+void HTLBSweep::dump_csv(FILE *stream) {
+  fprintf(stream, "entries,sets,ways,policy,accesses,hits,hit_rate\n");
+  for (auto &c : caches) {
+    double rate = c.accesses == 0 ? 0.0 : (double)c.hits / (double)c.accesses;
+    fprintf(stream, "%u,%u,%u,%s,%lu,%lu,%f\n", c.num_sets() * c.num_ways(), c.num_sets(),
+        c.num_ways(), policy_name(c.policy()), c.accesses, c.hits, rate);
+  }
+}
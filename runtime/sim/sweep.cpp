@@ -0,0 +1,103 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+// alaska-htlb-sweep: replay a handle trace (written by the runtime with
+// ALASKA_HTLB_TRACE set) against many HTLB geometries and replacement
+// policies at once, and write the hit rates as CSV.
+
+#include <alaska/sim/SetAssoc.hpp>
+#include <alaska/sim/trace.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace alaska::sim;
+
+static std::vector<uint32_t> parse_list(const char *arg) {
+  std::vector<uint32_t> out;
+  char *copy = strdup(arg);
+  for (char *tok = strtok(copy, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    out.push_back(strtoul(tok, NULL, 0));
+  }
+  free(copy);
+  return out;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-e entries,...] [-w ways,...] [-o out.csv] <trace>\n", prog);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  std::vector<uint32_t> entries = {32, 64, 128, 256, 512, 1024, 2048, 4096};
+  std::vector<uint32_t> ways = {1, 2, 4, 8, 16, 32};
+  std::vector<ReplacementPolicy> policies = {ReplacementPolicy::LRU, ReplacementPolicy::PLRU,
+      ReplacementPolicy::SRRIP, ReplacementPolicy::Random};
+  const char *out_path = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "e:w:o:")) != -1) {
+    switch (opt) {
+      case 'e':
+        entries = parse_list(optarg);
+        break;
+      case 'w':
+        ways = parse_list(optarg);
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1) usage(argv[0]);
+
+  FILE *stream = fopen(argv[optind], "r");
+  if (stream == NULL) {
+    fprintf(stderr, "could not open %s\n", argv[optind]);
+    return EXIT_FAILURE;
+  }
+
+  struct alaska_trace_header hdr;
+  if (fread(&hdr, sizeof(hdr), 1, stream) != 1 || hdr.magic != ALASKA_TRACE_MAGIC ||
+      hdr.version != ALASKA_TRACE_VERSION) {
+    fprintf(stderr, "%s is not an alaska handle trace\n", argv[optind]);
+    return EXIT_FAILURE;
+  }
+
+  HTLBSweep sweep;
+  sweep.add_all(entries, ways, policies);
+
+  uint64_t last = 0, addr;
+  int kind;
+  while (alaska_trace_decode(stream, &last, &addr, &kind)) {
+    // Only handles go through the HTLB
+    if ((int64_t)addr >= 0) continue;
+    uint32_t hid = (addr & ~(1LU << 63)) >> ALASKA_SIZE_BITS;
+    if (kind == ALASKA_TRACE_INVALIDATE) {
+      sweep.invalidate(hid);
+    } else {
+      sweep.access(hid);
+    }
+  }
+  fclose(stream);
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (out == NULL) {
+    fprintf(stderr, "could not open %s\n", out_path);
+    return EXIT_FAILURE;
+  }
+  sweep.dump_csv(out);
+  if (out != stdout) fclose(out);
+
+  return EXIT_SUCCESS;
+}
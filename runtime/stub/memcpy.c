@@ -1,14 +1,26 @@
 #include <string.h>
 #include <stdint.h>
 #include <endian.h>
+#include <alaska.h>
+
+// These are compiled through alaska, so they may be passed handles. The
+// __alaska_mem* versions in the runtime are not, so calling them makes the
+// compiler translate each argument once, and keep it pinned for the call.
+// The handles (not the translated pointers) are what gets returned.
 
 void *memcpy(void *restrict dest, const void *restrict src, size_t n) {
-  unsigned char *d = dest;
-  const unsigned char *s = src;
-	for (size_t i = 0; i < n; i++) {
-		d[i] = s[i];
-	}
+  __alaska_memcpy(dest, src, n);
+  return dest;
+}
+
+void *memmove(void *dest, const void *src, size_t n) {
+  __alaska_memmove(dest, src, n);
   return dest;
+}
 
+void *memset(void *dest, int c, size_t n) {
+  __alaska_memset(dest, c, n);
+  return dest;
 }
 
+int memcmp(const void *s1, const void *s2, size_t n) { return __alaska_memcmp(s1, s2, n); }
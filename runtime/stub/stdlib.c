@@ -0,0 +1,211 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <ctype.h>
+#include <alaska.h>
+
+// Sorting, searching and number parsing. Compiled through alaska, qsort and
+// bsearch pass the comparator handles into the array (libc's would pass raw
+// pointers to a pinned copy of the base), and the strto* functions store a
+// handle in *endptr, where libc would store a raw pointer into the string.
+
+
+static void swap(char *a, char *b, size_t width) {
+  for (; width; width--, a++, b++) {
+    char t = *a;
+    *a = *b;
+    *b = t;
+  }
+}
+
+typedef int (*cmpfun)(const void *, const void *, void *);
+
+static void sift(char *base, size_t root, size_t nel, size_t width, cmpfun cmp, void *arg) {
+  for (;;) {
+    size_t child = 2 * root + 1;
+    if (child >= nel) return;
+    if (child + 1 < nel && cmp(base + child * width, base + (child + 1) * width, arg) < 0) child++;
+    if (cmp(base + root * width, base + child * width, arg) >= 0) return;
+    swap(base + root * width, base + child * width, width);
+    root = child;
+  }
+}
+
+static void heap_sort(char *base, size_t nel, size_t width, cmpfun cmp, void *arg) {
+  for (size_t i = nel / 2; i-- > 0;)
+    sift(base, i, nel, width, cmp, arg);
+  for (size_t end = nel - 1; end > 0; end--) {
+    swap(base, base + end * width, width);
+    sift(base, 0, end, width, cmp, arg);
+  }
+}
+
+static void insertion_sort(char *base, size_t nel, size_t width, cmpfun cmp, void *arg) {
+  for (size_t i = 1; i < nel; i++) {
+    for (size_t j = i; j > 0; j--) {
+      char *a = base + (j - 1) * width, *b = base + j * width;
+      if (cmp(a, b, arg) <= 0) break;
+      swap(a, b, width);
+    }
+  }
+}
+
+// Introsort: quicksort with a median of three pivot, falling back to heapsort
+// when the partitions get too unbalanced and to insertion sort when small. musl
+// uses smoothsort, which does more work per element on random input.
+static void intro_sort(char *base, size_t nel, size_t width, cmpfun cmp, void *arg, int depth) {
+  while (nel > 8) {
+    if (depth-- == 0) return heap_sort(base, nel, width, cmp, arg);
+
+    char *lo = base, *mid = base + (nel / 2) * width, *hi = base + (nel - 1) * width;
+    if (cmp(mid, lo, arg) < 0) swap(mid, lo, width);
+    if (cmp(hi, mid, arg) < 0) {
+      swap(hi, mid, width);
+      if (cmp(mid, lo, arg) < 0) swap(mid, lo, width);
+    }
+    // The pivot lives at base[0] while partitioning
+    swap(lo, mid, width);
+
+    size_t i = 0, j = nel;
+    for (;;) {
+      do
+        i++;
+      while (i < nel && cmp(base + i * width, base, arg) < 0);
+      do
+        j--;
+      while (cmp(base + j * width, base, arg) > 0);
+      if (i >= j) break;
+      swap(base + i * width, base + j * width, width);
+    }
+    swap(base, base + j * width, width);
+
+    // Recurse into the smaller side, so the stack stays O(log n)
+    size_t left = j, right = nel - j - 1;
+    if (left < right) {
+      intro_sort(base, left, width, cmp, arg, depth);
+      base += (j + 1) * width;
+      nel = right;
+    } else {
+      intro_sort(base + (j + 1) * width, right, width, cmp, arg, depth);
+      nel = left;
+    }
+  }
+  insertion_sort(base, nel, width, cmp, arg);
+}
+
+void qsort_r(void *base, size_t nel, size_t width, cmpfun cmp, void *arg) {
+  if (nel < 2 || width == 0) return;
+  int depth = 0;
+  for (size_t n = nel; n; n >>= 1)
+    depth += 2;
+  intro_sort(base, nel, width, cmp, arg, depth);
+}
+
+static int wrapper_cmp(const void *a, const void *b, void *cmp) {
+  return ((int (*)(const void *, const void *))cmp)(a, b);
+}
+
+void qsort(void *base, size_t nel, size_t width, int (*cmp)(const void *, const void *)) {
+  qsort_r(base, nel, width, wrapper_cmp, (void *)cmp);
+}
+
+
+void *bsearch(const void *key, const void *base, size_t nel, size_t width,
+    int (*cmp)(const void *, const void *)) {
+  while (nel > 0) {
+    void *try = (char *)base + width * (nel / 2);
+    int sign = cmp(key, try);
+    if (sign < 0) {
+      nel /= 2;
+    } else if (sign > 0) {
+      base = (char *)try + width;
+      nel -= nel / 2 + 1;
+    } else {
+      return try;
+    }
+  }
+  return NULL;
+}
+
+
+static int digit(int c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c |= 32;
+  if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+  return 99;
+}
+
+// Like musl's __intscan: the magnitude is clamped to `lim`, which is the most
+// negative value of a signed type (so even), or the largest unsigned value.
+static unsigned long long intscan(const char *s, char **end, int base, unsigned long long lim) {
+  const unsigned char *p = (const void *)s;
+  unsigned long long y = 0;
+  int neg = 0, any = 0, overflow = 0;
+
+  if (base < 0 || base == 1 || base > 36) {
+    errno = EINVAL;
+    if (end) *end = (char *)s;
+    return 0;
+  }
+
+  while (isspace(*p))
+    p++;
+  if (*p == '+' || *p == '-') neg = *p++ == '-';
+  if ((base == 0 || base == 16) && p[0] == '0' && (p[1] | 32) == 'x' && digit(p[2]) < 16) {
+    p += 2;
+    base = 16;
+  } else if (base == 0) {
+    base = p[0] == '0' ? 8 : 10;
+  }
+
+  for (int d; (d = digit(*p)) < base; p++, any = 1) {
+    if (y > (ULLONG_MAX - d) / base)
+      overflow = 1;
+    else
+      y = y * base + d;
+  }
+
+  if (end) *end = (char *)(any ? (const char *)p : s);
+  if (!any) return 0;
+
+  if (overflow) {
+    errno = ERANGE;
+    y = lim;
+    if (lim & 1) neg = 0;
+  }
+  if (y >= lim) {
+    if (!(lim & 1) && !neg) {
+      errno = ERANGE;
+      return lim - 1;
+    } else if (y > lim) {
+      errno = ERANGE;
+      return lim;
+    }
+  }
+  return neg ? -y : y;
+}
+
+long strtol(const char *restrict s, char **restrict p, int base) {
+  return intscan(s, p, base, 0UL + LONG_MIN);
+}
+
+unsigned long strtoul(const char *restrict s, char **restrict p, int base) {
+  return intscan(s, p, base, ULONG_MAX);
+}
+
+long long strtoll(const char *restrict s, char **restrict p, int base) {
+  return intscan(s, p, base, 0ULL + LLONG_MIN);
+}
+
+unsigned long long strtoull(const char *restrict s, char **restrict p, int base) {
+  return intscan(s, p, base, ULLONG_MAX);
+}
+
+int atoi(const char *s) { return (int)strtol(s, NULL, 10); }
+long atol(const char *s) { return strtol(s, NULL, 10); }
+long long atoll(const char *s) { return strtoll(s, NULL, 10); }
+
+// strtod is in dtoa.c
+double atof(const char *s) { return strtod(s, NULL); }
@@ -0,0 +1,126 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <alaska.h>
+
+// More of string.h, again mostly from musl. Like the rest of the stubs, these
+// are compiled through alaska, so the strings may be handles: they are
+// translated inside the (often inlined) body instead of being translated and
+// pinned at every call site. The ones that return a pointer into an argument
+// also return a handle, where libc would hand back a raw pointer.
+
+extern char *__strchrnul(const char *s, int c);
+extern void *__memrchr(const void *m, int c, size_t n);
+
+int strcmp(const char *l, const char *r) {
+  for (; *l == *r && *l; l++, r++)
+    ;
+  return *(unsigned char *)l - *(unsigned char *)r;
+}
+
+int strncmp(const char *_l, const char *_r, size_t n) {
+  const unsigned char *l = (void *)_l, *r = (void *)_r;
+  if (!n--) return 0;
+  for (; *l && *r && n && *l == *r; l++, r++, n--)
+    ;
+  return *l - *r;
+}
+
+int strncasecmp(const char *_l, const char *_r, size_t n) {
+  const unsigned char *l = (void *)_l, *r = (void *)_r;
+  if (!n--) return 0;
+  for (; *l && *r && n && (*l == *r || tolower(*l) == tolower(*r)); l++, r++, n--)
+    ;
+  return tolower(*l) - tolower(*r);
+}
+
+size_t strnlen(const char *s, size_t n) {
+  const char *p = memchr(s, 0, n);
+  return p ? p - s : n;
+}
+
+char *strndup(const char *s, size_t n) {
+  size_t l = strnlen(s, n);
+  char *d = malloc(l + 1);
+  if (!d) return NULL;
+  memcpy(d, s, l);
+  d[l] = 0;
+  return d;
+}
+
+
+#define BITOP(a, b, op) \
+  ((a)[(size_t)(b) / (8 * sizeof *(a))] op(size_t) 1 << ((size_t)(b) % (8 * sizeof *(a))))
+
+size_t strspn(const char *s, const char *c) {
+  const char *a = s;
+  size_t byteset[32 / sizeof(size_t)] = {0};
+
+  if (!c[0]) return 0;
+  if (!c[1]) {
+    for (; *s == *c; s++)
+      ;
+    return s - a;
+  }
+
+  for (; *c && BITOP(byteset, *(unsigned char *)c, |=); c++)
+    ;
+  for (; *s && BITOP(byteset, *(unsigned char *)s, &); s++)
+    ;
+  return s - a;
+}
+
+
+char *strchrnul(const char *s, int c) { return __strchrnul(s, c); }
+
+void *memrchr(const void *m, int c, size_t n) { return __memrchr(m, c, n); }
+
+void *memmem(const void *h0, size_t k, const void *n0, size_t l) {
+  const unsigned char *h = h0, *n = n0;
+
+  if (!l) return (void *)h;
+  if (k < l) return 0;
+
+  // Find the first byte, then compare the rest. Not two-way like musl, which
+  // is only a win for long needles.
+  const unsigned char *end = h + k - l;
+  for (; h <= end; h++) {
+    h = memchr(h, *n, end - h + 1);
+    if (!h) return 0;
+    if (!memcmp(h + 1, n + 1, l - 1)) return (void *)h;
+  }
+  return 0;
+}
+
+
+char *strtok_r(char *restrict s, const char *restrict sep, char **restrict p) {
+  if (!s && !(s = *p)) return NULL;
+  s += strspn(s, sep);
+  if (!*s) return *p = 0;
+  *p = s + strcspn(s, sep);
+  if (**p)
+    *(*p)++ = 0;
+  else
+    *p = 0;
+  return s;
+}
+
+char *strtok(char *restrict s, const char *restrict sep) {
+  static char *p;
+  return strtok_r(s, sep, &p);
+}
+
+char *strsep(char **str, const char *sep) {
+  char *s = *str, *end;
+  if (!s) return NULL;
+  end = s + strcspn(s, sep);
+  if (*end)
+    *end++ = 0;
+  else
+    end = 0;
+  *str = end;
+  return s;
+}
@@ -237,15 +237,24 @@ __attribute__((preserve_most)) void __alaska_signal(void) {
 
 
 
-extern int __LLVM_StackMaps __attribute__((weak));
+// These are all from the linker script, so they cover the whole program. A
+// program transformed one translation unit at a time has a copy of this stub
+// in each of them, and a stackmap for each of them in .llvm_stackmaps: each
+// copy registers all of them, not just its own __LLVM_StackMaps.
+extern int __alaska_safepoint_table __attribute__((weak));
 extern char __alaska_text_start[];
 extern char __alaska_text_end[];
+extern char __alaska_stackmaps_start[];
+extern char __alaska_stackmaps_end[];
 
 static void __attribute__((constructor)) alaska_init(void) {
   struct alaska_blob_config cfg;
   cfg.code_start = (uintptr_t)__alaska_text_start;
   cfg.code_end = (uintptr_t)__alaska_text_end;
-  cfg.stackmap = &__LLVM_StackMaps;
+  cfg.stackmap = __alaska_stackmaps_start;
+  cfg.stackmap_end = __alaska_stackmaps_end;
+  if (cfg.stackmap == cfg.stackmap_end) cfg.stackmap = cfg.stackmap_end = NULL;
+  cfg.safepoints = &__alaska_safepoint_table;
   alaska_blob_init(&cfg);
 
 }
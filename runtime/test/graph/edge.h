@@ -0,0 +1,25 @@
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// See LICENSE.txt for license details
+
+#ifndef EDGE_H_
+#define EDGE_H_
+
+// Syntactic sugar for an edge
+template <typename SrcT, typename DstT = SrcT>
+struct EdgePair {
+  SrcT u;
+  DstT v;
+
+  EdgePair() {}
+
+  EdgePair(SrcT u, DstT v)
+      : u(u)
+      , v(v) {}
+
+  bool operator<(const EdgePair& rhs) const { return u == rhs.u ? v < rhs.v : u < rhs.u; }
+
+  bool operator==(const EdgePair& rhs) const { return (u == rhs.u) && (v == rhs.v); }
+};
+
+
+#endif  // EDGE_H_
@@ -7,10 +7,11 @@
 #include <algorithm>
 #include <cassert>
 #include <cinttypes>
+#include <iostream>
 #include <limits>
 #include <random>
 
-#include "graph.h"
+#include "edge.h"
 #include "pvector.h"
 #include "util.h"
 
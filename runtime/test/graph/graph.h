@@ -12,6 +12,7 @@
 #include <unordered_set>
 #include <unordered_map>
 
+#include "edge.h"
 #include "pvector.h"
 #include "util.h"
 #include "platform_atomics.h"
@@ -19,24 +20,6 @@
 #include <alaska/sim/handle_ptr.hpp>
 
 
-// Syntactic sugar for an edge
-template <typename SrcT, typename DstT = SrcT>
-struct EdgePair {
-  SrcT u;
-  DstT v;
-
-  EdgePair() {}
-
-  EdgePair(SrcT u, DstT v)
-      : u(u)
-      , v(v) {}
-
-  bool operator<(const EdgePair& rhs) const { return u == rhs.u ? v < rhs.v : u < rhs.u; }
-
-  bool operator==(const EdgePair& rhs) const { return (u == rhs.u) && (v == rhs.v); }
-};
-
-
 // This is a super dumb and super simple graph implementation designed to *just* use
 // alaska::sim::handle_ptrs internally to drive the HTLB.
 template <typename NodeID_>
@@ -31,15 +31,16 @@ TEST_F(HeapTest, HeapSanity) {
 // Test with fake pointers to HeapPages that the heap page table maps values correctly.
 // This test is pretty nonsense, but it's a good way to test the page table computes bits correctly.
 TEST_F(HeapTest, HeapPageTable) {
+  // Enough pages to cross leaves of the table, and regions of the heap
   ck::vec<void*> pages;
-  for (uintptr_t i = 0; i < (1 << alaska::bits_per_pt_level) * 2; i++) {
+  for (uintptr_t i = 0; i < 2 * (alaska::heap_size / alaska::page_size) + 2; i++) {
     auto page = heap.pm.alloc_page();
     pages.push(page);
     auto hp = reinterpret_cast<alaska::HeapPage*>(i);
 
     heap.pt.set(page, hp);
   }
-  for (uintptr_t i = 0; i < (1 << alaska::bits_per_pt_level) + 2; i++) {
+  for (uintptr_t i = 0; i < 2 * (alaska::heap_size / alaska::page_size) + 2; i++) {
     auto hp_expected = reinterpret_cast<alaska::HeapPage*>(i);
     auto page = pages[i];
 
@@ -50,6 +51,18 @@ TEST_F(HeapTest, HeapPageTable) {
 
 
 
+TEST_F(HeapTest, HeapPageTableMisses) {
+  // Addresses outside of the heap aren't in it, whether or not their leaf exists.
+  int local;
+  ASSERT_EQ(heap.pt.get_unaligned(&local), nullptr);
+  ASSERT_EQ(heap.pt.get_unaligned((void*)~0UL), nullptr);
+
+  auto page = heap.pm.alloc_page();
+  ASSERT_EQ(heap.pt.get_unaligned((char*)page + alaska::span_size), nullptr);
+}
+
+
+
 TEST_F(HeapTest, SizedPageGet) {
   auto sp = heap.get_sizedpage(16);
   ASSERT_NE(sp, nullptr);
@@ -57,6 +70,21 @@ TEST_F(HeapTest, SizedPageGet) {
 
 
 
+TEST_F(HeapTest, SizedPageSpans) {
+  // A class's first page is a single span, and every span of a page maps back to it.
+  auto sp = heap.get_sizedpage(16);
+  ASSERT_EQ(sp->size(), alaska::span_size);
+  ASSERT_EQ(heap.pt.get_unaligned((char*)sp->start() + alaska::span_size - 1), sp);
+
+  // Pages of a class which keeps needing more grow to a full page
+  auto big = heap.get_sizedpage(32, nullptr, 10);
+  ASSERT_EQ(big->size(), alaska::page_size);
+  for (size_t off = 0; off < alaska::page_size; off += alaska::span_size) {
+    ASSERT_EQ(heap.pt.get_unaligned((char*)big->start() + off + 8), big);
+  }
+}
+
+
 TEST_F(HeapTest, SizedPageGetPutGet) {
   // Allocating a locality page then putting it back should return it
   // again to promote reuse. Asserting this might be restrictive on
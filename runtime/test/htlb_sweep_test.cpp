@@ -0,0 +1,112 @@
+/*
+ * This file is part of the Alaska Handle-Based Memory Management System
+ *
+ * Copyright (c) 2024, Nick Wanninger <ncw@u.northwestern.edu>
+ * Copyright (c) 2024, The Constellation Project
+ * All rights reserved.
+ *
+ * This is free software.  You are permitted to use, redistribute,
+ * and modify it as specified in the file "LICENSE".
+ */
+
+#include <gtest/gtest.h>
+#include <alaska/sim/SetAssoc.hpp>
+#include <alaska/sim/trace.h>
+
+using namespace alaska::sim;
+
+static const ReplacementPolicy all_policies[] = {
+    ReplacementPolicy::LRU, ReplacementPolicy::PLRU, ReplacementPolicy::SRRIP,
+    ReplacementPolicy::Random};
+
+
+TEST(SetAssoc, WorkingSetFits) {
+  // Any policy should hit every time once a working set that fits is loaded.
+  for (auto p : all_policies) {
+    SetAssocCache c(4, 12, p);
+    for (uint32_t hid = 0; hid < 48; hid++)
+      ASSERT_FALSE(c.access(hid));
+    for (int round = 0; round < 4; round++) {
+      for (uint32_t hid = 0; hid < 48; hid++)
+        ASSERT_TRUE(c.access(hid)) << policy_name(p);
+    }
+  }
+}
+
+
+TEST(SetAssoc, LRUEvictsOldest) {
+  SetAssocCache c(1, 4, ReplacementPolicy::LRU);
+  for (uint32_t hid = 0; hid < 4; hid++)
+    c.access(hid);
+  c.access(0);  // 1 is now the oldest
+  ASSERT_FALSE(c.access(4));
+  ASSERT_TRUE(c.access(0));
+  ASSERT_FALSE(c.access(1));
+}
+
+
+TEST(SetAssoc, Invalidate) {
+  for (auto p : all_policies) {
+    SetAssocCache c(2, 8, p);
+    c.access(10);
+    ASSERT_TRUE(c.access(10));
+    c.invalidate(10);
+    ASSERT_FALSE(c.access(10));
+    ASSERT_EQ(c.accesses, 3);
+    ASSERT_EQ(c.hits, 1);
+  }
+}
+
+
+TEST(SetAssoc, Thrash) {
+  // A cyclic pattern one larger than an LRU set never hits.
+  SetAssocCache c(1, 8, ReplacementPolicy::LRU);
+  for (int round = 0; round < 8; round++) {
+    for (uint32_t hid = 0; hid < 9; hid++)
+      c.access(hid);
+  }
+  ASSERT_EQ(c.hits, 0);
+}
+
+
+TEST(SetAssoc, SweepGeometries) {
+  HTLBSweep sweep;
+  sweep.add_all({64, 128}, {1, 4, 256}, {ReplacementPolicy::LRU, ReplacementPolicy::SRRIP});
+  // 256 ways does not fit in either size, so that is skipped.
+  ASSERT_EQ(sweep.caches.size(), 8);
+
+  for (int round = 0; round < 4; round++) {
+    for (uint32_t hid = 0; hid < 100; hid++)
+      sweep.access(hid);
+  }
+
+  for (auto &c : sweep.caches) {
+    ASSERT_EQ(c.accesses, 400);
+    if (c.num_sets() * c.num_ways() == 128) {
+      ASSERT_EQ(c.hits, 300);
+    }
+  }
+}
+
+
+TEST(SetAssoc, TraceRoundTrip) {
+  FILE *f = tmpfile();
+  uint64_t last = 0;
+  uint8_t buf[16];
+  uint64_t values[] = {0x8000000001000010, 0x8000000001000020, 0x7ffd1234, 0, 0x8000000002000000};
+  for (int i = 0; i < 5; i++) {
+    fwrite(buf, 1, alaska_trace_encode(buf, &last, values[i], i == 3), f);
+  }
+
+  rewind(f);
+  last = 0;
+  uint64_t addr;
+  int kind;
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(alaska_trace_decode(f, &last, &addr, &kind));
+    ASSERT_EQ(addr, values[i]);
+    ASSERT_EQ(kind, i == 3 ? ALASKA_TRACE_INVALIDATE : ALASKA_TRACE_ACCESS);
+  }
+  ASSERT_FALSE(alaska_trace_decode(f, &last, &addr, &kind));
+  fclose(f);
+}
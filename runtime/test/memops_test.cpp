@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <alaska.h>
+#include <string.h>
+#include <vector>
+
+
+// Sizes around every vector width, and a few big ones.
+static std::vector<size_t> test_sizes(void) {
+  std::vector<size_t> sizes;
+  for (size_t n = 0; n <= 300; n++)
+    sizes.push_back(n);
+  for (size_t n : {511, 512, 513, 4095, 4096, 4097, 65536 + 37})
+    sizes.push_back(n);
+  return sizes;
+}
+
+
+class MemopsTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    src.resize(size);
+    for (size_t i = 0; i < size; i++)
+      src[i] = (uint8_t)(i * 7 + 3);
+  }
+
+  static constexpr size_t size = 70000 + 256;
+  std::vector<uint8_t> src;
+};
+
+
+TEST_F(MemopsTest, Memcpy) {
+  std::vector<uint8_t> dst(size), expected(size);
+  for (size_t n : test_sizes()) {
+    for (size_t align = 0; align < 4; align++) {
+      size_t so = align * 13 % 64, doff = align * 29 % 64;
+      memset(dst.data(), 0xAA, size);
+      memset(expected.data(), 0xAA, size);
+      void *r = __alaska_memcpy(dst.data() + doff, src.data() + so, n);
+      memcpy(expected.data() + doff, src.data() + so, n);
+      ASSERT_EQ(r, dst.data() + doff);
+      ASSERT_EQ(0, memcmp(dst.data(), expected.data(), size)) << "n=" << n << " align=" << align;
+    }
+  }
+}
+
+
+TEST_F(MemopsTest, MemmoveOverlapping) {
+  std::vector<uint8_t> buf(size), expected(size);
+  for (size_t n : test_sizes()) {
+    if (n + 256 > size) continue;
+    for (long shift : {-65L, -33L, -17L, -1L, 1L, 3L, 16L, 31L, 64L, 100L}) {
+      size_t from = 128, to = 128 + shift;
+      memcpy(buf.data(), src.data(), size);
+      memcpy(expected.data(), src.data(), size);
+      void *r = __alaska_memmove(buf.data() + to, buf.data() + from, n);
+      memmove(expected.data() + to, expected.data() + from, n);
+      ASSERT_EQ(r, buf.data() + to);
+      ASSERT_EQ(0, memcmp(buf.data(), expected.data(), size)) << "n=" << n << " shift=" << shift;
+    }
+  }
+}
+
+
+TEST_F(MemopsTest, Memset) {
+  std::vector<uint8_t> dst(size), expected(size);
+  for (size_t n : test_sizes()) {
+    for (size_t off = 0; off < 64; off += 21) {
+      memset(dst.data(), 0xAA, size);
+      memset(expected.data(), 0xAA, size);
+      __alaska_memset(dst.data() + off, 0x5C, n);
+      memset(expected.data() + off, 0x5C, n);
+      ASSERT_EQ(0, memcmp(dst.data(), expected.data(), size)) << "n=" << n << " off=" << off;
+    }
+  }
+}
+
+
+static int sign(int x) { return (x > 0) - (x < 0); }
+
+TEST_F(MemopsTest, Memcmp) {
+  std::vector<uint8_t> other(src);
+  for (size_t n : test_sizes()) {
+    ASSERT_EQ(0, __alaska_memcmp(src.data(), other.data(), n)) << "n=" << n;
+    if (n == 0) continue;
+
+    // A difference at the start, in the middle, and at the very end
+    for (size_t at : {(size_t)0, n / 2, n - 1}) {
+      other[at] = src[at] + 1;
+      ASSERT_EQ(sign(memcmp(src.data(), other.data(), n)),
+          sign(__alaska_memcmp(src.data(), other.data(), n)))
+          << "n=" << n << " at=" << at;
+      ASSERT_EQ(sign(memcmp(other.data(), src.data(), n)),
+          sign(__alaska_memcmp(other.data(), src.data(), n)))
+          << "n=" << n << " at=" << at;
+      other[at] = src[at];
+    }
+  }
+}
@@ -6,6 +6,7 @@
 #include <alaska/Heap.hpp>
 
 #include <alaska/Runtime.hpp>
+#include <sys/mman.h>
 
 
 class PageManagerTest : public ::testing::Test {
@@ -103,6 +104,58 @@ TEST_F(PageManagerTest, PageManagerAllocateAndFree) {
   }
 }
 
+TEST_F(PageManagerTest, PageManagerSpans) {
+  // Single spans are split out of one page, next to each other
+  auto a = pm.alloc_spans(1);
+  auto b = pm.alloc_spans(1);
+  ASSERT_EQ((uintptr_t)b, (uintptr_t)a + alaska::span_size);
+  ASSERT_EQ(pm.get_allocated_span_count(), 2);
+
+  // ... and a longer run doesn't overlap them
+  auto c = pm.alloc_spans(4);
+  ASSERT_TRUE((uintptr_t)c >= (uintptr_t)b + alaska::span_size);
+
+  pm.free_spans(a, 1);
+  ASSERT_EQ(pm.alloc_spans(1), a);
+  ASSERT_EQ(pm.get_allocated_span_count(), 6);
+}
+
+
+TEST_F(PageManagerTest, PageManagerGrows) {
+  // Running off the end of a region reserves another one
+  long pages_per_region = alaska::heap_size / alaska::page_size;
+  ASSERT_EQ(pm.get_region_count(), 1);
+  void* first = pm.alloc_page();
+  for (long i = 1; i < pages_per_region; i++)
+    pm.alloc_page();
+  ASSERT_EQ(pm.get_region_count(), 1);
+
+  void* next = pm.alloc_page();
+  ASSERT_EQ(pm.get_region_count(), 2);
+  ASSERT_TRUE(pm.contains(first));
+  ASSERT_TRUE(pm.contains(next));
+  ASSERT_FALSE(next >= first && (uintptr_t)next < (uintptr_t)first + alaska::heap_size);
+}
+
+
+TEST_F(PageManagerTest, HeapRegionIsAligned) {
+  // Find some free address space, and ask for a region 4k past a page boundary in it
+  size_t scratch_size = alaska::heap_size + 2 * alaska::page_size;
+  void* scratch = mmap(NULL, scratch_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  ASSERT_NE(scratch, MAP_FAILED);
+  munmap(scratch, scratch_size);
+  uintptr_t aligned = ((uintptr_t)scratch + alaska::page_size - 1) & ~(alaska::page_size - 1);
+  void* hint = (void*)(aligned + 4096);
+
+  void* region = alaska::mmap_heap_region(hint);
+  ASSERT_EQ((uintptr_t)region % alaska::page_size, 0);
+  // The whole region is usable
+  ((char*)region)[0] = 1;
+  ((char*)region)[alaska::heap_size - 1] = 1;
+  munmap(region, alaska::heap_size);
+}
+
+
 TEST_F(PageManagerTest, PageManagerFreeInvalidPage) {
   // Test that the page manager handles freeing an invalid page correctly
   void* invalidPage = reinterpret_cast<void*>(0x1000);
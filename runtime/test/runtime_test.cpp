@@ -6,6 +6,10 @@
 #include <alaska/Heap.hpp>
 
 #include <alaska/Runtime.hpp>
+#include <alaska/BarrierManager.hpp>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <thread>
 
 
 #define DUMMY_THREADCACHE ((alaska::ThreadCache*)0x1000UL)
@@ -225,6 +229,62 @@ TEST_F(RuntimeTest, SlabMappingIndex) {
 }
 
 
+TEST_F(RuntimeTest, ConcurrentFreshSlabs) {
+  // Threads grow the table without a global lock, and still never share a slab
+  const int num_threads = 4;
+  const int per_thread = alaska::HandleTable::initial_capacity * 4;
+  std::vector<alaska::HandleSlab*> slabs[num_threads];
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < per_thread; i++)
+        slabs[t].push_back(runtime.handle_table.fresh_slab(DUMMY_THREADCACHE));
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  std::set<alaska::HandleSlab*> seen;
+  for (auto& v : slabs) {
+    for (auto* slab : v) {
+      ASSERT_EQ(seen.count(slab), 0);
+      seen.insert(slab);
+      ASSERT_EQ(runtime.handle_table.get_slab(slab->idx), slab);
+      // The slab's memory is committed
+      auto* m = slab->alloc();
+      m->set_pointer(nullptr);
+    }
+  }
+  ASSERT_LE(runtime.handle_table.slab_count(), runtime.handle_table.capacity());
+}
+
+
+TEST_F(RuntimeTest, FreeUnownedSlabIsReleased) {
+  auto* slab = runtime.handle_table.fresh_slab(DUMMY_THREADCACHE);
+  std::vector<alaska::Mapping*> handles;
+  for (int i = 0; i < 1000; i++) {
+    auto* m = slab->alloc();
+    m->set_pointer(nullptr);
+    handles.push_back(m);
+  }
+  // The owner went away, and the handles are freed from elsewhere
+  slab->set_owner(nullptr);
+  for (auto* m : handles)
+    runtime.handle_table.put(m, nullptr);
+
+  // The slab starts over, with its memory handed back to the kernel
+  ASSERT_EQ(slab->allocator.num_free_in_bump_allocator(), alaska::HandleTable::slab_capacity);
+  unsigned char resident = 1;
+  void* page = (void*)((uintptr_t)handles[0] & ~(uintptr_t)(getpagesize() - 1));
+  ASSERT_EQ(mincore(page, getpagesize(), &resident), 0);
+  ASSERT_EQ(resident & 1, 0);
+
+  // And it can be used again
+  ASSERT_NE(slab->alloc(), nullptr);
+}
+
+
+
 //////////////////////
 // Handle Slab Queue
 //////////////////////
@@ -321,3 +381,24 @@ TEST_F(RuntimeTest, HandleSlabQueueRemoveEnd) {
   ASSERT_EQ(queue.pop(), slab1);
   ASSERT_EQ(queue.pop(), slab2);
 }
+
+
+// The time it takes a barrier manager to stop the world is recorded.
+TEST_F(RuntimeTest, BarrierRecordsTimeToSafepoint) {
+  struct SlowBarrierManager : public alaska::BarrierManager {
+    bool begin(void) override {
+      usleep(2000);
+      return true;
+    }
+  };
+  SlowBarrierManager bm;
+  auto *old = runtime.barrier_manager;
+  runtime.barrier_manager = &bm;
+
+  ASSERT_TRUE(runtime.with_barrier([] {}));
+  ASSERT_EQ(bm.barrier_count, 1);
+  ASSERT_GE(bm.tts_max_ns, 2000 * 1000);
+  ASSERT_EQ(bm.tts_total_ns, bm.tts_max_ns);
+
+  runtime.barrier_manager = old;
+}
@@ -61,6 +61,33 @@ TEST(SizeClass, ClassToSize) {
 }
 
 
+TEST(SizeClass, SmallLookupMatchesBinning) {
+  for (size_t sz = 0; sz < alaska::huge_object_thresh; sz++) {
+    ASSERT_EQ(alaska::size_to_class(sz), alaska::internal::compute_size_class(sz)) << sz;
+  }
+}
+
+TEST(SizeClass, ReciprocalIsExact) {
+  // Every object boundary in a page, on both sides
+  for (int cl = 0; cl < alaska::num_size_classes; cl++) {
+    uint64_t size = alaska::class_to_size(cl);
+    auto &recip = alaska::size_class_info(cl).recip;
+    for (uint64_t n = 0; n < (1LU << alaska::reciprocal_bits); n += size) {
+      ASSERT_EQ(recip.divide(n), n / size);
+      if (n > 0) {
+        ASSERT_EQ(recip.divide(n - 1), (n - 1) / size);
+      }
+    }
+  }
+  // And divisors which aren't size classes (handle slabs, tests)
+  for (uint64_t d = 1; d < 100; d++) {
+    alaska::Reciprocal recip(d);
+    for (uint64_t n = 0; n < 100000; n++)
+      ASSERT_EQ(recip.divide(n), n / d);
+  }
+}
+
+
 void printBitPattern(uint64_t n) {
   int bits = 64;
   for (long i = bits - 1; i >= 0; i--) {
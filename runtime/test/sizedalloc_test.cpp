@@ -77,3 +77,18 @@ TEST_F(SizedAllocatorTest, ReleaseRemoteNumFree) {
   salloc.release_local(b);
   ASSERT_EQ(salloc.num_free(), object_count);
 }
+
+
+TEST_F(SizedAllocatorTest, ExtendFormatsHeaders) {
+  // Headers are only formatted once extend reaches their objects
+  uint64_t headers[8];
+  memset(headers, 0xFF, sizeof(headers));
+  salloc.configure(buffer, object_size, 8, headers, sizeof(uint64_t));
+
+  ASSERT_EQ(salloc.extend(3), 3);
+  ASSERT_EQ(salloc.frontier(), (char *)buffer + 3 * object_size);
+  for (int i = 0; i < 3; i++)
+    ASSERT_EQ(headers[i], 0);
+  for (int i = 3; i < 8; i++)
+    ASSERT_EQ(headers[i], ~0UL);
+}
@@ -0,0 +1,296 @@
+#include <gtest/gtest.h>
+#include <alaska.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// stub/string.c and stub/stdlib.c, compiled natively with every function renamed to
+// alaska_stub_* (see ALASKA_NATIVE_STUBS in the CMakeLists.txt). Each test checks them against
+// the libc they replace.
+extern "C" {
+int alaska_stub_strcmp(const char *, const char *);
+int alaska_stub_strncmp(const char *, const char *, size_t);
+int alaska_stub_strncasecmp(const char *, const char *, size_t);
+size_t alaska_stub_strnlen(const char *, size_t);
+char *alaska_stub_strndup(const char *, size_t);
+size_t alaska_stub_strspn(const char *, const char *);
+char *alaska_stub_strchrnul(const char *, int);
+void *alaska_stub_memrchr(const void *, int, size_t);
+void *alaska_stub_memmem(const void *, size_t, const void *, size_t);
+char *alaska_stub_strtok(char *, const char *);
+char *alaska_stub_strtok_r(char *, const char *, char **);
+char *alaska_stub_strsep(char **, const char *);
+
+void alaska_stub_qsort(void *, size_t, size_t, int (*)(const void *, const void *));
+void alaska_stub_qsort_r(
+    void *, size_t, size_t, int (*)(const void *, const void *, void *), void *);
+void *alaska_stub_bsearch(
+    const void *, const void *, size_t, size_t, int (*)(const void *, const void *));
+long alaska_stub_strtol(const char *, char **, int);
+unsigned long alaska_stub_strtoul(const char *, char **, int);
+long long alaska_stub_strtoll(const char *, char **, int);
+unsigned long long alaska_stub_strtoull(const char *, char **, int);
+int alaska_stub_atoi(const char *);
+long alaska_stub_atol(const char *);
+long long alaska_stub_atoll(const char *);
+
+// Normally provided by stub/stub.c, which isn't built natively.
+char *__strchrnul(const char *s, int c) { return (char *)strchrnul(s, c); }
+void *__memrchr(const void *m, int c, size_t n) { return (void *)memrchr(m, c, n); }
+}
+
+
+static int sign(long v) { return (v > 0) - (v < 0); }
+
+
+TEST(StubTest, Compare) {
+  const char *strs[] = {"", "a", "A", "ab", "abc", "abd", "ABC", "abc\xff", "b", "\x80"};
+  for (auto *l : strs) {
+    for (auto *r : strs) {
+      ASSERT_EQ(sign(alaska_stub_strcmp(l, r)), sign(strcmp(l, r))) << l << " " << r;
+      for (size_t n = 0; n < 5; n++) {
+        ASSERT_EQ(sign(alaska_stub_strncmp(l, r, n)), sign(strncmp(l, r, n))) << l << " " << r;
+        ASSERT_EQ(sign(alaska_stub_strncasecmp(l, r, n)), sign(strncasecmp(l, r, n)))
+            << l << " " << r;
+      }
+    }
+  }
+}
+
+
+TEST(StubTest, LengthAndSearch) {
+  const char *s = "hello, world";
+  for (size_t n = 0; n < 16; n++) {
+    ASSERT_EQ(alaska_stub_strnlen(s, n), strnlen(s, n));
+    char *d = alaska_stub_strndup(s, n);
+    ASSERT_STREQ(d, std::string(s, strnlen(s, n)).c_str());
+    free(d);
+    ASSERT_EQ(alaska_stub_memrchr(s, 'o', n), memrchr(s, 'o', n));
+  }
+  for (const char *set : {"", "h", "hel", "leho", ", dlrowhe", "xyz"})
+    ASSERT_EQ(alaska_stub_strspn(s, set), strspn(s, set)) << set;
+  for (int c : {(int)'h', (int)'o', (int)'d', (int)'z', 0})
+    ASSERT_EQ(alaska_stub_strchrnul(s, c), strchrnul(s, c));
+}
+
+
+TEST(StubTest, Memmem) {
+  std::mt19937 rng(1234);
+  std::string hay(300, 0);
+  for (auto &c : hay)
+    c = "ab"[rng() % 2];
+  hay += "needle";
+
+  std::vector<std::string> needles = {"", "a", "b", "ab", "aab", "bbbb", "needle", "le", "x",
+      hay, hay + "a", hay.substr(150, 40)};
+  for (int i = 0; i < 50; i++)
+    needles.push_back(hay.substr(rng() % hay.size(), 1 + rng() % 12));
+
+  for (auto &n : needles) {
+    for (size_t k : {(size_t)0, (size_t)1, (size_t)7, hay.size() / 2, hay.size()}) {
+      ASSERT_EQ(alaska_stub_memmem(hay.data(), k, n.data(), n.size()),
+          memmem(hay.data(), k, n.data(), n.size()))
+          << "needle " << n << ", haystack length " << k;
+    }
+  }
+}
+
+
+static std::vector<std::string> tokens(char *(*next)(char *, const char *, char **),
+    const char *in, const char *sep) {
+  std::vector<std::string> out;
+  std::string buf = in;
+  char *save = nullptr;
+  for (char *t = next(buf.data(), sep, &save); t; t = next(nullptr, sep, &save))
+    out.push_back(t);
+  return out;
+}
+
+static std::vector<std::string> split(
+    char *(*sep_fn)(char **, const char *), const char *in, const char *sep) {
+  std::vector<std::string> out;
+  std::string buf = in;
+  char *s = buf.data();
+  for (char *t; (t = sep_fn(&s, sep));)
+    out.push_back(t);
+  EXPECT_EQ(s, nullptr);
+  return out;
+}
+
+TEST(StubTest, Tokenize) {
+  const char *inputs[] = {"", ",", "a", "a,b", ",,a,,b,,", "a, b;c ,d", "  leading", "trailing  "};
+  const char *seps[] = {",", ", ;", " ", "", "x"};
+  for (auto *in : inputs) {
+    for (auto *sep : seps) {
+      ASSERT_EQ(tokens(alaska_stub_strtok_r, in, sep), tokens(strtok_r, in, sep))
+          << "'" << in << "' on '" << sep << "'";
+      ASSERT_EQ(split(alaska_stub_strsep, in, sep), split(strsep, in, sep))
+          << "'" << in << "' on '" << sep << "'";
+
+      // strtok keeps its place between calls
+      std::string a = in, b = in;
+      char *x = alaska_stub_strtok(a.data(), sep), *y = strtok(b.data(), sep);
+      while (x || y) {
+        ASSERT_TRUE(x && y) << "'" << in << "' on '" << sep << "'";
+        ASSERT_STREQ(x, y);
+        x = alaska_stub_strtok(nullptr, sep);
+        y = strtok(nullptr, sep);
+      }
+    }
+  }
+}
+
+
+static int cmp_int(const void *a, const void *b) {
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+static int cmp_int_r(const void *a, const void *b, void *calls) {
+  (*(long *)calls)++;
+  return cmp_int(a, b);
+}
+
+// Arrays which take the introsort down each of its paths: tiny (insertion sort), random,
+// already sorted, reversed, constant, and organ-pipe shaped (which pushes median-of-three
+// pivoting towards its worst case, and so into the heap sort fallback).
+static std::vector<std::vector<int>> sort_inputs(void) {
+  std::mt19937 rng(42);
+  std::vector<std::vector<int>> inputs;
+  for (size_t n : {0, 1, 2, 3, 7, 16, 17, 100, 1000, 10000}) {
+    std::vector<int> v(n);
+    for (auto &x : v)
+      x = rng() % 1000;
+    inputs.push_back(v);
+    std::sort(v.begin(), v.end());
+    inputs.push_back(v);
+    std::reverse(v.begin(), v.end());
+    inputs.push_back(v);
+    inputs.push_back(std::vector<int>(n, 7));
+
+    std::vector<int> pipe(n);
+    for (size_t i = 0; i < n; i++)
+      pipe[i] = i < n / 2 ? i : n - i;
+    inputs.push_back(pipe);
+  }
+  return inputs;
+}
+
+TEST(StubTest, Qsort) {
+  for (auto &in : sort_inputs()) {
+    auto expected = in, got = in;
+    std::sort(expected.begin(), expected.end());
+    alaska_stub_qsort(got.data(), got.size(), sizeof(int), cmp_int);
+    ASSERT_EQ(got, expected) << "n = " << in.size();
+
+    long calls = 0;
+    got = in;
+    alaska_stub_qsort_r(got.data(), got.size(), sizeof(int), cmp_int_r, &calls);
+    ASSERT_EQ(got, expected) << "n = " << in.size();
+    // O(n log n), even for the inputs median-of-three does badly on
+    size_t n = in.size();
+    ASSERT_LE(calls, 4 * (long)(n * (64 - __builtin_clzl(n | 1)) + n)) << "n = " << n;
+  }
+}
+
+// An element wider than a word, whose size isn't a multiple of one.
+struct Wide {
+  int key;
+  char payload[13];
+};
+
+static int cmp_wide(const void *a, const void *b) {
+  return cmp_int(&((const Wide *)a)->key, &((const Wide *)b)->key);
+}
+
+TEST(StubTest, QsortWide) {
+  std::mt19937 rng(7);
+  std::vector<Wide> v(500);
+  for (auto &w : v) {
+    w.key = rng() % 10000;
+    snprintf(w.payload, sizeof(w.payload), "%d", w.key);
+  }
+  alaska_stub_qsort(v.data(), v.size(), sizeof(Wide), cmp_wide);
+  for (size_t i = 0; i < v.size(); i++) {
+    if (i > 0) {
+      ASSERT_LE(v[i - 1].key, v[i].key);
+    }
+    ASSERT_EQ(std::to_string(v[i].key), v[i].payload);
+  }
+}
+
+
+TEST(StubTest, Bsearch) {
+  for (size_t n : {0, 1, 2, 3, 10, 101, 1024}) {
+    std::vector<int> v(n);
+    for (size_t i = 0; i < n; i++)
+      v[i] = 2 * i;
+    for (int key = -1; key <= (int)(2 * n); key++) {
+      auto *found = (int *)alaska_stub_bsearch(&key, v.data(), n, sizeof(int), cmp_int);
+      if (key >= 0 && key % 2 == 0 && key < (int)(2 * n)) {
+        ASSERT_EQ(found, &v[key / 2]) << "n = " << n << ", key = " << key;
+      } else {
+        ASSERT_EQ(found, nullptr) << "n = " << n << ", key = " << key;
+      }
+    }
+  }
+}
+
+
+static const char *number_inputs[] = {"0", "42", "  +12abc", "\t-7 ", "-0x1F", "0x", "0xg", "0X7fz",
+    "077", "089", "-", "+", "", "   ", "z", "Zz", "1e5", "9223372036854775807",
+    "9223372036854775808", "-9223372036854775808", "-9223372036854775809",
+    "18446744073709551615", "18446744073709551616", "-1", "-18446744073709551615",
+    "-18446744073709551616", "99999999999999999999999999", "-99999999999999999999999999",
+    "4294967295", "4294967296", "-2147483649"};
+
+// Check a strto* function against libc's: the value, where it stopped, and errno.
+template <typename T>
+static void check_strto(T (*stub)(const char *, char **, int), T (*libc)(const char *, char **, int),
+    const char *name) {
+  for (auto *s : number_inputs) {
+    for (int base : {0, 2, 8, 10, 16, 36}) {
+      char *stub_end = nullptr, *libc_end = nullptr;
+      errno = 0;
+      T got = stub(s, &stub_end, base);
+      int stub_errno = errno;
+      errno = 0;
+      T expected = libc(s, &libc_end, base);
+      int libc_errno = errno;
+
+      ASSERT_EQ(got, expected) << name << "(\"" << s << "\", " << base << ")";
+      ASSERT_EQ(stub_end, libc_end) << name << "(\"" << s << "\", " << base << ")";
+      ASSERT_EQ(stub_errno, libc_errno) << name << "(\"" << s << "\", " << base << ")";
+    }
+  }
+
+  // A bad base is EINVAL. libc leaves the end pointer alone, where the stub says nothing was
+  // parsed, which is just as allowed.
+  for (int base : {-1, 1, 37}) {
+    char *end = nullptr;
+    errno = 0;
+    ASSERT_EQ(stub("12", &end, base), 0);
+    ASSERT_EQ(errno, EINVAL);
+  }
+}
+
+TEST(StubTest, Strtol) { check_strto<long>(alaska_stub_strtol, strtol, "strtol"); }
+TEST(StubTest, Strtoul) { check_strto<unsigned long>(alaska_stub_strtoul, strtoul, "strtoul"); }
+TEST(StubTest, Strtoll) { check_strto<long long>(alaska_stub_strtoll, strtoll, "strtoll"); }
+TEST(StubTest, Strtoull) {
+  check_strto<unsigned long long>(alaska_stub_strtoull, strtoull, "strtoull");
+}
+
+TEST(StubTest, Atoi) {
+  for (auto *s : {"0", "42", "  -17x", "", "2147483647", "-2147483648"}) {
+    ASSERT_EQ(alaska_stub_atoi(s), atoi(s)) << s;
+    ASSERT_EQ(alaska_stub_atol(s), atol(s)) << s;
+    ASSERT_EQ(alaska_stub_atoll(s), atoll(s)) << s;
+  }
+}
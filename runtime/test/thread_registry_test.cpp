@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <alaska.h>
+#include <alaska/ThreadRegistry.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+TEST(ThreadRegistryTest, JoinLeave) {
+  alaska::ThreadRegistry<int> reg;
+  reg.join(42);
+  ASSERT_EQ(reg.num_threads(), 1);
+  ASSERT_EQ(reg.get_data(), 42);
+
+  reg.get_data() = 7;
+  ASSERT_EQ(reg.leave(), 7);
+  ASSERT_EQ(reg.num_threads(), 0);
+}
+
+
+TEST(ThreadRegistryTest, TwoRegistries) {
+  // The current thread's slot is shared by registries of the same type
+  alaska::ThreadRegistry<int> a, b;
+  a.join(1);
+  b.join(2);
+  ASSERT_EQ(a.get_data(), 1);
+  ASSERT_EQ(b.get_data(), 2);
+  ASSERT_EQ(b.leave(), 2);
+  ASSERT_EQ(a.get_data(), 1);
+  ASSERT_EQ(a.leave(), 1);
+}
+
+
+TEST(ThreadRegistryTest, ForEach) {
+  alaska::ThreadRegistry<int> reg;
+  const int num_threads = 8;
+  std::atomic<int> joined = 0, done = 0;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&, i] {
+      reg.join(i);
+      joined++;
+      while (done == 0)
+        std::this_thread::yield();
+      ASSERT_EQ(reg.get_data(), i);
+      reg.leave();
+    });
+  }
+  while (joined != num_threads)
+    std::this_thread::yield();
+
+  int seen = 0, sum = 0;
+  reg.for_each([&](pthread_t thread, int data) {
+    seen++;
+    sum += data;
+  });
+  ASSERT_EQ(seen, num_threads);
+  ASSERT_EQ(sum, num_threads * (num_threads - 1) / 2);
+
+  done = 1;
+  for (auto &t : threads)
+    t.join();
+  ASSERT_EQ(reg.num_threads(), 0);
+}
+
+
+TEST(ThreadRegistryTest, WalkWhileThreadsComeAndGo) {
+  // Every entry a walk sees is still valid, even if its thread just left.
+  alaska::ThreadRegistry<long> reg;
+  const long magic = 0x1234;
+  std::atomic<bool> stop = false;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&] {
+      while (!stop) {
+        reg.join(magic);
+        ASSERT_EQ(reg.get_data(), magic);
+        reg.leave();
+      }
+    });
+  }
+
+  for (int i = 0; i < 20000; i++) {
+    reg.for_each([&](pthread_t thread, long data) { ASSERT_EQ(data, magic); });
+  }
+
+  stop = true;
+  for (auto &t : threads)
+    t.join();
+  ASSERT_EQ(reg.num_threads(), 0);
+}
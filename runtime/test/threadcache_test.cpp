@@ -8,6 +8,10 @@
 
 #include <alaska/ThreadCache.hpp>
 #include <alaska/Runtime.hpp>
+#include <alaska/PerCpu.hpp>
+#include <sched.h>
+#include <set>
+#include <thread>
 
 class ThreadCacheTest : public ::testing::Test {
  public:
@@ -175,3 +179,189 @@ TEST_F(ThreadCacheTest, HreallocHugeToHandle) {
   // The new object should be a handle
   ASSERT_NE(nullptr, alaska::Mapping::from_handle_safe(h2));
 }
+
+
+static alaska::HeapPage *page_of(alaska::Runtime &rt, void *h) {
+  return rt.heap.pt.get_unaligned(alaska::Mapping::from_handle(h)->get_pointer());
+}
+
+TEST_F(ThreadCacheTest, RetireReleasesPages) {
+  auto *tc = rt.new_threadcache();
+  void *h = tc->halloc(16);
+  ASSERT_TRUE(page_of(rt, h)->is_owned_by(tc));
+
+  rt.retire_threadcache(tc);
+  ASSERT_EQ(page_of(rt, h)->get_owner(), nullptr);
+  // The page can still be freed into, from anywhere
+  t1->hfree(h);
+}
+
+TEST_F(ThreadCacheTest, AdoptRetired) {
+  auto *tc = rt.new_threadcache();
+  void *h = tc->halloc(16);
+  rt.retire_threadcache(tc);
+
+  // The next thread cache is the retired one, which still allocates fine
+  auto *adopted = rt.new_threadcache();
+  ASSERT_EQ(adopted, tc);
+  void *h2 = adopted->halloc(16);
+  ASSERT_NE(h2, nullptr);
+  ASSERT_NE(h2, h);
+  adopted->hfree(h);
+  adopted->hfree(h2);
+  rt.del_threadcache(adopted);
+}
+
+TEST_F(ThreadCacheTest, RetiredPoolIsBounded) {
+  rt.config.thread_cache_pool_size = 1;
+  auto *a = rt.new_threadcache();
+  auto *b = rt.new_threadcache();
+  rt.retire_threadcache(a);
+  // No room for this one: it is deleted
+  rt.retire_threadcache(b);
+  ASSERT_EQ(rt.retired_tcs.size(), 1);
+  ASSERT_EQ(rt.new_threadcache(), a);
+  rt.del_threadcache(a);
+}
+
+
+TEST_F(ThreadCacheTest, CurrentCpu) {
+  int cpu = alaska::current_cpu();
+  ASSERT_GE(cpu, 0);
+  ASSERT_LT(cpu, alaska::num_cpus());
+}
+
+TEST_F(ThreadCacheTest, CpuThreadCache) {
+  // One cache per CPU, created on first use
+  auto *a = rt.cpu_threadcache(0);
+  ASSERT_EQ(rt.cpu_threadcache(0), a);
+  if (alaska::num_cpus() > 1) {
+    ASSERT_NE(rt.cpu_threadcache(1), a);
+  }
+
+  void *h = alaska::LockedThreadCache(*a)->halloc(16);
+  ASSERT_NE(h, nullptr);
+  alaska::LockedThreadCache(*a)->hfree(h);
+}
+
+
+// Keep the calling thread on the CPU it is on for as long as this is alive, so every push and pop
+// in a test goes to the same stack.
+struct PinToCpu {
+  cpu_set_t old;
+  PinToCpu() {
+    sched_getaffinity(0, sizeof(old), &old);
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(alaska::current_cpu(), &one);
+    sched_setaffinity(0, sizeof(one), &one);
+  }
+  ~PinToCpu() { sched_setaffinity(0, sizeof(old), &old); }
+};
+
+static void *token(long i) { return (void *)(0x1000 + i * 8); }
+
+
+TEST_F(ThreadCacheTest, PerCpuStacks) {
+  if (not alaska::rseq_available()) GTEST_SKIP() << "no rseq";
+  PinToCpu pin;
+  alaska::PerCpuStacks stacks(2);
+  uint64_t guard = 0;
+
+  ASSERT_EQ(stacks.pop(0), nullptr);
+  for (long i = 0; i < alaska::PerCpuStacks::capacity; i++)
+    ASSERT_TRUE(stacks.push(0, token(i), &guard, 0));
+  // Full
+  ASSERT_FALSE(stacks.push(0, token(100), &guard, 0));
+  // The other list is separate
+  ASSERT_EQ(stacks.pop(1), nullptr);
+  ASSERT_EQ(stacks.size(), alaska::PerCpuStacks::capacity);
+
+  for (long i = alaska::PerCpuStacks::capacity - 1; i >= 0; i--)
+    ASSERT_EQ(stacks.pop(0), token(i));
+  ASSERT_EQ(stacks.pop(0), nullptr);
+}
+
+TEST_F(ThreadCacheTest, PerCpuStacksGuard) {
+  if (not alaska::rseq_available()) GTEST_SKIP() << "no rseq";
+  alaska::PerCpuStacks stacks(1);
+  uint64_t guard = 1;
+  ASSERT_FALSE(stacks.push(0, token(0), &guard, 0));
+  ASSERT_EQ(stacks.size(), 0);
+  ASSERT_TRUE(stacks.push(0, token(0), &guard, 1));
+  ASSERT_EQ(stacks.size(), 1);
+}
+
+TEST_F(ThreadCacheTest, PerCpuStacksConcurrent) {
+  // More threads than CPUs, so they are preempted (and migrated) in the middle of pushes and
+  // pops. Every token must come out exactly once.
+  if (not alaska::rseq_available()) GTEST_SKIP() << "no rseq";
+  alaska::PerCpuStacks stacks(4);
+  uint64_t guard = 0;
+  const int num_threads = 8;
+  const long per_thread = 200000;
+  std::vector<void *> seen[num_threads];
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (long i = 0; i < per_thread; i++) {
+        void *tok = token(t * per_thread + i);
+        int list = i % 4;
+        if (not stacks.push(list, tok, &guard, 0)) seen[t].push_back(tok);
+        if (i % 3 == 0) {
+          if (void *v = stacks.pop(list)) seen[t].push_back(v);
+        }
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  std::set<void *> all;
+  long count = 0;
+  auto add = [&](void *v) {
+    count++;
+    all.insert(v);
+  };
+  for (auto &v : seen)
+    for (void *tok : v)
+      add(tok);
+  stacks.drain(add);
+
+  ASSERT_EQ(count, num_threads * per_thread);
+  ASSERT_EQ((long)all.size(), num_threads * per_thread);
+  ASSERT_EQ(stacks.size(), 0);
+}
+
+
+TEST_F(ThreadCacheTest, CpuHallocReusesFreedObjects) {
+  if (not alaska::rseq_available()) GTEST_SKIP() << "no rseq";
+  PinToCpu pin;
+  // Small objects are rounded up to their class, so they can be cached when freed
+  void *h = rt.cpu_halloc(20);
+  size_t class_size = alaska::class_to_size(alaska::size_to_class(20));
+  ASSERT_EQ(t1->get_size(h), class_size);
+
+  rt.cpu_hfree(h);
+  ASSERT_EQ(rt.cpu_objects.size(), 1);
+  // Any size in the same class gets it back
+  void *h2 = rt.cpu_halloc(class_size);
+  ASSERT_EQ(h2, h);
+  ASSERT_EQ(rt.cpu_objects.size(), 0);
+
+  // Zeroed objects never come from the cache
+  memset(alaska::Mapping::translate(h2), 0xFF, class_size);
+  rt.cpu_hfree(h2);
+  void *z = rt.cpu_halloc(class_size, true);
+  for (size_t i = 0; i < class_size; i++) {
+    ASSERT_EQ(((uint8_t *)alaska::Mapping::translate(z))[i], 0);
+  }
+  rt.cpu_hfree(z);
+  ASSERT_EQ(rt.cpu_objects.size(), 2);
+
+  // Big objects go straight back to the thread cache
+  void *big = rt.cpu_halloc(4096);
+  rt.cpu_hfree(big);
+  ASSERT_EQ(rt.cpu_objects.size(), 2);
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <alaska.h>
+#include <vector>
+#include <alaska/Runtime.hpp>
+#include <alaska/ThreadCache.hpp>
+
+// translate.cpp is linked into the test directly, and expects the barrier
+// poll from the compiled runtime.
+extern "C" uint64_t alaska_barrier_poll() { return 0; }
+
+#ifdef ALASKA_COUNT_TRANSLATIONS
+extern "C" uint64_t alaska_translation_count;
+#endif
+
+
+class TranslateTest : public ::testing::Test {
+ public:
+  void SetUp() override { tc = rt.new_threadcache(); }
+  void TearDown() override {
+    for (auto h : handles)
+      tc->hfree(h);
+    rt.del_threadcache(tc);
+  }
+
+  void *alloc(size_t size) {
+    void *h = tc->halloc(size, true);
+    handles.push_back(h);
+    return h;
+  }
+
+  // Every batch translation must agree with alaska_translate.
+  void check(std::vector<void *> &in) {
+    std::vector<void *> out(in.size(), nullptr);
+    alaska_translate_batch(in.data(), out.data(), in.size());
+    for (size_t i = 0; i < in.size(); i++)
+      ASSERT_EQ(out[i], alaska_translate(in[i])) << "element " << i;
+  }
+
+  alaska::Runtime rt;
+  alaska::ThreadCache *tc;
+  std::vector<void *> handles;
+};
+
+
+TEST_F(TranslateTest, BatchOfHandles) {
+  std::vector<void *> in;
+  for (int i = 0; i < 64; i++)
+    in.push_back(alloc(32));
+  check(in);
+}
+
+
+TEST_F(TranslateTest, BatchWithOffsets) {
+  std::vector<void *> in;
+  for (int i = 0; i < 64; i++)
+    in.push_back((uint8_t *)alloc(128) + (i % 128));
+  check(in);
+}
+
+
+// NULL, -1 and raw pointers pass through, in every lane position.
+TEST_F(TranslateTest, BatchMixed) {
+  int local = 0;
+  std::vector<void *> in;
+  for (int i = 0; i < 67; i++) {
+    switch (i % 5) {
+      case 0:
+        in.push_back(nullptr);
+        break;
+      case 1:
+        in.push_back((void *)-1UL);
+        break;
+      case 2:
+        in.push_back(&local);
+        break;
+      default:
+        in.push_back(alloc(16));
+    }
+  }
+  check(in);
+}
+
+
+// Counts which are not a multiple of the vector width use the scalar tail.
+TEST_F(TranslateTest, BatchLengths) {
+  std::vector<void *> all;
+  for (int i = 0; i < 20; i++)
+    all.push_back(alloc(8));
+  for (size_t n = 0; n <= all.size(); n++) {
+    std::vector<void *> in(all.begin(), all.begin() + n);
+    check(in);
+  }
+}
+
+
+TEST_F(TranslateTest, BarrierEpoch) {
+  uint64_t before = alaska_barrier_epoch;
+  rt.with_barrier([] {});
+  ASSERT_EQ(alaska_barrier_epoch, before + 1);
+}
+
+
+#ifdef ALASKA_COUNT_TRANSLATIONS
+TEST_F(TranslateTest, CountsTranslations) {
+  void *h = alloc(32);
+  uint64_t before = alaska_translation_count;
+  alaska_translate(h);
+  ASSERT_EQ(alaska_translation_count, before + 1);
+
+  std::vector<void *> in(16, h), out(16);
+  alaska_translate_batch(in.data(), out.data(), in.size());
+  ASSERT_EQ(alaska_translation_count, before + 17);
+}
+#endif
@@ -0,0 +1,309 @@
+// GAP-style graph kernels (BFS, PageRank, connected components and SSSP) over
+// a pointer-based graph, so that every node and adjacency list is its own heap
+// object. Built natively it measures the kernels as-is; built through
+// alaska-transform every allocation becomes a handle, so the difference is the
+// translation overhead. With -l, the graph is relocated with
+// localize_structure() (from libalaska) before the kernels run.
+//
+// Usage: gap [-g scale] [-k degree] [-u] [-n trials] [-l]
+//   -g  log2 of the number of vertices (default 16)
+//   -k  average degree (default 16)
+//   -u  uniform random graph instead of Kronecker (R-MAT)
+//   -n  trials per kernel (default 3)
+//   -l  localize the graph before running the kernels
+//
+// Output is CSV on stdout:
+//   kernel,graph,scale,degree,build,localized,trial,seconds,checksum
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <queue>
+#include <vector>
+
+#include "generator.h"
+
+typedef int64_t NodeID;
+typedef EdgePair<NodeID> Edge;
+
+// Which build this is, for the CSV. The Makefile sets it; otherwise guess
+// from whether the alaska runtime is linked in.
+#ifndef GAP_BUILD
+#define GAP_BUILD (halloc ? "alaska" : "native")
+#endif
+
+// Provided by libalaska when built with alaska-transform. Otherwise NULL.
+extern "C" bool localize_structure(void *ptr) __attribute__((weak));
+extern "C" void *halloc(size_t sz) __attribute__((weak));
+
+
+struct Node {
+  NodeID id;
+  int64_t degree;
+  Node **neigh;     // a separate allocation, as in an adjacency-list graph
+  int32_t *weight;  // edge weights for SSSP, parallel to `neigh`
+};
+
+struct Graph {
+  int64_t num_nodes;
+  int64_t num_edges;
+  Node **nodes;
+};
+
+
+// Build a symmetric graph out of an edge list, allocating every node and
+// neighbor list separately.
+static Graph *build_graph(pvector<Edge> &el, int64_t num_nodes) {
+  std::vector<int64_t> degree(num_nodes, 0);
+  for (auto &e : el) {
+    if (e.u == e.v) continue;
+    degree[e.u]++;
+    degree[e.v]++;
+  }
+
+  auto *g = (Graph *)malloc(sizeof(Graph));
+  g->num_nodes = num_nodes;
+  g->num_edges = 0;
+  g->nodes = (Node **)malloc(sizeof(Node *) * num_nodes);
+  for (NodeID n = 0; n < num_nodes; n++) {
+    auto *node = (Node *)malloc(sizeof(Node));
+    node->id = n;
+    node->degree = 0;
+    node->neigh = (Node **)malloc(sizeof(Node *) * (degree[n] ? degree[n] : 1));
+    node->weight = (int32_t *)malloc(sizeof(int32_t) * (degree[n] ? degree[n] : 1));
+    g->nodes[n] = node;
+  }
+
+  std::mt19937 rng(kRandSeed);
+  for (auto &e : el) {
+    if (e.u == e.v) continue;
+    int32_t w = 1 + rng() % 255;
+    Node *u = g->nodes[e.u];
+    Node *v = g->nodes[e.v];
+    u->neigh[u->degree] = v;
+    u->weight[u->degree++] = w;
+    v->neigh[v->degree] = u;
+    v->weight[v->degree++] = w;
+    g->num_edges += 2;
+  }
+  return g;
+}
+
+static void free_graph(Graph *g) {
+  for (NodeID n = 0; n < g->num_nodes; n++) {
+    free(g->nodes[n]->neigh);
+    free(g->nodes[n]->weight);
+    free(g->nodes[n]);
+  }
+  free(g->nodes);
+  free(g);
+}
+
+
+// Breadth first search from `source`. Returns the number of reached vertices.
+static int64_t bfs(Graph *g, NodeID source) {
+  std::vector<NodeID> parent(g->num_nodes, -1);
+  std::vector<Node *> frontier, next;
+  parent[source] = source;
+  frontier.push_back(g->nodes[source]);
+  int64_t reached = 1;
+
+  while (!frontier.empty()) {
+    for (Node *u : frontier) {
+      for (int64_t i = 0; i < u->degree; i++) {
+        Node *v = u->neigh[i];
+        if (parent[v->id] < 0) {
+          parent[v->id] = u->id;
+          next.push_back(v);
+          reached++;
+        }
+      }
+    }
+    frontier.swap(next);
+    next.clear();
+  }
+  return reached;
+}
+
+
+// Pull-based PageRank. Returns a checksum of the scores.
+static int64_t pagerank(Graph *g, int max_iters = 20, double epsilon = 1e-4) {
+  const double damping = 0.85;
+  const double base = (1.0 - damping) / g->num_nodes;
+  std::vector<double> scores(g->num_nodes, 1.0 / g->num_nodes);
+  std::vector<double> contrib(g->num_nodes);
+
+  for (int iter = 0; iter < max_iters; iter++) {
+    for (NodeID n = 0; n < g->num_nodes; n++) {
+      Node *u = g->nodes[n];
+      contrib[n] = u->degree ? scores[n] / u->degree : 0;
+    }
+
+    double error = 0;
+    for (NodeID n = 0; n < g->num_nodes; n++) {
+      Node *u = g->nodes[n];
+      double sum = 0;
+      for (int64_t i = 0; i < u->degree; i++)
+        sum += contrib[u->neigh[i]->id];
+      double old = scores[n];
+      scores[n] = base + damping * sum;
+      error += fabs(scores[n] - old);
+    }
+    if (error < epsilon) break;
+  }
+
+  double total = 0;
+  for (auto s : scores)
+    total += s;
+  return (int64_t)(total * 1e6);
+}
+
+
+// Shiloach-Vishkin connected components. Returns the number of components.
+static int64_t connected_components(Graph *g) {
+  std::vector<NodeID> comp(g->num_nodes);
+  for (NodeID n = 0; n < g->num_nodes; n++)
+    comp[n] = n;
+
+  bool change = true;
+  while (change) {
+    change = false;
+    for (NodeID n = 0; n < g->num_nodes; n++) {
+      Node *u = g->nodes[n];
+      for (int64_t i = 0; i < u->degree; i++) {
+        NodeID v = u->neigh[i]->id;
+        NodeID comp_u = comp[n];
+        NodeID comp_v = comp[v];
+        if (comp_u == comp_v) continue;
+        NodeID high = comp_u > comp_v ? comp_u : comp_v;
+        NodeID low = comp_u + comp_v - high;
+        if (high == comp[high]) {
+          change = true;
+          comp[high] = low;
+        }
+      }
+    }
+    for (NodeID n = 0; n < g->num_nodes; n++) {
+      while (comp[n] != comp[comp[n]])
+        comp[n] = comp[comp[n]];
+    }
+  }
+
+  int64_t count = 0;
+  for (NodeID n = 0; n < g->num_nodes; n++)
+    count += comp[n] == n;
+  return count;
+}
+
+
+// Single source shortest paths (Dijkstra). Returns the sum of finite distances.
+static int64_t sssp(Graph *g, NodeID source) {
+  const int64_t inf = INT64_MAX;
+  std::vector<int64_t> dist(g->num_nodes, inf);
+  typedef std::pair<int64_t, Node *> Item;
+  std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+
+  dist[source] = 0;
+  queue.push({0, g->nodes[source]});
+  while (!queue.empty()) {
+    auto [d, u] = queue.top();
+    queue.pop();
+    if (d > dist[u->id]) continue;
+    for (int64_t i = 0; i < u->degree; i++) {
+      Node *v = u->neigh[i];
+      int64_t nd = d + u->weight[i];
+      if (nd < dist[v->id]) {
+        dist[v->id] = nd;
+        queue.push({nd, v});
+      }
+    }
+  }
+
+  int64_t total = 0;
+  for (auto d : dist)
+    if (d != inf) total += d;
+  return total;
+}
+
+
+static NodeID pick_source(Graph *g, std::mt19937 &rng) {
+  while (true) {
+    NodeID n = rng() % g->num_nodes;
+    if (g->nodes[n]->degree > 0) return n;
+  }
+}
+
+
+int main(int argc, char **argv) {
+  int scale = 16;
+  int degree = 16;
+  bool uniform = false;
+  int trials = 3;
+  bool localize = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "g:k:un:l")) != -1) {
+    switch (opt) {
+      case 'g':
+        scale = atoi(optarg);
+        break;
+      case 'k':
+        degree = atoi(optarg);
+        break;
+      case 'u':
+        uniform = true;
+        break;
+      case 'n':
+        trials = atoi(optarg);
+        break;
+      case 'l':
+        localize = true;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-g scale] [-k degree] [-u] [-n trials] [-l]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  Generator<NodeID> gen(scale, degree);
+  pvector<Edge> el = gen.GenerateEL(uniform);
+  Graph *g = build_graph(el, 1L << scale);
+  el.clear();
+
+  if (localize) {
+    if (localize_structure == NULL) {
+      fprintf(stderr, "warning: -l needs the alaska runtime, ignoring\n");
+      localize = false;
+    } else {
+      localize_structure(g);
+    }
+  }
+
+  const char *graph = uniform ? "uniform" : "kron";
+  const char *build = GAP_BUILD;
+  std::mt19937 rng(kRandSeed);
+
+  printf("kernel,graph,scale,degree,build,localized,trial,seconds,checksum\n");
+  auto run = [&](const char *kernel, auto &&fn) {
+    for (int trial = 0; trial < trials; trial++) {
+      Timer t;
+      t.Start();
+      int64_t checksum = fn();
+      t.Stop();
+      printf("%s,%s,%d,%d,%s,%d,%d,%f,%ld\n", kernel, graph, scale, degree, build, localize,
+          trial, t.Seconds(), checksum);
+      fflush(stdout);
+    }
+  };
+
+  run("bfs", [&] { return bfs(g, pick_source(g, rng)); });
+  run("pr", [&] { return pagerank(g); });
+  run("cc", [&] { return connected_components(g); });
+  run("sssp", [&] { return sssp(g, pick_source(g, rng)); });
+
+  free_graph(g);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <alaska.h>
+
+// Walk an array of handles, touching each object once per pass. This is the
+// shape alaska-batch-translate looks for; compare against a build with
+// --alaska-no-batch.
+
+#define NUM_OBJECTS 100000
+#define PASSES 200
+
+struct object {
+  long id;
+  long value;
+};
+
+
+__attribute__((noinline)) long sum_objects(struct object **objects, long count) {
+  long sum = 0;
+  for (long i = 0; i < count; i++)
+    sum += objects[i]->value;
+  return sum;
+}
+
+
+int main() {
+  struct object **objects = calloc(NUM_OBJECTS, sizeof(struct object *));
+  for (long i = 0; i < NUM_OBJECTS; i++) {
+    objects[i] = malloc(sizeof(struct object));
+    objects[i]->id = i;
+    objects[i]->value = i % 7;
+  }
+
+  long sum = 0;
+  unsigned long start = alaska_timestamp();
+  for (int p = 0; p < PASSES; p++)
+    sum += sum_objects(objects, NUM_OBJECTS);
+  unsigned long end = alaska_timestamp();
+  printf("sum: %ld\n", sum);
+  printf("ns per object: %.3f\n", (end - start) / (double)NUM_OBJECTS / PASSES);
+
+  for (long i = 0; i < NUM_OBJECTS; i++)
+    free(objects[i]);
+  free(objects);
+  return 0;
+}
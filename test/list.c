@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <stdlib.h>
+
 struct node {
   struct node *next, *prev;
   int val;
@@ -10,5 +13,25 @@ struct node *get_next(struct node *n) {
 
 
 int main() {
+  struct node *head = NULL;
+  for (int i = 0; i < 100000; i++) {
+    struct node *n = malloc(sizeof(*n));
+    n->val = i;
+    n->prev = NULL;
+    n->next = head;
+    if (head) head->prev = n;
+    head = n;
+  }
+
+  long sum = 0;
+  for (struct node *n = head; n != NULL; n = get_next(n))
+    sum += n->val;
+  printf("%ld\n", sum);
+
+  while (head) {
+    struct node *next = head->next;
+    free(head);
+    head = next;
+  }
   return 0;
 }
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <alaska.h>
 
 
@@ -18,9 +19,20 @@ __attribute__((noinline)) void matmul(double a[SZ][SZ], double b[SZ][SZ], double
 
 int main() {
 
-	double a[SZ][SZ];
-	double b[SZ][SZ];
-	double c[SZ][SZ];
+	// Allocate the matrices on the heap so they are handles.
+	double (*a)[SZ] = malloc(sizeof(double[SZ][SZ]));
+	double (*b)[SZ] = malloc(sizeof(double[SZ][SZ]));
+	double (*c)[SZ] = malloc(sizeof(double[SZ][SZ]));
+	for (int i = 0; i < SZ; i++) {
+		for (int j = 0; j < SZ; j++) {
+			a[i][j] = i + j;
+			b[i][j] = i - j;
+		}
+	}
 	matmul(a, b, c);
+	printf("%f\n", c[SZ / 2][SZ / 2]);
+	free(a);
+	free(b);
+	free(c);
 	return 0;
 }
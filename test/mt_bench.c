@@ -0,0 +1,301 @@
+// Multithreaded allocator benchmarks with cross-thread frees (larson,
+// producer/consumer, and xmalloc). This is the same set of workloads as
+// runtime/bench/thread_bench.cpp, but written against plain malloc/free so it
+// can be built natively or with `alaska`, where it runs through the rt layer
+// with background compaction enabled:
+//
+//   clang -O3 test/mt_bench.c -o build/mt_bench -lpthread
+//   local/bin/alaska -O3 test/mt_bench.c -o build/mt_bench.alaska -lpthread
+//
+// Usage: mt_bench [max_threads] [scale]. Output is CSV on stdout:
+//   bench,allocator,param,ops,ns,ops_per_sec,ns_per_op,rss_kb,peak_rss_kb
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// Present only when linked against the alaska runtime
+extern void *halloc(size_t sz) __attribute__((weak));
+
+static long scale = 1;
+
+static uint64_t now_ns(void) {
+  struct timespec spec;
+  clock_gettime(CLOCK_MONOTONIC, &spec);
+  return spec.tv_sec * 1000000000UL + spec.tv_nsec;
+}
+
+static long current_rss_kb(void) {
+  long size = 0, pages = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == NULL) return 0;
+  if (fscanf(f, "%ld %ld", &size, &pages) != 2) pages = 0;
+  fclose(f);
+  return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long peak_rss_kb(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+static void report(const char *bench, long nthreads, long ops, uint64_t ns) {
+  double secs = ns / 1e9;
+  printf("%s,%s,%ld_threads,%ld,%lu,%.0f,%.3f,%ld,%ld\n", bench, halloc ? "alaska-rt" : "native",
+      nthreads, ops, ns, secs > 0 ? ops / secs : 0.0, ops > 0 ? (double)ns / ops : 0.0,
+      current_rss_kb(), peak_rss_kb());
+  fflush(stdout);
+}
+
+static size_t random_size(unsigned int *seed, size_t min, size_t max) {
+  return min + rand_r(seed) % (max - min);
+}
+
+
+struct worker {
+  long id;
+  long nthreads;
+  long ops;
+  unsigned int seed;
+  void *shared;
+  void (*fn)(struct worker *w);
+};
+
+static pthread_barrier_t start_barrier;
+
+static void *worker_entry(void *arg) {
+  struct worker *w = arg;
+  pthread_barrier_wait(&start_barrier);
+  w->fn(w);
+  return NULL;
+}
+
+static void run_threads(const char *bench, long nthreads, void (*fn)(struct worker *), void *shared) {
+  struct worker *workers = calloc(nthreads, sizeof(*workers));
+  pthread_t *threads = calloc(nthreads, sizeof(*threads));
+  pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+
+  for (long i = 0; i < nthreads; i++) {
+    workers[i].id = i;
+    workers[i].nthreads = nthreads;
+    workers[i].seed = i + 1;
+    workers[i].shared = shared;
+    workers[i].fn = fn;
+    pthread_create(&threads[i], NULL, worker_entry, &workers[i]);
+  }
+
+  pthread_barrier_wait(&start_barrier);
+  uint64_t start = now_ns();
+  for (long i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+  uint64_t end = now_ns();
+
+  long ops = 0;
+  for (long i = 0; i < nthreads; i++)
+    ops += workers[i].ops;
+  report(bench, nthreads, ops, end - start);
+
+  pthread_barrier_destroy(&start_barrier);
+  free(threads);
+  free(workers);
+}
+
+
+
+// Larson: randomly replace objects in an array of slots, passing the arrays
+// to the next thread after every round.
+#define LARSON_SLOTS 1000
+#define LARSON_ROUNDS 20
+struct larson {
+  void **slots[256];
+  pthread_barrier_t barrier;
+};
+
+static void larson_worker(struct worker *w) {
+  struct larson *l = w->shared;
+  long per_round = 10000 * scale;
+
+  for (long j = 0; j < LARSON_SLOTS; j++)
+    l->slots[w->id][j] = malloc(random_size(&w->seed, 16, 512));
+  w->ops += LARSON_SLOTS;
+  pthread_barrier_wait(&l->barrier);
+
+  for (long round = 1; round <= LARSON_ROUNDS; round++) {
+    void **arr = l->slots[(w->id + round) % w->nthreads];
+    for (long k = 0; k < per_round; k++) {
+      long j = rand_r(&w->seed) % LARSON_SLOTS;
+      free(arr[j]);
+      arr[j] = malloc(random_size(&w->seed, 16, 512));
+    }
+    w->ops += per_round * 2;
+    pthread_barrier_wait(&l->barrier);
+  }
+
+  void **arr = l->slots[(w->id + LARSON_ROUNDS + 1) % w->nthreads];
+  for (long j = 0; j < LARSON_SLOTS; j++)
+    free(arr[j]);
+  w->ops += LARSON_SLOTS;
+}
+
+static void larson(long nthreads) {
+  struct larson l;
+  for (long i = 0; i < nthreads; i++)
+    l.slots[i] = calloc(LARSON_SLOTS, sizeof(void *));
+  pthread_barrier_init(&l.barrier, NULL, nthreads);
+  run_threads("larson", nthreads, larson_worker, &l);
+  pthread_barrier_destroy(&l.barrier);
+  for (long i = 0; i < nthreads; i++)
+    free(l.slots[i]);
+}
+
+
+
+// Producer/consumer: pairs of threads hand objects across a ring buffer.
+#define RING_SIZE 1024
+struct ring {
+  void *items[RING_SIZE];
+  unsigned long head __attribute__((aligned(64)));
+  unsigned long tail __attribute__((aligned(64)));
+};
+
+struct prodcons {
+  long items;
+  struct ring *rings;
+};
+
+static void prodcons_worker(struct worker *w) {
+  struct prodcons *pc = w->shared;
+  struct ring *ring = &pc->rings[w->id / 2];
+
+  if ((w->id | 1) >= w->nthreads) {
+    for (long i = 0; i < pc->items; i++) {
+      void *volatile p = malloc(random_size(&w->seed, 16, 256));
+      free(p);
+    }
+    w->ops += pc->items * 2;
+    return;
+  }
+
+  if (w->id % 2 == 0) {
+    for (long i = 0; i < pc->items; i++) {
+      void *p = malloc(random_size(&w->seed, 16, 256));
+      while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - ring->head >= RING_SIZE)
+        sched_yield();
+      ring->items[ring->head % RING_SIZE] = p;
+      __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+    }
+  } else {
+    for (long i = 0; i < pc->items; i++) {
+      while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail)
+        sched_yield();
+      free(ring->items[ring->tail % RING_SIZE]);
+      __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    }
+  }
+  w->ops += pc->items;
+}
+
+static void prodcons(long nthreads) {
+  struct prodcons pc;
+  pc.items = 200000 * scale;
+  pc.rings = calloc((nthreads + 1) / 2, sizeof(struct ring));
+  run_threads("prodcons", nthreads, prodcons_worker, &pc);
+  free(pc.rings);
+}
+
+
+
+// xmalloc: allocate batches and post them to the next thread, which frees them.
+#define XMALLOC_BATCH 64
+struct batch {
+  struct batch *next;
+  void *objects[XMALLOC_BATCH];
+};
+
+struct mailbox {
+  pthread_mutex_t lock;
+  struct batch *batches;
+};
+
+struct xmalloc {
+  struct mailbox *mailboxes;
+  pthread_barrier_t barrier;
+};
+
+static long xmalloc_drain(struct mailbox *box) {
+  pthread_mutex_lock(&box->lock);
+  struct batch *b = box->batches;
+  box->batches = NULL;
+  pthread_mutex_unlock(&box->lock);
+
+  long freed = 0;
+  while (b != NULL) {
+    struct batch *next = b->next;
+    for (int i = 0; i < XMALLOC_BATCH; i++)
+      free(b->objects[i]);
+    freed += XMALLOC_BATCH;
+    free(b);
+    b = next;
+  }
+  return freed;
+}
+
+static void xmalloc_worker(struct worker *w) {
+  struct xmalloc *x = w->shared;
+  struct mailbox *mine = &x->mailboxes[w->id];
+  struct mailbox *next = &x->mailboxes[(w->id + 1) % w->nthreads];
+
+  for (long i = 0; i < 4000 * scale; i++) {
+    struct batch *b = malloc(sizeof(*b));
+    for (int j = 0; j < XMALLOC_BATCH; j++)
+      b->objects[j] = malloc(random_size(&w->seed, 16, 256));
+    w->ops += XMALLOC_BATCH;
+
+    pthread_mutex_lock(&next->lock);
+    b->next = next->batches;
+    next->batches = b;
+    pthread_mutex_unlock(&next->lock);
+
+    w->ops += xmalloc_drain(mine);
+  }
+
+  pthread_barrier_wait(&x->barrier);
+  w->ops += xmalloc_drain(mine);
+}
+
+static void xmalloc(long nthreads) {
+  struct xmalloc x;
+  x.mailboxes = calloc(nthreads, sizeof(struct mailbox));
+  for (long i = 0; i < nthreads; i++)
+    pthread_mutex_init(&x.mailboxes[i].lock, NULL);
+  pthread_barrier_init(&x.barrier, NULL, nthreads);
+  run_threads("xmalloc", nthreads, xmalloc_worker, &x);
+  pthread_barrier_destroy(&x.barrier);
+  free(x.mailboxes);
+}
+
+
+
+int main(int argc, char **argv) {
+  long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (argc > 1) max_threads = atol(argv[1]);
+  if (argc > 2) scale = atol(argv[2]);
+  if (max_threads < 1) max_threads = 1;
+  if (max_threads > 256) max_threads = 256;
+  if (scale < 1) scale = 1;
+
+  printf("bench,allocator,param,ops,ns,ops_per_sec,ns_per_op,rss_kb,peak_rss_kb\n");
+  void (*benches[])(long) = {larson, prodcons, xmalloc};
+  for (int b = 0; b < 3; b++) {
+    for (long n = 1; n < max_threads; n *= 2)
+      benches[b](n);
+    benches[b](max_threads);
+  }
+  return 0;
+}
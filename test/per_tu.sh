@@ -0,0 +1,19 @@
+#!/usr/bin/env bash
+
+# Build the program in per_tu/ one translation unit at a time (alaska
+# --alaska-per-tu), then run it. It runs a barrier while a handle is pinned in
+# a frame of its second translation unit, and fails if the pin was missed.
+#
+# Usage: test/per_tu.sh
+
+set -e
+
+cd "$(dirname "$0")/per_tu"
+
+OUT=$(mktemp -d)
+trap 'rm -rf $OUT' EXIT
+
+alaska -O3 --alaska-per-tu -c main.c -o "$OUT/main.o"
+alaska -O3 --alaska-per-tu -c pinned.c -o "$OUT/pinned.o"
+alaska -O3 --alaska-per-tu "$OUT/main.o" "$OUT/pinned.o" -o "$OUT/per_tu"
+"$OUT/per_tu"
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <alaska.h>
+
+// A program of two translation units, to check that the barrier finds the pins
+// of each of them when they were transformed one at a time (alaska
+// --alaska-per-tu). hold_pinned, in pinned.c, keeps an object translated while
+// it calls back into this file to localize the structure that object is in.
+// Localizing moves every object that isn't pinned, so if the barrier missed
+// hold_pinned's pin set, its write would go to the object's old home.
+
+bool localize_structure(uint64_t ptr);
+extern long hold_pinned(long **root);
+
+static long **root;
+
+// Called from hold_pinned, while it has root[0] pinned
+void stop_the_world(void) {
+  // A barrier right after another one is skipped, so wait for ours to run.
+  while (!localize_structure((uint64_t)root))
+    usleep(10 * 1000);
+}
+
+
+int main() {
+  root = malloc(sizeof(long *) * 2);
+  root[0] = malloc(sizeof(long) * 4);
+  root[1] = malloc(sizeof(long) * 4);
+  root[1][0] = 7;
+
+  long held = hold_pinned(root);
+
+  if (held != 42 || root[0][0] != 42 || root[1][0] != 7) {
+    printf("FAIL: pinned %ld, moved %ld (expected 42 and 7)\n", root[0][0], root[1][0]);
+    return EXIT_FAILURE;
+  }
+  printf("PASS\n");
+
+  free(root[0]);
+  free(root[1]);
+  free(root);
+  return EXIT_SUCCESS;
+}
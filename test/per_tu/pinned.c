@@ -0,0 +1,12 @@
+// The second translation unit of the program in main.c
+
+extern void stop_the_world(void);
+
+long hold_pinned(long **root) {
+  long *obj = root[0];
+  obj[0] = 1;
+  // obj stays translated (and pinned in this frame) across the barrier
+  stop_the_world();
+  obj[0] += 41;
+  return obj[0];
+}
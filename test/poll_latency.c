@@ -0,0 +1,57 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <alaska.h>
+
+// A thread spinning in tight numeric loops, which only stops for a barrier at
+// backedge polls, while the runtime's barrier thread stops the world every
+// 50ms. Run with ALASKA_BARRIER_STATS=1 to get the time-to-safepoint, and
+// build with --alaska-poll-interval=N to see how it changes with N.
+
+#define SIZE 4096
+#define SECONDS 3
+
+static volatile int done = 0;
+
+__attribute__((noinline)) double dot(double *a, double *b, long n) {
+  double sum = 0;
+  for (long i = 0; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+
+static void *worker(void *arg) {
+  double *a = malloc(sizeof(double) * SIZE);
+  double *b = malloc(sizeof(double) * SIZE);
+  for (long i = 0; i < SIZE; i++) {
+    a[i] = i * 0.5;
+    b[i] = 1.0 / (i + 1);
+  }
+
+  long rounds = 0;
+  double sum = 0;
+  while (!done) {
+    sum += dot(a, b, SIZE);
+    rounds++;
+  }
+  printf("rounds: %ld (%f)\n", rounds, sum);
+  free(a);
+  free(b);
+  return NULL;
+}
+
+
+int main() {
+  pthread_t t;
+  pthread_create(&t, NULL, worker, NULL);
+
+  unsigned long start = alaska_timestamp();
+  while (alaska_timestamp() - start < SECONDS * 1000000000UL) {
+    void *p = malloc(64);
+    free(p);
+  }
+  done = 1;
+  pthread_join(t, NULL);
+  return 0;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// A recursive walk which hands each node, already touched by the caller, to
+// small helpers which touch it again. Specialization lets the helpers use the
+// caller's translation instead of making their own.
+
+typedef struct node {
+  struct node *left, *right;
+  long value;
+  long weight;
+} node_t;
+
+
+static node_t *make_tree(int depth) {
+  if (depth == 0) return NULL;
+  node_t *n = malloc(sizeof(*n));
+  n->value = rand() % 1000;
+  n->weight = 1 + rand() % 7;
+  n->left = make_tree(depth - 1);
+  n->right = make_tree(depth - 1);
+  return n;
+}
+
+
+static void free_tree(node_t *n) {
+  if (n == NULL) return;
+  free_tree(n->left);
+  free_tree(n->right);
+  free(n);
+}
+
+
+__attribute__((noinline)) long score(node_t *n) {
+  return n->value * n->weight;
+}
+
+
+__attribute__((noinline)) int is_leaf(node_t *n) {
+  return n->left == NULL && n->right == NULL;
+}
+
+
+static long calls = 0;
+
+__attribute__((noinline)) long walk(node_t *n) {
+  if (n == NULL) return 0;
+  calls += 2;
+  long sum = n->value;
+  if (!is_leaf(n)) sum += walk(n->left) + walk(n->right);
+  return sum + score(n);
+}
+
+
+int main() {
+  node_t *root = make_tree(16);
+  long sum = 0;
+  for (int i = 0; i < 20; i++)
+    sum += walk(root);
+  printf("sum: %ld\n", sum);
+  printf("calls: %ld\n", calls);
+  free_tree(root);
+  return 0;
+}
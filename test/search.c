@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 
 
@@ -40,4 +41,25 @@ char *search(struct node *h, int k) {
 //   return x;
 // }
 
-int main() {}
+static struct node *insert(struct node *h, int key) {
+  if (h == NULL) {
+    h = calloc(1, sizeof(*h));
+    h->key = key;
+    h->data = malloc(16);
+    snprintf(h->data, 16, "node %d", key);
+    return h;
+  }
+  if (key < h->key) h->left = insert(h->left, key);
+  if (key > h->key) h->right = insert(h->right, key);
+  return h;
+}
+
+int main() {
+  struct node *root = NULL;
+  srand(0);
+  for (int i = 0; i < 64; i++)
+    root = insert(root, rand() % 1024);
+  for (int i = 0; i < 16; i++)
+    search(root, rand() % 1024);
+  return 0;
+}
@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+
+# Report how many times alaska_translate runs in a few small programs, with
+# and without one of the optimizations (loop versioning by default). The
+# runtime must be configured with -DALASKA_COUNT_TRANSLATIONS=ON, which prints
+# the count when a program exits.
+#
+# Usage: test/translation_counts.sh [-f disable-flag] [program.c ...]
+#   e.g. test/translation_counts.sh -f --alaska-no-specialize recurse.c
+
+set -e
+
+FLAG=--alaska-no-versioning
+if [ "$1" = "-f" ]; then
+  FLAG=$2
+  shift 2
+fi
+
+cd "$(dirname "$0")"
+PROGRAMS=("$@")
+if [ ${#PROGRAMS[@]} -eq 0 ]; then
+  PROGRAMS=(matmul.c list.c search.c recurse.c)
+fi
+
+OUT=$(mktemp -d)
+trap 'rm -rf $OUT' EXIT
+
+count() {
+  "$1" 2>&1 >/dev/null | sed -n 's/^alaska: \([0-9]*\) translations$/\1/p'
+}
+
+printf "%-12s %16s %16s\n" "program" "enabled" "$FLAG"
+for src in "${PROGRAMS[@]}"; do
+  name=$(basename "$src" .c)
+  alaska -O3 "$src" -o "$OUT/$name" >/dev/null
+  alaska -O3 "$FLAG" "$src" -o "$OUT/$name-off" >/dev/null
+  printf "%-12s %16s %16s\n" "$name" "$(count "$OUT/$name")" "$(count "$OUT/$name-off")"
+done